@@ -0,0 +1,165 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+/** Benchmark of the lookup structures of the anti-dictionary.
+ * Random distinct keys of the given length are split between the two tables;
+ * each structure answers the same queries (half of them keys of the tables,
+ * half random) and its space and time per lookup are reported:
+ * - unordered_set: the two hash-sets of Anti_dictionary (space counted by
+ *   the allocator)
+ * - Ad_bitmap (keys of at most Ad_bitmap::cMax_key_size bits)
+ * - Ad_hash_table
+ * - Ad_succinct
+ *
+ * Usage: ad_lookup_bench <key size> <number of keys> [number of queries]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <unordered_set>
+
+#include "../include/Ad_bitmap.hpp"
+#include "../include/Ad_hash_table.hpp"
+#include "../include/Ad_succinct.hpp"
+
+using namespace mawcd;
+
+/** Bytes allocated by all the Counting_allocators */
+static UINT_64 allocated = 0;
+
+/** Allocator counting the bytes it holds */
+template <class T> struct Counting_allocator {
+  using value_type = T;
+  Counting_allocator() = default;
+  template <class U> Counting_allocator(const Counting_allocator<U> &) {}
+  T *allocate(const std::size_t n) {
+    allocated += n * sizeof(T);
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T *p, const std::size_t n) {
+    allocated -= n * sizeof(T);
+    std::allocator<T>().deallocate(p, n);
+  }
+  template <class U> bool operator==(const Counting_allocator<U> &) const {
+    return true;
+  }
+  template <class U> bool operator!=(const Counting_allocator<U> &) const {
+    return false;
+  }
+};
+
+using COUNTED_SET = std::unordered_set<KEY_TYPE, std::hash<KEY_TYPE>,
+                                       std::equal_to<KEY_TYPE>,
+                                       Counting_allocator<KEY_TYPE>>;
+
+/** Runs the queries through the lookup; reports its space and time */
+template <class LOOKUP>
+static void run(const std::string &name, const UINT_64 bytes,
+                const UINT_64 num_keys, const std::vector<KEY_TYPE> &queries,
+                LOOKUP lookup) {
+  UINT_64 found = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (auto q : queries) {
+    found += lookup(q);
+  }
+  const double ns = std::chrono::duration<double, std::nano>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  std::cout << std::left << std::setw(16) << name << std::right
+            << std::setw(14) << bytes << " bytes" << std::setw(10)
+            << std::fixed << std::setprecision(2) << 8.0 * bytes / num_keys
+            << " bits/key" << std::setw(10) << ns / queries.size()
+            << " ns/lookup   (checksum " << found << ")" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " <key size> <number of keys> [number of queries]"
+              << std::endl;
+    return 1;
+  }
+  const int key_size = std::atoi(argv[1]);
+  const UINT_64 num_keys = std::stoull(argv[2]);
+  const UINT_64 num_queries = (argc > 3) ? std::stoull(argv[3]) : 10000000;
+  if (key_size < 1 || key_size > cMax_key_size ||
+      (key_size < cMax_key_size &&
+       num_keys > (static_cast<UINT_64>(1) << key_size) / 2)) {
+    std::cerr << "Invalid key size or too many keys" << std::endl;
+    return 1;
+  }
+
+  /* Keys: ad[0] and ad[1] alternately */
+  std::mt19937_64 random(42);
+  std::vector<std::unordered_set<KEY_TYPE>> ad(cNum_table);
+  std::unordered_set<KEY_TYPE> all;
+  std::vector<KEY_TYPE> keys;
+  while (keys.size() < num_keys) {
+    const KEY_TYPE key = random() & key_mask(key_size);
+    if (all.insert(key).second) {
+      ad[keys.size() % cNum_table].insert(key);
+      keys.push_back(key);
+    }
+  }
+  std::vector<KEY_TYPE> queries(num_queries);
+  for (auto &q : queries) {
+    q = (random() & 1) ? keys[random() % num_keys]
+                       : random() & key_mask(key_size);
+  }
+  std::cout << num_keys << " keys of " << key_size << " bits; "
+            << num_queries << " queries" << std::endl;
+
+  {
+    std::vector<COUNTED_SET> sets(cNum_table);
+    for (auto i = 0; i < cNum_table; ++i) {
+      sets[i].insert(ad[i].begin(), ad[i].end());
+    }
+    run("unordered_set", allocated + sizeof(sets[0]) * cNum_table, num_keys,
+        queries, [&](const KEY_TYPE q) -> UINT_64 {
+          if (sets[0].count(q) != 0) {
+            return cAd_force_1;
+          }
+          return (sets[1].count(q) != 0) ? cAd_force_0 : cAd_absent;
+        });
+  }
+  if (key_size <= Ad_bitmap::cMax_key_size) {
+    Ad_bitmap bitmap;
+    bitmap.build(key_size, ad);
+    run("Ad_bitmap", bitmap.size_in_bytes(), num_keys, queries,
+        [&](const KEY_TYPE q) -> UINT_64 { return bitmap.lookup(q); });
+  }
+  {
+    Ad_hash_table hash_table;
+    hash_table.build(ad);
+    run("Ad_hash_table", hash_table.size_in_bytes(), num_keys, queries,
+        [&](const KEY_TYPE q) -> UINT_64 { return hash_table.lookup(q); });
+  }
+  {
+    std::vector<std::vector<KEY_TYPE>> sorted(cNum_table);
+    for (auto i = 0; i < cNum_table; ++i) {
+      sorted[i].assign(ad[i].begin(), ad[i].end());
+      std::sort(sorted[i].begin(), sorted[i].end());
+    }
+    Ad_succinct succinct;
+    succinct.build(sorted);
+    run("Ad_succinct", succinct.size_in_bytes(), num_keys, queries,
+        [&](const KEY_TYPE q) -> UINT_64 { return succinct.lookup(q); });
+  }
+  return 0;
+}
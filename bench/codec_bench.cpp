@@ -0,0 +1,172 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+/** Benchmark of the compression and decompression of the Codec.
+ * The file is read and encoded once; its sequence is then compressed (and
+ * the compressed sequence packed and decompressed) as a single block the
+ * given number of times. It is then compressed in blocks (of the given number
+ * of characters; by default 8 blocks) in parallel (by the threads of OpenMP),
+ * which are decompressed together (@see Codec::decompress_blocks). The throughput is reported in characters of the
+ * file per second and in time per bit of the encoded sequence; the
+ * decompressed sequences are checked against the original one. Last, the
+ * whole file is decompressed as a single block (as most files are with the
+ * default block size).
+ *
+ * Usage: codec_bench <DNA|PROT|GEN> <anti-dictionary> <file> [repetitions]
+ * [block size]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+
+#include "../include/Codec.hpp"
+
+using namespace mawcd;
+
+/** Runs the step the given number of times; reports its throughput */
+template <class STEP>
+static void run(const std::string &name, const UINT_64 num_chars,
+                const UINT_64 num_bits, const int repetitions, STEP step) {
+  const auto start = std::chrono::steady_clock::now();
+  for (auto r = 0; r < repetitions; ++r) {
+    step();
+  }
+  const double ns = std::chrono::duration<double, std::nano>(
+                        std::chrono::steady_clock::now() - start)
+                        .count() /
+                    repetitions;
+  std::cout << std::left << std::setw(12) << name << std::right << std::fixed
+            << std::setprecision(2) << std::setw(10) << 1e3 * num_chars / ns
+            << " MB/s" << std::setw(10) << ns / num_bits << " ns/bit"
+            << std::endl;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0]
+              << " <DNA|PROT|GEN> <anti-dictionary> <file> [repetitions]"
+                 " [block size]"
+              << std::endl;
+    return 1;
+  }
+  const std::string alphabet(argv[1]);
+  const int repetitions = (argc > 4) ? std::atoi(argv[4]) : 10;
+  std::unique_ptr<Parser> parser;
+  if (alphabet == "DNA") {
+    parser.reset(new DnaParser());
+  } else if (alphabet == "PROT") {
+    parser.reset(new ProtParser());
+  } else if (alphabet == "GEN") {
+    parser.reset(new GenParser());
+  } else {
+    std::cerr << "Invalid alphabet " << alphabet << std::endl;
+    return 1;
+  }
+  Anti_dictionary ad{};
+  if (ad.load_binary(argv[2]) != ReturnStatus::SUCCESS) {
+    return 1;
+  }
+  std::ifstream infile(argv[3], std::ios::binary);
+  if (!infile.is_open() || repetitions < 1) {
+    std::cerr << "Cannot open file " << argv[3] << std::endl;
+    return 1;
+  }
+  std::stringstream buffer;
+  buffer << infile.rdbuf();
+  const std::string str = buffer.str();
+  SEQUENCE seq;
+  if (parser->encode_from_string(str, seq) != ReturnStatus::SUCCESS) {
+    return 1;
+  }
+
+  ComOptions options;
+  options.block_size =
+      (argc > 5) ? std::stoull(argv[5])
+                 : std::max<UINT_64>(
+                       (seq.size() / parser->get_code_len() + 7) / 8,
+                       cMin_block_size);
+  Codec codec(ad, options);
+  SEQUENCE compressed_seq;
+  bool is_contradicted = false;
+  run("compress", str.size(), seq.size(), repetitions, [&]() {
+    KEY_TYPE suffix = 0;
+    compressed_seq = codec.compress(seq, true, suffix, is_contradicted);
+  });
+  if (is_contradicted) {
+    std::cerr << "The anti-dictionary was not created for the file"
+              << std::endl;
+    return 1;
+  }
+  SEQUENCE hanging;
+  PACKED_SEQUENCE packed;
+  parser->pack_sequence(compressed_seq, hanging, packed);
+  parser->pack_sequence(SEQUENCE(), hanging, packed);
+  SEQUENCE decompressed_seq;
+  run("decompress", str.size(), seq.size(), repetitions, [&]() {
+    KEY_TYPE suffix = 0;
+    decompressed_seq = codec.decompress(seq.size(), packed, true, suffix);
+  });
+  std::cout << seq.size() << " bits compressed to " << compressed_seq.size()
+            << " bits; decompressed "
+            << ((decompressed_seq.size() == seq.size() &&
+                 decompressed_seq.words() == seq.words())
+                    ? "correctly"
+                    : "INCORRECTLY")
+            << std::endl;
+
+  std::vector<Codec::Block> blocks;
+  run("parallel", str.size(), seq.size(), repetitions, [&]() {
+    KEY_TYPE suffix = 0;
+    blocks = codec.compress_blocks(*parser, seq, true, suffix, is_contradicted);
+  });
+  std::vector<SEQUENCE> decompressed_seqs;
+  run("interleaved", str.size(), seq.size(), repetitions,
+      [&]() { decompressed_seqs = codec.decompress_blocks(blocks); });
+  SEQUENCE joined_seq;
+  for (const auto &block_seq : decompressed_seqs) {
+    joined_seq.append(block_seq);
+  }
+  std::cout << blocks.size() << " blocks of " << options.block_size
+            << " characters decompressed together "
+            << ((joined_seq.size() == seq.size() &&
+                 joined_seq.words() == seq.words())
+                    ? "correctly"
+                    : "INCORRECTLY")
+            << std::endl;
+
+  // the whole file in a single block (as by default but for the largest)
+  ComOptions one_block_options;
+  one_block_options.block_size =
+      std::max<UINT_64>(str.size(), one_block_options.block_size);
+  Codec one_block_codec(ad, one_block_options);
+  KEY_TYPE suffix = 0;
+  blocks = one_block_codec.compress_blocks(*parser, seq, true, suffix,
+                                           is_contradicted);
+  run("one block", str.size(), seq.size(), repetitions,
+      [&]() { decompressed_seqs = one_block_codec.decompress_blocks(blocks); });
+  std::cout << blocks.size() << " block decompressed "
+            << ((decompressed_seqs.size() == 1 &&
+                 decompressed_seqs[0].size() == seq.size() &&
+                 decompressed_seqs[0].words() == seq.words())
+                    ? "correctly"
+                    : "INCORRECTLY")
+            << std::endl;
+  return 0;
+}
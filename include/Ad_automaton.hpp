@@ -0,0 +1,119 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/** @file Ad_automaton.hpp
+ * @brief Defines the class Ad_automaton.
+ * It is the antifactor automaton (as in DCA: Data Compression using
+ * Antidictionaries) of a multi-length anti-dictionary.
+ */
+
+#ifndef AD_AUTOMATON_HPP
+#define AD_AUTOMATON_HPP
+
+#include <algorithm>
+#include <array>
+
+#include "globalDefs.hpp"
+
+namespace mawcd {
+/** Class Ad_automaton
+ * An Ad_automaton is the deterministic automaton over the binary alphabet
+ * recognising the words which have no maw (of the anti-dictionary) as a
+ * factor.
+ * - States are the proper prefixes of the maws; cRoot is the empty word.
+ * - From state u, bit b leads to the longest suffix of ub which is a state.
+ * - State u forces bit b if u(1-b) has a suffix which is a maw (thus it can
+ *   never be followed by 1-b in the sequence).
+ *
+ * Each state is a single 64-bit record so that a step is one array load:
+ * - bits 0 to 30: next state on 0
+ * - bits 31 to 61: next state on 1
+ * - bits 62 and 63: entry of the state (cAd_absent, cAd_force_0 or
+ *   cAd_force_1)
+ *
+ * The records are either owned (built) or mapped from an anti-dictionary file
+ * (@see Anti_dictionary::load_binary), thus an Ad_automaton is not copied.
+ */
+class Ad_automaton {
+public:
+  Ad_automaton() = default;
+  Ad_automaton(const Ad_automaton &) = delete;
+  Ad_automaton &operator=(const Ad_automaton &) = delete;
+
+  using STATE = UINT_32;
+  static const STATE cRoot = 0;
+  /** Maximum number of states */
+  static const UINT_64 cMax_states = (static_cast<UINT_64>(1) << 31) - 1;
+
+  /** @brief Builds the automaton of the given maws.
+   * @param maws maws[l] are the maws of length l (bits), each given by its
+   * value (first bit most significant)
+   *
+   * @return execution status // ERR_LIMIT_EXCEEDS if there are more than
+   * cMax_states states.
+   */
+  ReturnStatus build(const std::vector<std::vector<KEY_TYPE>> &maws);
+
+  /** @brief Uses the given records (as built) in place; they must outlive the
+   * automaton.
+   */
+  void map(const UINT_64 *states, const UINT_64 num_states);
+
+  /** @brief Releases the automaton.
+   */
+  void clear();
+
+  /** @brief Tests if the automaton has not been built.
+   */
+  bool empty() const { return _num_states == 0; }
+
+  /** @brief Number of states.
+   */
+  UINT_64 num_states() const { return _num_states; }
+
+  /** @brief Space taken by the state table.
+   */
+  UINT_64 size_in_bytes() const { return _num_states * sizeof(UINT_64); }
+
+  /** @brief Records of the states (to be saved as they are).
+   */
+  const UINT_64 *states() const { return _states; }
+
+  /** @brief Record of the state (its transitions and entry).
+   */
+  UINT_64 record(const STATE state) const { return _states[state]; }
+
+  /** @brief Entry (cAd_absent, cAd_force_0 or cAd_force_1) of a record.
+   */
+  static UINT_8 entry(const UINT_64 record) {
+    return static_cast<UINT_8>(record >> 62);
+  }
+
+  /** @brief Next state from a record on the given bit.
+   */
+  static STATE next(const UINT_64 record, const bool bit) {
+    return static_cast<STATE>((record >> (bit ? 31 : 0)) & cMax_states);
+  }
+
+  //////////////////////// private ////////////////////////
+private:
+  const UINT_64 *_states = nullptr; //< records of the states
+  UINT_64 _num_states = 0;
+  std::vector<UINT_64> _storage; //< records when built (not mapped)
+};
+
+} // end namespace
+#endif
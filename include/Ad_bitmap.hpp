@@ -0,0 +1,129 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/** @file Ad_bitmap.hpp
+ * @brief Defines the class Ad_bitmap.
+ * It is the direct-indexed lookup structure of an anti-dictionary with short
+ * keys.
+ */
+
+#ifndef AD_BITMAP_HPP
+#define AD_BITMAP_HPP
+
+#include <unordered_set>
+
+#include "globalDefs.hpp"
+
+namespace mawcd {
+/** Class Ad_bitmap
+ * An Ad_bitmap stores 2 bits for every possible key of the given length:
+ * - cAd_absent (00): the key is not in the anti-dictionary
+ * - cAd_force_0 (10): the key is followed only by '0'
+ * - cAd_force_1 (11): the key is followed only by '1'
+ * Thus a lookup is a single load and shift. It takes 2^(key_size - 2) bytes,
+ * so it is used only for keys of at most cMax_key_size bits.
+ *
+ * The words are either owned (built) or mapped from an anti-dictionary file
+ * (@see Anti_dictionary::load_binary), thus an Ad_bitmap is not copied.
+ */
+class Ad_bitmap {
+public:
+  Ad_bitmap() = default;
+  Ad_bitmap(const Ad_bitmap &) = delete;
+  Ad_bitmap &operator=(const Ad_bitmap &) = delete;
+
+  /** Longest key (in bits) for which the bitmap is built (64MB) */
+  static const int cMax_key_size = 28;
+
+  /** @brief Builds the bitmap from the two tables of the anti-dictionary.
+   * @param key_size length of the keys (at most cMax_key_size)
+   * @param ad tables of keys: ad[0] of the maws ending in '0' (thus followed by
+   * '1'); ad[1] of those ending in '1'
+   */
+  void build(const int key_size,
+             const std::vector<std::unordered_set<KEY_TYPE>> &ad);
+
+  /** @brief Builds the bitmap from the keys of the two tables (e.g. as read
+   * from a compact anti-dictionary file).
+   */
+  void build(const int key_size, const std::vector<std::vector<KEY_TYPE>> &ad);
+
+  /** @brief Uses the given words (as built for keys of key_size bits) in
+   * place; they must outlive the bitmap.
+   */
+  void map(const UINT_64 *words, const UINT_64 num_words);
+
+  /** @brief Number of words needed for keys of the given length.
+   */
+  static UINT_64 num_words_for(const int key_size);
+
+  /** @brief Releases the bitmap.
+   */
+  void clear();
+
+  /** @brief Tests if the bitmap has not been built.
+   */
+  bool empty() const { return _num_words == 0; }
+
+  /** @brief Entry of the key (cAd_absent, cAd_force_0 or cAd_force_1).
+   * Assumes the key to be less than 2^key_size.
+   */
+  UINT_8 lookup(const KEY_TYPE key) const;
+
+  /** @brief Starts loading the word of the key in the cache, for a lookup
+   * which will follow shortly (after those of other keys).
+   */
+  void prefetch(const KEY_TYPE key) const;
+
+  /** @brief Space taken by the bitmap.
+   */
+  UINT_64 size_in_bytes() const { return _num_words * sizeof(UINT_64); }
+
+  /** @brief Words of the bitmap (to be saved as they are).
+   */
+  const UINT_64 *words() const { return _words; }
+
+  /** @brief Number of words of the bitmap.
+   */
+  UINT_64 num_words() const { return _num_words; }
+
+  //////////////////////// private ////////////////////////
+private:
+  /** Entries packed 32 per word; that of key k is at bits 2(k%32), 2(k%32)+1
+   * of word k/32 */
+  const UINT_64 *_words = nullptr;
+  UINT_64 _num_words = 0;
+  std::vector<UINT_64> _storage; //< words when built (not mapped)
+
+  /** @brief Implements build() for both kinds of tables.
+   */
+  template <class TABLES>
+  void build_from(const int key_size, const TABLES &ad);
+};
+
+//////////////////////// inline ////////////////////////
+// Called for every bit in compression and decompression.
+
+inline UINT_8 Ad_bitmap::lookup(const KEY_TYPE key) const {
+  return static_cast<UINT_8>((_words[key >> 5] >> ((key & 31) << 1)) & 3);
+}
+
+inline void Ad_bitmap::prefetch(const KEY_TYPE key) const {
+  __builtin_prefetch(_words + (key >> 5));
+}
+
+} // end namespace
+#endif
@@ -0,0 +1,205 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/** @file Ad_hash_table.hpp
+ * @brief Defines the class Ad_hash_table.
+ * It is the open-addressing lookup structure of an anti-dictionary with long
+ * keys.
+ */
+
+#ifndef AD_HASH_TABLE_HPP
+#define AD_HASH_TABLE_HPP
+
+#include <unordered_set>
+
+#include "globalDefs.hpp"
+
+namespace mawcd {
+/** Class Ad_hash_table
+ * An Ad_hash_table is a flat open-addressing hash-table (in the style of a
+ * Swiss-table) holding the keys of both the tables of an anti-dictionary:
+ * - Slots are arranged in groups of cGroup_size, each group in one cache
+ *   line: a control word (a byte per slot) followed by the keys of its slots.
+ * - A control byte is either cEmpty or holds the lowest 6 bits of the hash of
+ *   the key of its slot (its tag) and the bit forced after the key. The
+ *   control bytes of a group are compared against the tag at once (within
+ *   the word) so that only the matching keys are compared.
+ * - Groups are probed quadratically starting from the one given by the hash
+ *   until a group having an empty slot; a lookup thus mostly reads a single
+ *   cache line.
+ * - Load factor is kept at most cMax_load.
+ *
+ * The groups are either owned (built) or mapped from an anti-dictionary file
+ * (@see Anti_dictionary::load_binary), thus an Ad_hash_table is not copied.
+ */
+class Ad_hash_table {
+public:
+  /** Number of slots in a group */
+  static const int cGroup_size = 7;
+
+  /** Group of slots (of a cache line): byte i of ctrl (from the lowest) is
+   * the control byte of keys[i]; its highest byte is zero */
+  struct Group {
+    UINT_64 ctrl;
+    KEY_TYPE keys[cGroup_size];
+  };
+
+  Ad_hash_table() = default;
+  Ad_hash_table(const Ad_hash_table &) = delete;
+  Ad_hash_table &operator=(const Ad_hash_table &) = delete;
+
+  /** Maximum load factor */
+  static constexpr double cMax_load = 0.875;
+
+  /** @brief Builds the table from the two tables of the anti-dictionary.
+   * @param ad tables of keys: ad[0] of the maws ending in '0' (thus followed by
+   * '1'); ad[1] of those ending in '1'
+   */
+  void build(const std::vector<std::unordered_set<KEY_TYPE>> &ad);
+
+  /** @brief Builds the table from the keys of the two tables (e.g. as read
+   * from a compact anti-dictionary file).
+   */
+  void build(const std::vector<std::vector<KEY_TYPE>> &ad);
+
+  /** @brief Uses the given groups (as built) in place; they must outlive the
+   * table (and be aligned on a cache line to be read a line each).
+   * @param num_groups number of groups: a power of 2
+   * @param size number of keys (at most cMax_load of the slots)
+   */
+  void map(const Group *groups, const UINT_64 num_groups, const UINT_64 size);
+
+  /** @brief Releases the table.
+   */
+  void clear();
+
+  /** @brief Tests if the table has not been built.
+   */
+  bool empty() const { return _groups == nullptr; }
+
+  /** @brief Entry of the key (cAd_absent, cAd_force_0 or cAd_force_1).
+   */
+  UINT_8 lookup(const KEY_TYPE key) const;
+
+  /** @brief Starts loading the first group probed for the key in the cache,
+   * for a lookup which will follow shortly (after those of other keys).
+   */
+  void prefetch(const KEY_TYPE key) const;
+
+  /** @brief Number of keys stored.
+   */
+  UINT_64 size() const { return _size; }
+
+  /** @brief Ratio of the number of keys to the number of slots.
+   */
+  double load_factor() const;
+
+  /** @brief Space taken by the table (its groups).
+   */
+  UINT_64 size_in_bytes() const;
+
+  /** @brief Groups (to be saved as they are).
+   */
+  const Group *groups() const { return _groups; }
+
+  /** @brief Number of groups.
+   */
+  UINT_64 num_groups() const { return empty() ? 0 : _group_mask + 1; }
+
+  //////////////////////// private ////////////////////////
+private:
+  /** Control byte of an empty slot (the only one with the highest bit set) */
+  static const UINT_8 cEmpty = 0x80;
+  /** Bits of a control byte holding the tag of the key */
+  static const UINT_8 cTag_mask = 0x3F;
+  /** Bit of a control byte holding the bit forced after the key */
+  static const int cForced_shift = 6;
+  /** Lowest bit of the control bytes of the slots of a group */
+  static const UINT_64 cLow_bits = 0x0001010101010101ULL;
+  /** Highest bit of the control bytes of the slots of a group */
+  static const UINT_64 cHigh_bits = cLow_bits << 7;
+
+  const Group *_groups = nullptr;
+  UINT_64 _group_mask = 0; //< number of groups (a power of 2) - 1
+  UINT_64 _size = 0;       //< number of keys
+  /** Groups when built (not mapped), aligned within it on a cache line */
+  std::vector<Group> _group_storage;
+
+  /** @brief Hash of the key (its bits well mixed).
+   */
+  static UINT_64 hash(const KEY_TYPE key);
+
+  /** @brief Control bytes of the group whose tag is the given one (the
+   * highest bit of each of them set).
+   */
+  static UINT_64 match(const UINT_64 ctrl, const UINT_64 tag);
+
+  /** @brief Inserts the key (assumed not to be present).
+   */
+  void insert(const KEY_TYPE key, const UINT_8 entry);
+
+  /** @brief Implements build() for both kinds of tables.
+   */
+  template <class TABLES> void build_from(const TABLES &ad);
+};
+
+//////////////////////// inline ////////////////////////
+// Called for every bit in compression and decompression.
+
+inline UINT_64 Ad_hash_table::hash(const KEY_TYPE key) {
+  UINT_64 h = static_cast<UINT_64>(key);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+inline UINT_64 Ad_hash_table::match(const UINT_64 ctrl, const UINT_64 tag) {
+  // zero bytes of x (but the forced bits) are the matching ones; the byte of
+  // an empty slot is not zero (highest bit)
+  const UINT_64 x =
+      (ctrl & ~(cLow_bits << cForced_shift)) ^ (tag * cLow_bits);
+  const UINT_64 low_7 = cHigh_bits - cLow_bits;
+  return ~(((x & low_7) + low_7) | x) & cHigh_bits;
+}
+
+inline UINT_8 Ad_hash_table::lookup(const KEY_TYPE key) const {
+  const UINT_64 h = hash(key);
+  UINT_64 group = (h >> 7) & _group_mask;
+  for (UINT_64 step = 1;; ++step) {
+    const Group &g = _groups[group];
+    for (UINT_64 m = match(g.ctrl, h & cTag_mask); m != 0; m &= m - 1) {
+      const int i = __builtin_ctzll(m) / cByte_Size;
+      if (g.keys[i] == key) {
+        return cAd_force_0 |
+               ((g.ctrl >> (i * cByte_Size + cForced_shift)) & 1);
+      }
+    }
+    if ((g.ctrl & cHigh_bits) != 0) { // an empty slot: key is absent
+      return cAd_absent;
+    }
+    group = (group + step) & _group_mask;
+  }
+}
+
+inline void Ad_hash_table::prefetch(const KEY_TYPE key) const {
+  __builtin_prefetch(_groups + ((hash(key) >> 7) & _group_mask));
+}
+
+} // end namespace
+#endif
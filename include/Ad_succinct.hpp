@@ -0,0 +1,102 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+/** @file Ad_succinct.hpp
+ * @brief Defines the class Ad_succinct.
+ * It is the compressed lookup structure of an anti-dictionary.
+ */
+
+#ifndef AD_SUCCINCT_HPP
+#define AD_SUCCINCT_HPP
+
+#include <array>
+
+#include <sdsl/sd_vector.hpp>
+
+#include "globalDefs.hpp"
+
+namespace mawcd {
+/** Class Ad_succinct
+ * An Ad_succinct stores the keys of each table of an anti-dictionary as an
+ * Elias-Fano coded bit-vector (sdsl::sd_vector) over the keys: about
+ * 2 + log(2^key_size / #keys) bits per key, whatever the key size.
+ * A key is looked up by accessing its bit in both the vectors, that is a
+ * select on the high parts and a short scan of the low parts; thus it is
+ * slower than Ad_bitmap and Ad_hash_table but takes a fraction of their space.
+ * It is meant for keeping many anti-dictionaries resident.
+ */
+class Ad_succinct {
+public:
+  /** @brief Builds the vectors from the keys of the two tables.
+   * @param keys keys[0] of the maws ending in '0' (thus followed by '1');
+   * keys[1] of those ending in '1'; each in ascending order
+   */
+  void build(const std::vector<std::vector<KEY_TYPE>> &keys);
+
+  /** @brief Releases the vectors.
+   */
+  void clear();
+
+  /** @brief Tests if the structure has not been built.
+   */
+  bool empty() const { return !_is_built; }
+
+  /** @brief Entry of the key (cAd_absent, cAd_force_0 or cAd_force_1).
+   */
+  UINT_8 lookup(const KEY_TYPE key) const;
+
+  /** @brief Number of keys stored.
+   */
+  UINT_64 size() const { return _size; }
+
+  /** @brief Space taken by the vectors.
+   */
+  UINT_64 size_in_bytes() const;
+
+  /** @brief Average number of bits taken by a key.
+   */
+  double bits_per_key() const;
+
+  //////////////////////// private ////////////////////////
+private:
+  /** Keys of the tables; the bit of a key is set in the vector of its table.
+   * The vector of a table ends with its largest key. */
+  std::array<sdsl::sd_vector<>, cNum_table> _tables;
+  /** The largest key (all ones) can not be in a vector (of size key + 1); it
+   * is kept aside */
+  std::array<bool, cNum_table> _has_all_ones = {{false, false}};
+  UINT_64 _size = 0;
+  bool _is_built = false;
+};
+
+//////////////////////// inline ////////////////////////
+// Called for every bit in compression and decompression.
+
+inline UINT_8 Ad_succinct::lookup(const KEY_TYPE key) const {
+  const UINT_8 entries[cNum_table] = {cAd_force_1, cAd_force_0};
+  for (auto i = 0; i < cNum_table; ++i) {
+    if (key < _tables[i].size() ? _tables[i][key] != 0
+                                : (key == ~static_cast<KEY_TYPE>(0) &&
+                                   _has_all_ones[i])) {
+      return entries[i];
+    }
+  }
+  return cAd_absent;
+}
+
+} // end namespace
+#endif
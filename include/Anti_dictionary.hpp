@@ -27,15 +27,18 @@ Pissis
 #include <numeric>
 #include <sstream>
 #include <unordered_set>
-// NOTE: SDSL SA Construction doesn,t work with 0 as a character
-#include <sdsl/suffix_arrays.hpp>
 
+#include "Ad_automaton.hpp"
+#include "Ad_bitmap.hpp"
+#include "Ad_hash_table.hpp"
+#include "Ad_succinct.hpp"
+#include "Mapped_file.hpp"
+#include "Maw_engine.hpp"
 #include "Parser.hpp"
 #include "globalDefs.hpp"
 #include "utilDefs.hpp"
 namespace mawcd {
 
-// TODO: Handle endian-ness
 class Anti_dictionary {
 
 public:
@@ -53,29 +56,102 @@ public:
 
    * The type of the key of hash-tables is KEY_TYPE (see globalDefs.h).
   Currently
-  it is 32-bits unsigned int.
+  it is 64-bits unsigned int.
    *
-   * Input file is assumed to be in Fasta Format (requirement for maw-tool).
-   *  - It calls maw-tool to generate a temporary file (deleted at the end).
+   * The maws are computed in memory from the encoded sequence (@see
+  Maw_engine).
    *  - Choses the length of the key to be used from these maws (@see function
   choose_maw_size).
-   *  - Goes through the file again to load (select, encode, and insert into
+   *  - Goes through the maws again to load (select and insert into
   corresponding hash-table) the maws of chosen length.
    *
-   * @param filename name of the file containing the sequence with respect to
-  which the anti-dictionary will be created.
-   * @param parser reference to the Parser instance given for encoding/decoding
-  the sequence to/from internal representation.
+   * If options.is_multi_length, maws of all the lengths are kept instead
+  (@see load_all_maws) which are compiled into an automaton.
+   * If options.is_gain_selection, maws of all the lengths are selected by
+  their own gain instead, within options.max_keys (@see select_maws).
+   *
+   * @param seq reference to the encoded sequence with respect to which the
+  anti-dictionary will be created.
+   * @param options options for the creation (@see AdOptions)
+   *
+   * @return execution status // SUCCESS if input is valid, otherwise
+  corresponding error code after logging the error.
+  */
+  ReturnStatus create(const SEQUENCE &seq,
+                      const AdOptions &options = AdOptions());
+
+  /** @brief Creates the anti-dictionary of a collection of documents (e.g.
+  the files of a training corpus): its maws are those of the collection, no
+  word spanning two documents being taken into account (@see Maw_engine).
+   *
+   * @param seq reference to the encoded documents, one after the other.
+   * @param doc_start first bit of each document (increasing, from 0).
+   * @param options options for the creation (@see AdOptions)
+   *
+   * @return execution status // SUCCESS if input is valid, otherwise
+  corresponding error code after logging the error.
+  */
+  ReturnStatus create(const SEQUENCE &seq,
+                      const std::vector<UINT_64> &doc_start,
+                      const AdOptions &options = AdOptions());
+
+  /** @brief Creates the anti-dictionary of the collection of documents of
+  the given file, indexed in external memory (@see Maw_engine::build): the
+  sequence is never loaded in memory.
+   *
+   * @param seq_file reference to the file of the encoded documents.
+   * @param doc_start first bit of each document (increasing, from 0).
+   * @param options options for the creation (@see AdOptions)
+   *
+   * @return execution status // SUCCESS if input is valid, otherwise
+  corresponding error code after logging the error.
+  */
+  ReturnStatus create(Sequence_file &seq_file,
+                      const std::vector<UINT_64> &doc_start,
+                      const AdOptions &options = AdOptions());
+
+  /** @brief Updates the anti-dictionary (read or loaded) with a collection of
+  new documents, so that it describes them as well without being created
+  again from the whole collection:
+   * - Each key whose maw occurs in the new documents (i.e. the key is followed
+  by the last letter of its maw) is removed; the new documents are scanned
+  once, each document on its own (as a file is compressed).
+   * - If options.is_adding_maws, the new documents are indexed (@see
+  Maw_engine) and their maws of positive gain, of the lengths of the
+  anti-dictionary (the key size is kept), are added: those of highest gain
+  first, as long as there are at most options.max_keys keys and (multi-length
+  only) the automaton has at most options.max_states states. A maw is added
+  only if it is known to be absent from the earlier documents too, so that
+  their files still compress: if old_seq is given, it does not occur there;
+  otherwise, one of the maws removed (absent from the earlier documents) is
+  a factor of it, which no maw of a single-length anti-dictionary can have.
+  A key whose two maws are both candidates is left out (never followed).
+   * The lookup structure is then built again and the anti-dictionary gets
+  the id of its new keys (@see get_id).
+   *
+   * @param seq reference to the encoded new documents, one after the other.
+   * @param doc_start first bit of each document (increasing, from 0).
+   * @param options options for the update (@see AdOptions)
+   * @param old_seq reference to the encoded earlier documents (empty if not
+   * given; used if options.is_adding_maws).
+   * @param old_doc_start first bit of each earlier document.
    *
    * @return execution status // SUCCESS if input is valid, otherwise
   corresponding error code after logging the error.
   */
-  ReturnStatus create(const std::string filename, const Parser &parser);
+  ReturnStatus update(const SEQUENCE &seq,
+                      const std::vector<UINT_64> &doc_start,
+                      const AdOptions &options = AdOptions(),
+                      const SEQUENCE &old_seq = SEQUENCE(),
+                      const std::vector<UINT_64> &old_doc_start =
+                          std::vector<UINT_64>());
 
   /** @brief Reads AD in text format (corresponding to one sequence).
   * First-line gives the length of keys used;
   * newline-seperated keys.
   * Empty line demarcation between keys corresponding to 0 and 1.
+  * The lookup structure is chosen once the keys are read (@see
+  * choose_lookup).
   */
   ReturnStatus read(std::ifstream &adfile);
 
@@ -83,13 +159,34 @@ public:
   * First-line gives the length of keys used;
   * newline-seperated keys.
   * Empty line demarcation between keys corresponding to 0 and 1.
+  * (Only for single-length anti-dictionary.)
   */
   ReturnStatus write(std::ofstream &adfile) const;
 
-  /** @brief Reading anti-dictionary in the binary format: READS ONE SEQUENCE
+  /** @brief Loads anti-dictionary from a binary file (@see write_binary).
+   * The file is mapped in memory and its lookup structure is used in place:
+   * after checking the header and the checksum, nothing is parsed or built,
+   * so that the compression can start at once.
+   * Compact files (version 3) hold only the keys: they are decoded and the
+   * lookup structure is built from them (@see write_binary).
+   * Files in the format of the releases before the versioned one (without
+   * the magic) are read by read_binary instead.
+   * If is_succinct, the keys are looked up in compressed space instead
+   * (@see Ad_succinct), built from the keys of the file (ignored for a
+   * multi-length anti-dictionary).
+   *
+   * @return execution status // ERR_FILE_OPEN if the file cannot be opened,
+   * ERR_INVALID_INPUT if it is truncated, corrupt (checksum), of an unknown
+   * version or written on a machine of the other byte order.
+   */
+  ReturnStatus load_binary(const std::string &filename,
+                           const bool is_succinct = false);
+
+  /** @brief Reading anti-dictionary in the binary format of the releases
+   * before the versioned one (without magic): READS ONE SEQUENCE
    * For a single sequence, following is the format:
-   * First one byte: 0: Actual Key_size: from 1 to 32 (space used by each key is
-   * given by KEY_SIZE)
+   * First one byte: 0: Actual Key_size: from 1 to 32 (keys were then of 32
+   * bits)
    * Next one byte: 1: number of keys of one byte in ad_0
    * Next one byte: 2: number of keys of one byte in ad_1
    * Next two bytes: 3 and 4: number of keys of two bytes in ad_0
@@ -97,41 +194,107 @@ public:
    * Next four bytes: 7 to 10: number of keys of four bytes in ad_0
    * Next four bytes: 11 to 14: number of keys of four bytes in ad_1
    * From there on, the keys of ad_0 start: keys in ad_0 of size 1, then size 2,
-   * then 3, and then 4 (size in bytes, number as above)
+   * and then 4 (size in bytes, number as above)
    * Following them are the keys for ad_1: keys in ad_1 of size 1, then size 2,
-   * then 3, and then 4 (size in bytes, number as above)
+   * and then 4 (size in bytes, number as above)
    *
-   * The same repeats for all the sequences.
+   * The keys must make the rest of the file exactly and fit in the key size,
+   * otherwise ERR_INVALID_INPUT is returned.
+   * The lookup structure is chosen once the keys are read (@see
+   * choose_lookup).
    */
   ReturnStatus read_binary(std::ifstream &adfile);
 
-  /** @brief Writing anti-dictionary in the binary format: WRITES ONE SEQUENCE
-   * For a single sequence, following is the format:
-   * First one byte: 0: Actual Key_size: from 1 to 32 (space used by each key is
-   * given by KEY_SIZE)
-   * Next one byte: 1: number of keys of one byte in ad_0
-   * Next one byte: 2: number of keys of one byte in ad_1
-   * Next two bytes: 3 and 4: number of keys of two bytes in ad_0
-   * Next two bytes: 5 and 6: number of keys of two bytes in ad_1
-   * Next four bytes: 7 to 10: number of keys of four bytes in ad_0
-   * Next four bytes: 11 to 14: number of keys of four bytes in ad_1
-   * From there on, the keys of ad_0 start: keys in ad_0 of size 1, then size 2,
-   * then 3, and then 4 (size in bytes, number as above)
-   * Following them are the keys for ad_1: keys in ad_1 of size 1, then size 2,
-   * then 3, and then 4 (size in bytes, number as above)
+  /** @brief Writing anti-dictionary in the binary format (version 2): WRITES
+   * ONE SEQUENCE
+   * The file holds the lookup structure exactly as it is in memory so that it
+   * can be mapped (@see load_binary). Numbers are in the byte order of the
+   * machine, which is recorded in the header.
+   * Header (64 bytes):
+   * bytes 0 to 7: magic "MAWCDAD" (null-terminated)
+   * bytes 8 to 11: version (2)
+   * bytes 12 to 15: byte order mark 0x01020304
+   * byte 16: key size (0 for multi-length anti-dictionary)
+   * byte 17: key width: number of bytes of KEY_TYPE
+   * byte 18: lookup structure: 0 for Ad_bitmap, 2 for Ad_automaton, 3 for
+   * Ad_hash_table
+   * byte 19: zero
+   * bytes 20 to 23: id of the anti-dictionary (@see get_id); if 0, it is
+   * computed from the keys when the file is loaded
+   * bytes 24 to 31: number of keys (or maws)
+   * bytes 32 to 39: number of words of the bitmap, groups of the hash-table or
+   * states of the automaton
+   * bytes 40 to 47: number of keys in the hash-table (0 otherwise)
+   * bytes 48 to 55: number of bytes of the payload (following the header)
+   * bytes 56 to 63: checksum of the payload
+   * Payload: sections, each padded with zeros to a multiple of 32 bytes:
+   * - the lookup structure: the words of the bitmap; or the groups of the
+   *   hash-table (64 bytes each); or the records of the automaton
+   * - the number of keys of ad_0 and ad_1 (eight bytes each); for a
+   *   multi-length anti-dictionary, the number of maws of each length from 0
+   *   to cMax_key_size
+   * - the keys in that order (eight bytes each), ascending within each group
+   * The keys are not needed for lookups; they are kept for printing and
+   * rewriting the anti-dictionary.
    *
-   * The same repeats for all the sequences.
-  */
-  ReturnStatus write_binary(std::ofstream &adfile) const;
+   * If is_compact, only the keys are saved, coded (version 3), to make the
+   * file several times smaller when it is shipped with the compressed files;
+   * the lookup structure is then built when the file is loaded. The header is
+   * the same but for:
+   * bytes 8 to 11: version (3)
+   * byte 18: 0
+   * bytes 32 to 39: number of groups of keys (2; cMax_key_size+1 for
+   * multi-length anti-dictionary)
+   * bytes 40 to 47: 0
+   * Payload: one section (padded as above) of varints (7 bits per byte, least
+   * significant first, the highest bit set on every byte but the last): for
+   * each group in the order above, the number of its keys, then the first key
+   * and the gaps between consecutive keys (ascending).
+   *
+   * @return execution status // ERR_FILE_OPEN if the file cannot be written;
+   * ERR_INVALID_INPUT if the keys are looked up in compressed space (there is
+   * no lookup structure to save) and the file is not compact.
+   */
+  ReturnStatus write_binary(std::ofstream &adfile,
+                            const bool is_compact = false) const;
 
   /** @brief Infers the next character following a given suffix (key).
    * If it finds the key in ad_0, returns true and '1' in letter
    * If it finds the key in ad_1, returns true and '0' in letter
    * Otherwise returns false
+   * It is a single load from the bitmap (for short keys) and a probe in the
+   * open-addressing hash-table otherwise; or an access to the Elias-Fano
+   * coded keys when they are looked up in compressed space.
+   * (Only for single-length anti-dictionary.)
    */
   bool find_following_letter(const KEY_TYPE &key, char &letter) const;
 
-  /** @brief Finds the size of the key.
+  /** @brief Tests if the anti-dictionary has maws of all the lengths (thus is
+   * used through its automaton) rather than keys of a single length.
+   */
+  bool is_multi_length() const { return _is_multi_length; }
+
+  /** @brief Id of the anti-dictionary: a (non-zero) hash of its key size and
+   * keys, recorded in its files and in the files compressed with it so that
+   * they are decompressed with the same keys; updating the anti-dictionary
+   * thus changes its id, whatever format it is saved in.
+   */
+  UINT_32 get_id() const { return _id; }
+
+  /** @brief Automaton of a multi-length anti-dictionary.
+   */
+  const Ad_automaton &get_automaton() const { return _automaton; }
+
+  /** @brief Structures used for lookups (@see choose_lookup): only one of
+   * them is not empty, that find_following_letter uses. A loop over many keys
+   * tests it once and then calls its lookup directly.
+   * (Only for single-length anti-dictionary.)
+   */
+  const Ad_bitmap &get_bitmap() const { return _bitmap; }
+  const Ad_hash_table &get_hash_table() const { return _hash_table; }
+  const Ad_succinct &get_succinct() const { return _succinct; }
+
+  /** @brief Finds the size of the key (0 for multi-length anti-dictionary).
  */
   int get_key_size() const;
 
@@ -150,11 +313,72 @@ private:
   std::vector<std::unordered_set<KEY_TYPE>> _ad =
       std::vector<std::unordered_set<KEY_TYPE>>(cNum_table);
 
-  int _ad_size; //< total size (number of maws) in all the ad
+  int _ad_size = 0; //< total size (number of maws) in all the ad
+
+  /** Structures used for lookups (@see choose_lookup); only one of them is
+   * built (the other is empty) */
+  Ad_bitmap _bitmap;         //< direct-indexed; for short keys
+  Ad_hash_table _hash_table; //< open-addressing; for long keys
+  Ad_succinct _succinct;     //< compressed; if _is_succinct
+  bool _is_succinct = false;
 
   KEY_SIZE _key_size; // length of the keys (longest prefix of the chosen maws)
                       // in ad; Same for all ad.
 
+  /** Multi-length anti-dictionary: _maws[l] are the maws of length l (the
+   * tables above are then empty) */
+  bool _is_multi_length = false;
+  std::vector<std::vector<KEY_TYPE>> _maws;
+  Ad_automaton _automaton; //< built from _maws
+
+  /** File mapped by load_binary; the lookup structures then point in it and
+   * the keys are left in it (_key_counts, then the keys) */
+  Mapped_file _file;
+  const UINT_64 *_key_counts = nullptr;
+
+  /** Keys of a single-length anti-dictionary read from a compact file (as
+   * sorted_keys()); the tables above are then empty */
+  std::vector<std::vector<KEY_TYPE>> _decoded_keys;
+
+  UINT_32 _id = 0; //< @see get_id
+
+  /** @brief Maps the lookup structure of the file (version 2) opened in
+   * _file after checking it (@see load_binary).
+   */
+  ReturnStatus map_binary();
+
+  /** @brief Decodes the keys of the compact file (version 3) opened in _file
+   * after checking its header, and builds the lookup structure from them.
+   *
+   * @param key_size key size of the header (0 for multi-length).
+   * @return execution status // ERR_INVALID_INPUT if the keys are not valid.
+   */
+  ReturnStatus decode_compact(const int key_size);
+
+  /** @brief Keys in ascending order: those of ad_0 and ad_1; or for a
+   * multi-length anti-dictionary, the maws of each length from 0 to
+   * cMax_key_size. They come from the file when mapped.
+   */
+  std::vector<std::vector<KEY_TYPE>> sorted_keys() const;
+
+  /** @brief Computes the id of the anti-dictionary from its keys (@see
+   * get_id).
+   */
+  UINT_32 compute_id() const;
+
+  /** @brief Chooses the structure used for lookups
+   * (@see find_following_letter): builds the bitmap if the keys are of at most
+   * Ad_bitmap::cMax_key_size bits; otherwise the open-addressing hash-table;
+   * the succinct structure instead of both if _is_succinct.
+   * For multi-length anti-dictionary, it builds the automaton.
+   * It reports the memory taken by the chosen structure.
+   */
+  ReturnStatus choose_lookup();
+
+  /** @brief Builds the succinct structure from the keys and reports its size.
+   */
+  void build_succinct();
+
   /** @brief Chooses the length of the maws to be stored in the anti-dictionary
    * and
    * store l-1 as the key-size.
@@ -171,45 +395,134 @@ private:
    * such l.
    *  If there is no such l that gives a positive c, we choose the shortest
    * length of maws.
-   * We use the Compressed Suffix Array to find the number of occurrences of the
-   * longest prefix of a maw.
+   * The number of occurrences of the longest prefix of each maw comes from
+   * the suffix array intervals walked while enumerating the maws (@see
+   * Maw_engine::length_histogram).
+   * If max_keys is not 0, only the max_keys maws of highest gain (#occs_m - 1)
+   * of a length count for it.
    *
-   * @param seqfilename name of the file containing sequence (only seuquence for
-   * SDSL)
-   * @param mawfilename name of the file containing the maws of the sequence
+   * @param engine reference to the Maw_engine indexing the sequence
    * @param max_maw_size length of the longest possible maw
+   * @param max_keys maximum number of keys (0 for no limit)
    * */
-  ReturnStatus choose_maw_size(const std::string &seqfilename,
-                               const std::string &mawfilename,
-                               const int max_maw_size);
+  ReturnStatus choose_maw_size(const Maw_engine &engine,
+                               const int max_maw_size,
+                               const UINT_64 max_keys);
 
   /** @brief Loads ad_0 and ad_1 with the corresponding prefixes of the
 (encoded) maws
    of selected size.
-   * Selects all the maws of length key-size+1 and maps them to binary
-   representation.
+   * Selects all the maws of length key-size+1.
    * For each maw of length k, save its prefix of length (k-1)
    * The integer corresponding to k-1 bits is stored in the correspondonding
     table:
    *  If the last bit of this maw is 0, it is saved in ad_0; otherwise ad_1
 
    * The type of the key of hash-tables is KEY_TYPE (@see KEY_TYPE).
-   Currently, it is 32-bits unsigned int.
+   Currently, it is 64-bits unsigned int.
+   *
+   * If options.max_keys is not 0, they are selected instead (@see
+   * select_maws).
+   *
+   * @param engine reference to the Maw_engine indexing the sequence
+   * @param options options for the creation
+   * */
+  ReturnStatus load_chosen_maws(const Maw_engine &engine,
+                                const AdOptions &options);
+
+  /** @brief Loads (in _maws) the maws of all the lengths (at most
+   * cMax_key_size) for a multi-length anti-dictionary.
+   * If options.max_states is not 0, maws are taken in the order of decreasing
+   * frequency of their longest prefix (@see choose_maw_size) as long as the
+   * automaton has at most max_states states (i.e. number of distinct proper
+   * prefixes).
+   * With options.is_gain_selection or options.max_keys, they are selected
+   * (@see select_maws); without options.max_states, only the options.max_keys
+   * most frequent ones are kept while they are collected.
+   *
+   * @param engine reference to the Maw_engine indexing the sequence
+   * @param options options for the creation
+   * */
+  ReturnStatus load_all_maws(const Maw_engine &engine,
+                             const AdOptions &options);
+
+  /** @brief Creates the anti-dictionary from the maws of the sequence
+   * indexed by the engine (@see create).
+   */
+  ReturnStatus create_from(const Maw_engine &engine,
+                           const AdOptions &options);
+
+  /** A candidate maw */
+  struct Maw {
+    int len;
+    KEY_TYPE value; //< its bits (first one most significant)
+    UINT_64 freq;   //< number of occs of the longest proper prefix
+  };
+
+  /** @brief Selects the maws to keep among the candidates.
+   * Candidates are taken in their order (of decreasing gain) while there are
+   * at most options.max_keys of them and (multi-length only) the automaton
+   * has at most options.max_states states.
    *
-   * @param filename name of the file containing the maws of the sequence
-   * @param parser reference to the Parser instance given for encoding maws
+   * @param maws candidates, in the order of preference; replaced by the maws
+   * kept (in the same order)
+   * @param options options for the creation
+   * @param is_multi_length whether the maws are compiled into an automaton
    * */
+  void select_maws(std::vector<Maw> &maws, const AdOptions &options,
+                   const bool is_multi_length) const;
 
-  ReturnStatus load_chosen_maws(const std::string &filename,
-                                const Parser &parser);
+  /** @brief Finds the keys whose maw occurs in the sequence: the key followed
+   * by the last letter of its maw. Each document is scanned on its own.
+   *
+   * @param keys keys, grouped as by sorted_keys()
+   * @param seq the sequence
+   * @param doc_start first bit of each document of the sequence
+   * @return whether the maw of each key occurs (in the groups of the keys)
+   * */
+  std::vector<std::vector<bool>>
+  find_occurring(const std::vector<std::vector<KEY_TYPE>> &keys,
+                 const SEQUENCE &seq,
+                 const std::vector<UINT_64> &doc_start) const;
 
-  /** @brief Reads the sequence file and creates its Compressed Suffix Array:
-   * SINGLE SEQUENCE
-   * Uses SDSL.
+  /** @brief Adds to the keys the maws of positive gain of the sequence (@see
+   * update).
+   *
+   * @param seq the sequence
+   * @param doc_start first bit of each document of the sequence
+   * @param options options for the update
+   * @param old_seq the earlier documents (empty if not given)
+   * @param old_doc_start first bit of each earlier document
+   * @param removed keys removed (their maws occur in the sequence), grouped
+   * as by sorted_keys()
+   * @param keys keys kept, grouped as by sorted_keys() (ascending); the maws
+   * added are inserted in their groups
+   * @return execution status // as Maw_engine::build
    * */
-  ReturnStatus create_seq_csa(const std::string &filename,
-                              sdsl::csa_bitcompressed<> &csa);
+  ReturnStatus add_maws(const SEQUENCE &seq,
+                        const std::vector<UINT_64> &doc_start,
+                        const AdOptions &options, const SEQUENCE &old_seq,
+                        const std::vector<UINT_64> &old_doc_start,
+                        const std::vector<std::vector<KEY_TYPE>> &removed,
+                        std::vector<std::vector<KEY_TYPE>> &keys) const;
 };
 
+//////////////////////// inline ////////////////////////
+// Called for every bit in compression and decompression.
+
+inline bool Anti_dictionary::find_following_letter(const KEY_TYPE &key,
+                                                   char &letter) const {
+  UINT_8 entry;
+  if (!_bitmap.empty()) {
+    entry = _bitmap.lookup(key);
+  } else if (!_hash_table.empty()) {
+    entry = _hash_table.lookup(key);
+  } else {
+    entry = _succinct.lookup(key);
+  }
+  letter = static_cast<char>('0' + (entry & 1));
+  return entry != cAd_absent;
+}
+
 } // end namespace
 #endif
@@ -0,0 +1,236 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/** @file Bit_sequence.hpp
+ * @brief Defines the class Bit_sequence.
+ * It is the packed (one bit per bit) internal representation of an encoded
+ * sequence.
+ */
+
+#ifndef BIT_SEQUENCE_HPP
+#define BIT_SEQUENCE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mawcd {
+/** Class Bit_sequence
+ * A Bit_sequence is a growable sequence of bits packed into 64-bit words.
+ * - Bits are stored most-significant-bit first: bit i lives in word (i / 64)
+ * at position (63 - i % 64). Thus writing the words out in big-endian order
+ * gives exactly the bytes of the packed sequence.
+ * - Unused bits of the last word are always kept zero.
+ */
+class Bit_sequence {
+public:
+  using WORD = std::uint64_t;
+  static const int cWord_size = 64;
+
+  /** @brief Constructs an empty sequence.
+   */
+  Bit_sequence();
+
+  /** @brief Constructs the sequence from a string of '0' and '1'.
+   * Assumes that the string will always have valid characters ('0' or '1').
+   */
+  explicit Bit_sequence(const std::string &bits);
+
+  /** @brief Number of bits in the sequence.
+   */
+  std::uint64_t size() const { return _size; }
+
+  /** @brief Tests if the sequence has no bits.
+   */
+  bool empty() const { return _size == 0; }
+
+  /** @brief Reserves space for (at least) the given number of bits.
+   */
+  void reserve(const std::uint64_t num_bits);
+
+  /** @brief Removes all the bits.
+   */
+  void clear();
+
+  /** @brief Sets the number of bits: the bits added are zeroes (to be written
+   * in place, @see Bit_writer).
+   */
+  void resize(const std::uint64_t num_bits);
+
+  /** @brief Releases the unused capacity.
+   */
+  void shrink_to_fit();
+
+  /** @brief Appends one bit at the end.
+   */
+  void push_back(const bool bit);
+
+  /** @brief Appends the lowest 'len' bits of 'value' (most significant of
+   * those first) at the end.
+   * @param value integer holding the bits
+   * @param len number of bits to be appended (0 to 64)
+   */
+  void append(WORD value, const int len);
+
+  /** @brief Appends all the bits of the other sequence at the end.
+   */
+  void append(const Bit_sequence &other);
+
+  /** @brief Returns the bit at the given position.
+   */
+  bool get(const std::uint64_t pos) const;
+
+  /** @brief Returns the bit at the given position.
+   */
+  bool operator[](const std::uint64_t pos) const { return get(pos); }
+
+  /** @brief Returns 'len' bits (0 to 64) starting at position 'pos' as an
+   * integer (first bit is the most significant one).
+   * Assumes pos + len <= size().
+   */
+  WORD get_bits(const std::uint64_t pos, const int len) const;
+
+  /** @brief Returns the subsequence of 'len' bits starting at position 'pos'.
+   * Assumes pos + len <= size().
+   */
+  Bit_sequence slice(const std::uint64_t pos, const std::uint64_t len) const;
+
+  /** @brief Underlying words (last one possibly partially filled).
+   */
+  const std::vector<WORD> &words() const { return _words; }
+
+  /** @brief Human-readable representation as a string of '0' and '1'.
+   */
+  std::string to_string() const;
+
+  bool operator==(const Bit_sequence &other) const;
+  bool operator!=(const Bit_sequence &other) const { return !(*this == other); }
+
+  //////////////////////// private ////////////////////////
+private:
+  friend class Bit_writer;
+
+  std::vector<WORD> _words; //< packed bits
+  std::uint64_t _size;      //< number of valid bits
+};
+
+/** Class Bit_writer
+ * A Bit_writer writes bits in place into a sequence already sized (@see
+ * Bit_sequence::resize), from a given position on, as they would be appended
+ * (@see Bit_sequence::append). The bits written over must be zeroes.
+ * - Writers of different words of the same sequence can write concurrently.
+ */
+class Bit_writer {
+public:
+  using WORD = Bit_sequence::WORD;
+
+  /** @brief Constructs the writer of the sequence from position 'pos' on.
+   */
+  Bit_writer(Bit_sequence &seq, const std::uint64_t pos)
+      : _words(seq._words.data()), _pos(pos) {}
+
+  /** @brief Writes the lowest 'len' bits of 'value' (most significant of
+   * those first) at the position, which is then moved past them.
+   * @param value integer holding the bits
+   * @param len number of bits to be written (0 to 64)
+   */
+  void append(WORD value, const int len);
+
+  /** @brief Position of the next bit to be written.
+   */
+  std::uint64_t position() const { return _pos; }
+
+private:
+  WORD *_words;       //< packed bits of the sequence
+  std::uint64_t _pos; //< position of the next bit
+};
+
+//////////////////////// inline ////////////////////////
+// The following are on the hot path of encoding and compression.
+
+inline void Bit_sequence::push_back(const bool bit) {
+  const int used = static_cast<int>(_size & (cWord_size - 1));
+  if (used == 0) {
+    _words.push_back(0);
+  }
+  _words.back() |= static_cast<WORD>(bit) << (cWord_size - 1 - used);
+  ++_size;
+}
+
+inline void Bit_sequence::append(WORD value, const int len) {
+  if (len == 0) {
+    return;
+  }
+  if (len < cWord_size) {
+    value &= (static_cast<WORD>(1) << len) - 1;
+  }
+  const int used = static_cast<int>(_size & (cWord_size - 1));
+  if (used == 0) {
+    _words.push_back(value << (cWord_size - len));
+  } else {
+    const int free = cWord_size - used;
+    if (len <= free) {
+      _words.back() |= value << (free - len);
+    } else { // spills into a new word
+      const int spill = len - free;
+      _words.back() |= value >> spill;
+      _words.push_back(value << (cWord_size - spill));
+    }
+  }
+  _size += len;
+}
+
+inline void Bit_writer::append(WORD value, const int len) {
+  if (len == 0) {
+    return;
+  }
+  if (len < Bit_sequence::cWord_size) {
+    value &= (static_cast<WORD>(1) << len) - 1;
+  }
+  WORD *word = _words + (_pos >> 6);
+  const int used = static_cast<int>(_pos & (Bit_sequence::cWord_size - 1));
+  const int free = Bit_sequence::cWord_size - used;
+  if (len <= free) {
+    *word |= value << (free - len);
+  } else { // spills into the next word
+    const int spill = len - free;
+    word[0] |= value >> spill;
+    word[1] |= value << (Bit_sequence::cWord_size - spill);
+  }
+  _pos += len;
+}
+
+inline bool Bit_sequence::get(const std::uint64_t pos) const {
+  return (_words[pos >> 6] >> (cWord_size - 1 - (pos & (cWord_size - 1)))) &
+         1;
+}
+
+inline Bit_sequence::WORD Bit_sequence::get_bits(const std::uint64_t pos,
+                                                 const int len) const {
+  if (len == 0) {
+    return 0;
+  }
+  const std::uint64_t w = pos >> 6;
+  const int offset = static_cast<int>(pos & (cWord_size - 1));
+  WORD bits = _words[w] << offset;
+  if (offset + len > cWord_size) { // spans two words (offset > 0 here)
+    bits |= _words[w + 1] >> (cWord_size - offset);
+  }
+  return bits >> (cWord_size - len);
+}
+
+} // end namespace
+#endif
@@ -34,32 +34,64 @@ namespace mawcd {
  * to/from internal representation.
  * - It is tied to an Anti_dictionary which it uses for
  * compression/decompression.
- * - It reads the files in blocks (of 1MB currently).
+ * - It reads the files in chunks (of 1GB currently) and compresses them in
+ * blocks (@see ComOptions) which can be decompressed independently.
  *
  */
 class Codec {
 public:
+  /** Block of a compressed sequence: num_bits bits (of the original encoded
+   * sequence) compressed from the given context (suffix before the block, or
+   * state of the automaton) into packed bytes (padded with zeroes). The bits
+   * until the suffix is collected are copied as is in the initial block. */
+  struct Block {
+    UINT_64 num_bits = 0;
+    KEY_TYPE context = 0;
+    bool is_initial = false;
+    PACKED_SEQUENCE packed;
+  };
+
   /** @brief Constructs the codec (that uses the given anti_dictionary).
    *
    * @param ad Anti_dictionary which will be used for
    * compression/decompression.
+   * @param options options of the compression of a file (@see ComOptions).
    *
    */
-  Codec(const Anti_dictionary &ad);
+  Codec(const Anti_dictionary &ad, const ComOptions &options = ComOptions());
 
   /** @brief Compresses the given input file and save it in the corresponding
    * output file.
    *
    *
-   * Input file is read in blocks (currently 1MB).
-   * - Each block is encoded, compressed, packed, and stored in output file.
+   * Input file is read in chunks (currently 1GB).
+   * - Each chunk is encoded (in slices of the block size, in parallel), and
+   * compressed and packed in blocks (@see compress_blocks) which are stored
+   * in output file in their order.
    *
    * Output file (compressed) : same name as that of input file with an added
    * extension cExt_decom ('.com' currently).
-   * Compressed File Format (binary):
-   * - First 4 bytes represent the length of the original sequence.
-   * - Following which are compressed encoded sequence (of '0' and '1') packed
-   * into bytes.
+   * Compressed File Format (binary; numbers in the byte order of the
+   * machine):
+   * - Header (24 bytes):
+   *   bytes 0 to 7: magic "MAWCDCF" (null-terminated)
+   *   bytes 8 to 11: version (2)
+   *   bytes 12 to 15: id of the anti-dictionary used (@see
+   *   Anti_dictionary::get_id)
+   *   bytes 16 to 23: length of the original (encoded) sequence
+   * - Following which are the blocks, each one made of:
+   *   bytes 0 to 7: length of its original (encoded) sequence
+   *   bytes 8 to 15: its context (@see Block)
+   *   bytes 16 to 23: number of bytes of its compressed sequence
+   *   followed by its compressed encoded sequence (of bits) packed into
+   *   bytes.
+   * In version 1, the compressed encoded sequence of the whole file follows
+   * the header instead.
+   *
+   * The anti-dictionary must describe the file: if a bit it forces is not the
+   * one of the file (the file has a word absent from the anti-dictionary, e.g.
+   * it was created for other files), nothing is saved and ERR_INVALID_INPUT is
+   * returned.
    *
    * @param parser reference to the Parser instance given for encoding/decoding
    * blocks of the sequence to/from internal representation.
@@ -78,15 +110,22 @@ public:
    * output file.
    *
    *
-   * Input file (assumed to be in compressed format) is read in blocks
-   * (currently 1MB).
-   * - Each block is decompressed, decoded, and stored in output file.
+   * Input file (assumed to be in compressed format) is read a few blocks at
+   * a time.
+   * - The blocks are decompressed together (@see decompress_blocks), decoded,
+   * and stored in output file.
    * Decompression is done of the packed byte sequence (without exapnding into
    * binary string. Thus memory efficient.)
-   * Input (Compressed) File Format (binary) is assumed to be as follows:
-   * - First 4 bytes represent the length of the original sequence.
-   * - Following which are compressed encoded sequence (of '0' and '1') packed
-   * into bytes.
+   * Input (Compressed) File Format (binary) is assumed to be as follows
+   * (@see compress_file):
+   * - Header, which gives the length of the original sequence. The file must
+   * have been compressed with this anti-dictionary (same id), otherwise
+   * ERR_INVALID_INPUT is returned. Files written by the earlier releases
+   * start with only the length (8 bytes) instead; their anti-dictionary is not
+   * checked.
+   * - Following which are the blocks of the compressed encoded sequence (of
+   * '0' and '1') packed into bytes; files of version 1 and of the earlier
+   * releases are read in chunks (of 1GB) of a single one.
    *
    * Output file (decompressed) : same name as that of input file with an added
    * extension cExt_decom ('.decom' currently).
@@ -104,7 +143,7 @@ public:
   ReturnStatus decompress_file(const Parser &parser,
                                const std::string &in_filename) const;
 
-  /** @brief Compresses the encoded string (of '0' and '1').
+  /** @brief Compresses the encoded sequence (of bits).
    *
    * If the first block is to be compressed (indicated by is_initial), initial
    * bits corresponding to the length of the key (of anti_dictionary) are copied
@@ -120,11 +159,14 @@ public:
    * @param is_initial boolean representing if it is the initial (first) block.
    * @param pvs_suffix reference to the suffix (key) from the previous block.
    * The last suffix of this block will also be returned in it.
+   * @param is_contradicted set to true if a bit inferred is not the one of
+   * the sequence (left as is otherwise); the block can not then be
+   * decompressed.
    *
    * @return the compressed sequence (corresponding to this block).
    */
   SEQUENCE compress(const SEQUENCE &seq, bool is_initial,
-                    KEY_TYPE &pvs_suffix) const;
+                    KEY_TYPE &pvs_suffix, bool &is_contradicted) const;
 
   /** @brief Decompresses the packed encoded string.
    *
@@ -150,14 +192,96 @@ public:
   SEQUENCE decompress(const UINT_64 n, const PACKED_SEQUENCE &comp_seq,
                       bool is_initial, KEY_TYPE &pvs_suffix) const;
 
+  /** @brief Compresses the encoded sequence in blocks.
+   *
+   * The sequence is cut in blocks of the block size (@see ComOptions) but the
+   * last one; each block is compressed (@see compress) from the suffix before
+   * it (recorded in the block), or from the root state of the automaton of a
+   * multi-length anti-dictionary, and packed on its own. As the suffix before
+   * a block is read from the sequence (a block is longer than a key), the
+   * blocks are compressed in parallel; they do not depend on the number of
+   * threads.
+   *
+   * @param parser reference to the Parser instance packing the blocks (its
+   * encoded characters give the length of a block in bits).
+   * @param seq reference to the (chunk of) encoded sequence to be compressed.
+   * @param is_initial boolean representing if it is the initial (first) chunk.
+   * @param pvs_suffix reference to the suffix (key) from the previous chunk.
+   * The last suffix of this chunk will also be returned in it.
+   * @param is_contradicted set to true if a bit inferred is not the one of
+   * the sequence (@see compress).
+   *
+   * @return the compressed blocks (in the order of the sequence).
+   */
+  std::vector<Block> compress_blocks(const Parser &parser, const SEQUENCE &seq,
+                                     bool is_initial, KEY_TYPE &pvs_suffix,
+                                     bool &is_contradicted) const;
+
+  /** @brief Decompresses the blocks together.
+   *
+   * A block can be decompressed only bit after bit, each bit being inferred
+   * from the one before; the lookup of a bit in the anti-dictionary (a cache
+   * miss for the large ones) is thus on the critical path. The blocks being
+   * independent, their decompression is interleaved (a bit of each block in
+   * turn) so that their lookups overlap. A single block is rather
+   * decompressed on its own (@see decompress), which appends the runs of
+   * bits forced at once.
+   *
+   * @param blocks reference to the blocks (@see compress_blocks).
+   *
+   * @return the decompressed sequence of each block (in the same order); that
+   * of a block whose packed bytes run out is shorter than it.
+   */
+  std::vector<SEQUENCE>
+  decompress_blocks(const std::vector<Block> &blocks) const;
+
   //////////////////////// private ////////////////////////
 private:
+  /** @brief Compresses the encoded sequence with the automaton of a
+   * multi-length anti-dictionary.
+   *
+   * Starting from the root state, every bit forced by the current state is
+   * skipped, otherwise it is copied. No initial bits are copied.
+   *
+   * @param seq reference to the (block of) encoded sequence to be compressed.
+   * @param pvs_state reference to the state reached at the end of the
+   * previous block (root initially). The last state of this block will also be
+   * returned in it.
+   * @param is_contradicted set to true if a bit forced is not the one of the
+   * sequence (@see compress).
+   *
+   * @return the compressed sequence (corresponding to this block).
+   */
+  SEQUENCE compress_automaton(const SEQUENCE &seq, KEY_TYPE &pvs_state,
+                              bool &is_contradicted) const;
+
+  /** @brief Decompresses the packed encoded string with the automaton of a
+   * multi-length anti-dictionary.
+   *
+   * @see compress_automaton
+   *
+   * @param n size of the original (encoded) sequence.
+   * @param comp_packed_seq reference to the (block of) compressed (packed and
+   * encoded) sequence to be decompressed.
+   * @param pvs_state reference to the state reached at the end of the
+   * previous block. The last state of this block will also be returned in it.
+   *
+   * @return the decompressed sequence (corresponding to this block).
+   */
+  SEQUENCE decompress_automaton(const UINT_64 n,
+                                const PACKED_SEQUENCE &comp_packed_seq,
+                                KEY_TYPE &pvs_state) const;
+
   /** reference to the anti_dictionary that will be used for
    * compressing/decompressing */
   const Anti_dictionary &_cAd;
   /** length of the suffix (key) used for the inference of the next character
    * from the anti-dictionary */
   const int _cSuff_len;
+  /** options of the compression of a file */
+  const ComOptions _cOptions;
+  /** number of threads of the parallel loops (@see ComOptions) */
+  const int _cNum_threads;
 };
 
 } // end namespace
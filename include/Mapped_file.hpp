@@ -0,0 +1,68 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+/** @file Mapped_file.hpp
+ * @brief Defines the class Mapped_file.
+ * It is a read-only memory mapping of a whole file.
+ */
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include "globalDefs.hpp"
+
+namespace mawcd {
+/** Class Mapped_file
+ * A Mapped_file maps a file (read-only and private) in memory so that its
+ * contents are used in place: pages are read from the file (or the page
+ * cache) on first access only. The mapping is released with the object.
+ */
+class Mapped_file {
+public:
+  Mapped_file() = default;
+  Mapped_file(const Mapped_file &) = delete;
+  Mapped_file &operator=(const Mapped_file &) = delete;
+  ~Mapped_file();
+
+  /** @brief Maps the file (releasing the earlier mapping).
+   * An empty file is opened without a mapping (data() is then nullptr).
+   *
+   * @return execution status // ERR_FILE_OPEN if the file cannot be opened or
+   * mapped.
+   */
+  ReturnStatus open(const std::string &filename);
+
+  /** @brief Releases the mapping.
+   */
+  void close();
+
+  /** @brief Start of the contents of the file.
+   */
+  const char *data() const { return _data; }
+
+  /** @brief Size of the file in bytes.
+   */
+  UINT_64 size() const { return _size; }
+
+  //////////////////////// private ////////////////////////
+private:
+  const char *_data = nullptr;
+  UINT_64 _size = 0;
+};
+
+} // end namespace
+#endif
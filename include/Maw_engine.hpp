@@ -0,0 +1,472 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+/** @file Maw_engine.hpp
+ * @brief Defines the class Maw_engine.
+ * It computes the minimal absent words of the (encoded) sequence in memory
+ * or in external memory, following the algorithm of the MAW tool (Alice
+ * Heliou and Solon P. Pissis, external/maw-master) over the binary alphabet.
+ */
+
+#ifndef MAW_ENGINE_HPP
+#define MAW_ENGINE_HPP
+
+#include <functional>
+#include <map>
+#include <sdsl/bit_vectors.hpp>
+#include <sdsl/config.hpp>
+#include <sdsl/int_vector.hpp>
+#include <sdsl/int_vector_buffer.hpp>
+
+#include "Sequence_file.hpp"
+#include "globalDefs.hpp"
+
+namespace mawcd {
+/** Class Maw_engine
+ * A Maw_engine indexes one (encoded) sequence and reports its maws.
+ * The sequence may be a collection of documents (e.g. the files of a training
+ * corpus) laid end to end: no word spanning two documents is then considered
+ * to occur, i.e. the maws are those of the collection.
+ * - build() computes the suffix array (divsufsort), the LCP array, the
+ *   Before/Beforelcp bit-vectors of the MAW tool and the BWT.
+ * - for_each_maw() streams the maws of the chosen lengths to a callback;
+ *   it may be called several times without indexing again.
+ * - length_histogram() counts the maws of each length.
+ * The sweeps of build(), for_each_maw() and length_histogram() run on the
+ * (OpenMP) threads given to build(); their results do not depend on the
+ * number of threads.
+ *
+ * A maw of length l is reported as its longest proper prefix (the key, of
+ * l-1 bits, first bit most significant) and its last bit, so that maws up to
+ * cMax_key_size+1 bits can be reported.
+ * A maw a.u.b is found at a row whose suffix starts with u.b; the number of
+ * occurrences of its key a.u is then the number of rows of the
+ * LCP-interval of u which are preceded by a, so no pattern matching is
+ * needed. The bounds of the LCP-intervals are not stored: they are found
+ * while sweeping the rows with a stack of the open intervals, and each
+ * interval carries the number of rows before it preceded by each letter.
+ *
+ * The index is kept lean (about 7 bytes per bit of the sequence, against 34
+ * when all the arrays were 64-bit):
+ * - the suffix array is bit-compressed (32-bit suffix sorting is used when
+ *   the sequence is short enough),
+ * - LCP values are capped at cLcp_cap (one byte each): maws reported are at
+ *   most cMax_key_size+1 bits long, i.e. their LCP value is below the cap,
+ *   and the LCP-intervals below the cap are unchanged by capping,
+ * - the LCP array is computed directly on the packed bits (no inverse suffix
+ *   array, no one-byte-per-letter text kept after suffix sorting).
+ *
+ * In external memory (AdOptions::is_external_memory), the sequence is read
+ * from a file of the scratch directory and no array of the size of the
+ * sequence is kept in memory. As maws (and LCP values) are capped, a suffix
+ * matters only by its first cLcp_cap bits: each position gives a record of
+ * them, of the length of the rest of its document and of the letter
+ * preceding it. The records are sorted by an external merge sort (runs
+ * sorted in the memory given, merged as many at a time as their buffers fit
+ * in it) and the sorted records are written as the arrays of the index
+ * (prefixes instead of the suffix array, LCP, BWT) in files of the scratch
+ * directory, as the Before/Beforelcp/seen bit-vectors then; every pass reads
+ * them sequentially through buffers. The memory used is that of the runs and
+ * of the buffers (@see memory_estimate); the disk used is about 12 bytes per
+ * bit of the sequence, and twice its records while they are merged.
+ */
+class Maw_engine {
+public:
+  /** Callback receiving a maw: its key, the length of the key, its last
+   * bit, and the number of occurrences of its key in the sequence */
+  using MAW_CALLBACK =
+      std::function<void(const KEY_TYPE key, const int key_len, const bool last,
+                         const UINT_64 freq)>;
+
+  ~Maw_engine();
+
+  /** @brief Indexes the given sequence.
+   * In memory, the sequence is not copied: it must be kept unchanged while
+   * the engine is used (until clear()). In external memory, it is copied to
+   * a file of the scratch directory (@see build(Sequence_file &...)).
+   *
+   * @param seq reference to the encoded sequence.
+   * @param options options of the creation (max_memory, is_external_memory,
+   * scratch_dir and num_threads are used; @see AdOptions).
+   *
+   * @return execution status // ERR_INVALID_INPUT if the sequence is empty,
+   * ERR_LIMIT_EXCEEDS if the index would not fit in options.max_memory,
+   * ERR_FILE_OPEN if the files of the index cannot be created, ERR_EXTERNAL
+   * if suffix sorting fails.
+   */
+  ReturnStatus build(const SEQUENCE &seq,
+                     const AdOptions &options = AdOptions());
+
+  /** @brief Indexes the given collection of documents.
+   * Suffix sorting separates the documents by a letter smaller than 0 and 1
+   * (as the end of the sequence), and LCP values stop at the end of a
+   * document, so that the LCP-intervals are those of the generalised suffix
+   * tree of the documents.
+   *
+   * @param seq reference to the encoded documents, one after the other.
+   * @param doc_start first bit of each document (increasing, the first one
+   * being 0; every document is non-empty).
+   * @param options options of the creation (@see build).
+   *
+   * @return execution status // ERR_INVALID_INPUT if the sequence is empty or
+   * the documents are not valid, otherwise as build().
+   */
+  ReturnStatus build(const SEQUENCE &seq,
+                     const std::vector<UINT_64> &doc_start,
+                     const AdOptions &options = AdOptions());
+
+  /** @brief Indexes the collection of documents of the given file in external
+   * memory (whatever options.is_external_memory): the file is read
+   * sequentially (twice) while the records of the positions are sorted, and
+   * no longer used afterwards.
+   *
+   * @param seq_file reference to the file of the encoded documents.
+   * @param doc_start first bit of each document (@see build).
+   * @param options options of the creation (@see build); the runs of the
+   * sort take the memory of options.max_memory left by the buffers of the
+   * engine (cDefault_sort_memory if it is 0).
+   *
+   * @return execution status // as build(), ERR_FILE_OPEN also if the file
+   * cannot be read.
+   */
+  ReturnStatus build(Sequence_file &seq_file,
+                     const std::vector<UINT_64> &doc_start,
+                     const AdOptions &options = AdOptions());
+
+  /** @brief Peak memory (in bytes) needed by build() and for_each_maw() for
+   * a sequence of n bits (besides the sequence), with the index in memory,
+   * or the least one in external memory (with the smallest runs), swept by
+   * num_threads threads.
+   */
+  static UINT_64 memory_estimate(const UINT_64 n,
+                                 const bool is_external_memory,
+                                 const int num_threads);
+
+  /** @brief Reports every maw whose length lies in [min_len, max_len], in
+   * the order their LCP-intervals are closed sweeping the rows of the suffix
+   * array (in the order they are found within an interval).
+   * The rows are swept in waves of cWave_rows, each split among the threads;
+   * the maws of a wave are then reported by the calling thread, so that at
+   * most the maws of one wave (and those of the intervals still open) are
+   * kept at once.
+   *
+   * @param min_len minimum length of a maw (at least 2).
+   * @param max_len maximum length of a maw (at most cMax_key_size+1).
+   * @param report callback receiving each maw.
+   */
+  void for_each_maw(const int min_len, const int max_len,
+                    const MAW_CALLBACK &report) const;
+
+  /** @brief Number of maws, and total number of occurrences of their keys,
+   * of each length (at most max_len) in a single pass.
+   * The rows of the suffix array are split among the (OpenMP) threads.
+   *
+   * @param max_len maximum length of a maw (at most cMax_key_size+1).
+   * @param num_maws num_maws[l] will be the number of maws of length l.
+   * @param freq freq[l] will be the total number of occurrences of the keys
+   * of the maws of length l.
+   */
+  void length_histogram(const int max_len, std::vector<UINT_64> &num_maws,
+                        std::vector<UINT_64> &freq) const;
+
+  /** @brief Releases the index (and removes its files).
+   */
+  void clear();
+
+  //////////////////////// private ////////////////////////
+private:
+  static const int cSigma = 2; //< binary alphabet
+  static const int cNo_letter = cSigma; //< BWT of the first row of a document
+  static const int cLcp_cap = cMax_key_size; //< LCP values are capped at it
+  static const UINT_64 cBuffer_size = 1 << 20; //< bytes per array on disk
+  static const INT_64 cWave_rows = 1 << 18; //< rows per wave of for_each_maw
+  /** Memory of the runs of the external sort: by default, and the least */
+  static const UINT_64 cDefault_sort_memory = UINT_64(1) << 30;
+  static const UINT_64 cMin_sort_memory = UINT_64(1) << 23;
+  /** Bytes of the buffer of each run merged (at least) */
+  static const UINT_64 cMin_merge_buffer = UINT_64(1) << 16;
+
+  /** Arrays of the index kept in memory. */
+  struct Memory_index {
+    static const bool cIs_shared = true; //< read by all the threads at once
+    sdsl::int_vector<> sa;               //< suffix array (bit-compressed)
+    std::vector<UINT_8> lcp;             //< LCP array (capped)
+    sdsl::int_vector<2> bwt;             //< see compute_bwt
+    sdsl::bit_vector before[cSigma];     //< see compute_before
+    sdsl::bit_vector before_lcp[cSigma]; //< see compute_before
+    sdsl::bit_vector seen;               //< see compute_seen
+  };
+
+  /** Read-only view of the arrays of the index kept in memory. */
+  struct Memory_reader {
+    static const bool cIs_shared = true;
+    explicit Memory_reader(const Maw_engine &engine);
+    /** First cLcp_cap bits (within its document) of the suffix of row i,
+     * left aligned (first bit most significant) */
+    UINT_64 prefix(const INT_64 i) const;
+    /** Number of bits from the suffix of row i to the end of its document */
+    INT_64 rest(const INT_64 i) const;
+    const Maw_engine &engine;
+    const sdsl::int_vector<> &sa;
+    const std::vector<UINT_8> &lcp;
+    const sdsl::int_vector<2> &bwt;
+    const sdsl::bit_vector *before;
+    const sdsl::bit_vector *before_lcp;
+    const sdsl::bit_vector &seen;
+  };
+
+  /** Arrays of the index stored in files, accessed through buffers; each
+   * thread opens its own. */
+  struct File_index {
+    static const bool cIs_shared = false;
+    /** Opens the files of the index of the engine (created if mode is
+     * std::ios::out). */
+    explicit File_index(const Maw_engine &engine,
+                        const std::ios::openmode mode = std::ios::in);
+    /** As Memory_reader::prefix */
+    UINT_64 prefix(const INT_64 i) { return prefixes[i]; }
+    /** As Memory_reader::rest (capped at cLcp_cap+1) */
+    INT_64 rest(const INT_64 i) { return rests[i]; }
+    sdsl::int_vector_buffer<64> prefixes;
+    sdsl::int_vector_buffer<8> rests;
+    sdsl::int_vector_buffer<8> lcp;
+    sdsl::int_vector_buffer<2> bwt;
+    sdsl::int_vector_buffer<1> before[cSigma];
+    sdsl::int_vector_buffer<1> before_lcp[cSigma];
+    sdsl::int_vector_buffer<1> seen;
+  };
+
+  /** Number of rows preceded by each letter among the rows before a given
+   * one. */
+  struct Letter_counts {
+    UINT_64 num[cSigma];
+  };
+
+  /** An LCP-interval which is open while sweeping the rows: its LCP value,
+   * its first row and the rows before it preceded by each letter. */
+  struct Lcp_interval {
+    INT_64 lcp;
+    INT_64 lb;
+    Letter_counts before_lb;
+  };
+
+  /** What a sweep has seen before a boundary: the stack of the open
+   * LCP-intervals, and the rows preceded by each letter. */
+  struct Sweep_state {
+    std::vector<Lcp_interval> lifo;
+    Letter_counts counts;
+  };
+
+  /** A maw found by for_each_maw(): its freq is known once its LCP-interval
+   * is closed. */
+  struct Found_maw {
+    KEY_TYPE key;
+    int key_len;
+    bool last;
+    UINT_8 first; //< its first letter
+    UINT_64 freq;
+  };
+
+  /** A position of the sequence sorted in external memory: the first
+   * cLcp_cap bits of its suffix (left aligned), the number of bits to the
+   * end of its document (capped at cLcp_cap+1) and the letter preceding it
+   * (cNo_letter if it starts a document). Records are sorted by prefix, then
+   * by rest: a suffix ending its document comes before the longer ones
+   * starting as it, as the end sorts first. */
+  struct Record {
+    UINT_64 prefix;
+    UINT_8 rest;
+    UINT_8 before;
+    bool operator<(const Record &other) const {
+      return (prefix != other.prefix)
+                 ? prefix < other.prefix
+                 : ((rest != other.rest) ? rest < other.rest
+                                         : before < other.before);
+    }
+  };
+
+  /** @brief Position in the sequence of the position t of the text sorted
+   * (where a separator follows every document but the last one).
+   */
+  INT_64 sequence_position(const INT_64 t) const;
+
+  /** @brief End (one past the last bit) of the document of position p.
+   */
+  INT_64 doc_end(const INT_64 p) const;
+
+  /** @brief Tests if a document starts at position p (no letter precedes).
+   */
+  bool is_doc_start(const INT_64 p) const;
+
+  /** @brief Checks the documents and the memory limit, and records them.
+   *
+   * @return execution status // as build().
+   */
+  ReturnStatus start_build(const UINT_64 n,
+                           const std::vector<UINT_64> &doc_start,
+                           const AdOptions &options,
+                           const bool is_external_memory);
+
+  /** @brief Computes the suffix array of the sequence (in memory).
+   *
+   * @return false if suffix sorting fails.
+   */
+  bool compute_sa();
+
+  /** @brief Computes the (capped) LCP array (in memory) by comparing, 64 bits
+   * at a time, the suffixes of consecutive rows.
+   */
+  void compute_lcp();
+
+  /** @brief LCP value (capped) of the suffixes starting at p and q.
+   */
+  UINT_8 capped_lcp(const INT_64 p, const INT_64 q) const;
+
+  /** @brief Sorts the records of the positions of the sequence of the file
+   * into runs (files of the scratch directory) of sort_memory bytes at most.
+   *
+   * @param runs names of the files of the runs (appended to).
+   *
+   * @return execution status // ERR_FILE_OPEN if a file cannot be read or
+   * written.
+   */
+  ReturnStatus sort_runs(Sequence_file &seq_file, const UINT_64 sort_memory,
+                         std::vector<std::string> &runs);
+
+  /** @brief Merges the runs, as many at a time as their buffers fit in
+   * sort_memory, until they are few enough to be merged into the arrays of
+   * the index (prefixes, rests, BWT and LCP).
+   *
+   * @return execution status // ERR_FILE_OPEN if a file cannot be read or
+   * written.
+   */
+  ReturnStatus merge_runs(std::vector<std::string> &runs,
+                          const UINT_64 sort_memory, File_index &index);
+
+  /** @brief Name of a new file of the scratch directory (registered to be
+   * removed by clear()).
+   */
+  std::string scratch_file(const std::string &key);
+
+  /** @brief Computes the Before and Beforelcp bit-vectors (GetBefore of the
+   * MAW tool): for each letter, if it precedes a suffix of the interval of
+   * each (odd: between two consecutive) rows of the suffix array.
+   */
+  template <class INDEX> void compute_before(INDEX &index);
+
+  /** @brief Marks the rows whose LCP-interval has already been seen (to
+   * avoid reporting a maw twice).
+   */
+  template <class INDEX> void compute_seen(INDEX &index);
+
+  /** @brief Computes the BWT (in memory): the letter preceding the suffix of
+   * each row, cNo_letter if the suffix starts a document.
+   */
+  void compute_bwt();
+
+  /** @brief Sets 'bits' to n zeros.
+   */
+  static void assign_zeros(sdsl::bit_vector &bits, const UINT_64 n);
+  static void assign_zeros(sdsl::int_vector_buffer<1> &bits, const UINT_64 n);
+
+  /** @brief Implements for_each_maw() on the index in memory (Memory_reader)
+   * or in files (File_index).
+   */
+  template <class INDEX>
+  void for_each_maw_in(const int min_len, const int max_len,
+                       const MAW_CALLBACK &report) const;
+
+  /** @brief Implements length_histogram() on the index in memory
+   * (Memory_reader) or in files (File_index).
+   */
+  template <class INDEX>
+  void length_histogram_in(const int max_len, std::vector<UINT_64> &num_maws,
+                           std::vector<UINT_64> &freq) const;
+
+  /** @brief Updates the sweep with the boundary between rows k-1 and k
+   * (LCP[k]), closing (close(interval, counts before row k)) the intervals
+   * of higher value and opening (open()) the interval of value LCP[k] if it
+   * is not already open, then with row k (counted); the top of the stack is
+   * then the interval of value LCP[k] containing rows k-1 and k.
+   */
+  template <class INDEX, class OPEN, class CLOSE>
+  void advance(INDEX &index, const INT_64 k, Sweep_state &state, OPEN &open,
+               CLOSE &close) const;
+
+  /** @brief Sweeps the boundaries [begin, end) from the given state (the one
+   * after boundary begin-1), reporting (maw(row, letter)) the maws found at
+   * each boundary k: those at row k (B1) and row k-1 (B2) whose
+   * LCP-interval is the top of the stack.
+   */
+  template <class INDEX, class OPEN, class CLOSE, class MAW>
+  void sweep(INDEX &index, const INT_64 begin, const INT_64 end,
+             Sweep_state &state, OPEN &open, CLOSE &close, MAW &maw) const;
+
+  /** @brief Splits the boundaries [begin, end) into num_ranges ranges and
+   * finds the state of the sweep at the start of each range (by a sweep
+   * without maws).
+   *
+   * @param state the state after boundary begin-1; it will be the one after
+   * boundary end-1.
+   * @param range_start range_start[r] will be the first boundary of range r
+   * (and range_start[r+1] its end).
+   * @param start_state start_state[r] will be the state after boundary
+   * range_start[r]-1.
+   */
+  template <class INDEX>
+  void split_boundaries(INDEX &index, const INT_64 begin, const INT_64 end,
+                        const INT_64 num_ranges, Sweep_state &state,
+                        std::vector<INT_64> &range_start,
+                        std::vector<Sweep_state> &start_state) const;
+
+  /** @brief Maps each inherited interval closed by a range (given by range,
+   * with the counts before its end) to those counts, to close the intervals
+   * left open by the earlier ranges.
+   *
+   * @return map from (first row, LCP value) of an interval to the counts.
+   */
+  static std::map<std::pair<INT_64, INT_64>, Letter_counts> closing_counts(
+      const std::vector<std::vector<std::pair<Lcp_interval, Letter_counts>>>
+          &closed);
+
+  /** @brief Tests if a maw starts with letter l at row i.
+   *
+   * @return the row k (i or i+1) such that the maw is l followed by the
+   * first LCP[k]+1 letters of the suffix of row i; -1 if there is no maw.
+   */
+  template <class INDEX>
+  INT_64 maw_row(INDEX &index, const INT_64 i, const int l) const;
+
+  /** @brief Number of occurrences of l followed by the first 'lcp' letters
+   * of the suffixes of the given LCP-interval, closed before the rows of the
+   * given counts.
+   */
+  UINT_64 key_freq(const Lcp_interval &interval, const Letter_counts &counts,
+                   const int l) const;
+
+  const SEQUENCE *_seq = nullptr;          //< the indexed sequence (in memory)
+  INT_64 _size = 0;                        //< its number of bits
+  bool _is_external_memory = false;        //< index in files (_config)
+  Memory_index _index;                     //< index (in memory)
+  sdsl::cache_config _config;              //< files of the index
+  std::vector<INT_64> _doc_start;          //< first bit of each document
+  UINT_64 _num_last[cSigma] = {0, 0};      //< documents ending with a letter
+  int _num_threads = 1;                    //< threads of the sweeps
+};
+
+} // end namespace
+#endif
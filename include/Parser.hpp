@@ -23,66 +23,153 @@ Pissis
 #define PARSER_HPP
 
 #include <algorithm>
+#include <array>
 #include <bitset>
 #include <cctype>
 #include <clocale>
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <functional>
 
 #include <sys/stat.h>
 //#include <sys/types.h>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
 
 #include "globalDefs.hpp"
 #include "utilDefs.hpp"
 
 namespace mawcd {
+
+//////////////////////// alphabets ////////////////////////
+/** Helpers (usable at compile time) for defining the alphabets */
+
+/** @brief Smallest number of bits (at least 1) to encode 'size' letters. */
+constexpr int code_len_for(const int size, const int len = 1) {
+  return ((1 << len) >= size) ? len : code_len_for(size, len + 1);
+}
+
+/** @brief Upper-case of an ASCII letter (other characters unchanged). */
+constexpr char to_upper_ascii(const char c) {
+  return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+/** @brief Position of the character in the (null-terminated) letters or -1.
+ */
+constexpr int index_in(const char *letters, const char c, const int i = 0) {
+  return (letters[i] == '\0') ? -1
+                              : ((letters[i] == c) ? i
+                                                   : index_in(letters, c, i + 1));
+}
+
+/** Alphabets (given as template parameter to BasicParser)
+ * Each of them defines:
+ * - cType: the corresponding AlphabetType
+ * - cCode_len: length of an encoded character in bits (0 if known only at
+ *   run-time)
+ * - cSkip_spaces: whether space-characters and new-lines are ignored
+ * - code(c): code of the character c (its encoded representation) or -1 if it
+ *   is invalid (not for the run-time alphabet)
+ * - complement(code): code of the complement of the character of the given
+ *   code (on the other strand), or -1 if the alphabet has no complement
+ */
+
+/** DNA: ACGTN (irrespective of case).
+ * Hard-coded: A: 000, C: 001, G: 010, T: 011, N: 100
+ * Complementary bases differ in the two lowest bits (A-T, C-G), so that a
+ * base is complemented by flipping them; N is its own complement.
+ */
+struct DnaAlphabet {
+  static const AlphabetType cType = AlphabetType::DNA;
+  static constexpr int cCode_len = code_len_for(5);
+  static const bool cSkip_spaces = true;
+  static constexpr int code(const char c) {
+    return index_in("ACGTN", to_upper_ascii(c));
+  }
+  static constexpr int complement(const int code) {
+    return (code < 4) ? (code ^ 3) : code;
+  }
+};
+static_assert(DnaAlphabet::complement(DnaAlphabet::code('A')) ==
+                      DnaAlphabet::code('T') &&
+                  DnaAlphabet::complement(DnaAlphabet::code('C')) ==
+                      DnaAlphabet::code('G') &&
+                  DnaAlphabet::complement(DnaAlphabet::code('N')) ==
+                      DnaAlphabet::code('N'),
+              "Codes of complementary bases must differ in the lowest bits");
+
+/** PROT: ACDEFGHIKLMNOPQRSTUVWY (irrespective of case).
+ * Hard-coded: position of the letter (from 00000 for A to 10101 for Y)
+ */
+struct ProtAlphabet {
+  static const AlphabetType cType = AlphabetType::PROT;
+  static constexpr int cCode_len = code_len_for(22);
+  static const bool cSkip_spaces = true;
+  static constexpr int code(const char c) {
+    return index_in("ACDEFGHIKLMNOPQRSTUVWY", to_upper_ascii(c));
+  }
+  static constexpr int complement(const int) { return -1; }
+};
+
+/** GEN: All graphical or space characters (printable ASCII).
+ * A character is encoded as its own (8-bit) binary representation.
+ */
+struct GenAlphabet {
+  static const AlphabetType cType = AlphabetType::GEN;
+  static constexpr int cCode_len = 8;
+  static const bool cSkip_spaces = false;
+  static constexpr int code(const char c) {
+    return (c >= ' ' && c <= '~') ? static_cast<int>(c) : -1;
+  }
+  static constexpr int complement(const int) { return -1; }
+};
+
+/** SEL: User given case-sensitive alphabet (known only at run-time).
+ * A character is encoded as the binary representation of its position in the
+ * alphabet.
+ */
+struct SelAlphabet {
+  static const AlphabetType cType = AlphabetType::SEL;
+  static constexpr int cCode_len = 0;
+  static const bool cSkip_spaces = true;
+  static constexpr int complement(const int) { return -1; }
+};
+
+//////////////////////// parsers ////////////////////////
 /** Class Parser
  * A Parser contains methods for parsing a sequence  (file or string) to/from
  * encoded (or packed-encoded) sequence.
  * - A sequence is string of characters from the corresponding (original)
  * alphabet.
- * - An encoded sequence is a string of encoded characters:
- *   -- An encoded character is a string of '0' and '1' (characters)
- * - A packed-encoded sequence is when encoded sequence (string of '1' and '0')
- * is converted and into corresponding bits and the bits are packed as bytes.
+ * - An encoded sequence is a Bit_sequence of encoded characters:
+ *   -- An encoded character is the binary representation of its code (@see
+ *   DnaAlphabet etc.)
+ * - A packed-encoded sequence is when the bits of an encoded sequence are
+ * written out as bytes.
  *
  * Note that encoding/decoding here refers to converting to/from the internal
  * representation.
+ *
+ * Parser is the interface; the parser for an alphabet is a BasicParser
+ * specialised (at compile-time) for that alphabet. Thus the alphabet is chosen
+ * once (when the parser is created) rather than for every character.
  */
 class Parser {
-  /** Function Pointers for checking validity of a character, encoding an
-   * orginal alphabet character, and decoding an encoded character
-   * */
-  using FCheckValidity = bool (Parser::*)(const char) const;
-  using FMapChar = ENCODED_CHAR (Parser::*)(const char) const;
-  using FRevMapChar = char (Parser::*)(const ENCODED_CHAR) const;
-
 public:
-  /** @brief Constructs the parser (for specialised alphabet).
-   *
-   * @param alphabetType Alphabet type: DNA for genomic sequences, PROT for
-   proteins. SEL for user-defined.
-   * @param alphabet string containing all the letters of the chosen alphabet.
-
-   * @see AlphabetType
-   * @see cDegenerate_PROTAlphabet
-   * @see cDegenerate_DNAAlphabet
-
-   */
-  Parser(const AlphabetType alphabetType, const std::string &alphabet);
-
-  /** @brief Constructs the parser for general (graphical and characters)
-   * alphabet.
-   *
-   * @see AlphabetType
-   */
-  Parser();
+  virtual ~Parser() {}
 
   /** @brief Parses the string (containing single sequence in original alphabet)
      into an encoded sequence. It ignores space-characters and new-lines for the
      specialised alphabet (DNA, Protein, user-defined(SEL))
      *
+     * Each character is looked up in the encoding table (@see
+     BasicParser::build_encode_table). When compiled with SSSE3, blocks of 16
+     characters are validated, stripped of white-spaces and encoded together
+     (@see BasicParser::encode_simd); the remaining ones go through the table
+     one at a time.
+     *
      * @param str reference to the string (sequence in original alphabet) to be
      encoded
      * @param sequence reference in which encoded sequence will be stored.
@@ -92,10 +179,30 @@ public:
      corresponding error code after logging the error
 
      */
-  ReturnStatus encode_from_string(const std::string &str,
-                                  SEQUENCE &sequence) const;
+  virtual ReturnStatus encode_from_string(const std::string &str,
+                                          SEQUENCE &sequence) const = 0;
 
-  /** @brief Packs the encoded string (of '0' and '1') into a sequence of bytes.
+  /** @brief Encodes the characters as encode_from_string does, but writes the
+     encoded sequence in place (@see Bit_writer) rather than appending it.
+     *
+     * @param str pointer to the characters to be encoded.
+     * @param len number of characters.
+     * @param writer reference to the writer of the (already sized) sequence;
+     the writer is moved past the written bits.
+
+     * @return execution status // SUCCESS if input is valid, otherwise
+     corresponding error code after logging the error
+
+     */
+  virtual ReturnStatus encode_in_place(const char *str, const UINT_64 len,
+                                       Bit_writer &writer) const = 0;
+
+  /** @brief Number of encoded characters of the characters given: those which
+     are not ignored (the invalid ones are counted too).
+     */
+  virtual UINT_64 count_codes(const char *str, const UINT_64 len) const = 0;
+
+  /** @brief Packs the encoded sequence (of bits) into a sequence of bytes.
    *
    * The last bits of the sequence may not fill the whole byte. Those
    (hanging) bits are returned in the 'pvs_hanging' to be used with the next
@@ -109,10 +216,10 @@ public:
    to make a full byte and returned as the packed sequence.
    *
    * @param sequence reference to the encoded sequence to be packed.
-   * @param pvs_hanging reference to the string containing remaining bits (last
-   bits which could not fill a byte) from the previous call (previous part of
-   the sequence). Remaining bits of this part of the sequence will be returned
-   in it.
+   * @param pvs_hanging reference to the sequence containing remaining bits
+   (last bits which could not fill a byte) from the previous call (previous part
+   of the sequence). Remaining bits of this part of the sequence will be
+   returned in it.
    * @param packed_sequence reference in which packed encoded sequence will be
    stored.
    *
@@ -120,12 +227,15 @@ public:
      corresponding error code after logging the error.
 
      */
-  ReturnStatus pack_sequence(const SEQUENCE &seq, std::string &pvs_hanging,
+  ReturnStatus pack_sequence(const SEQUENCE &seq, SEQUENCE &pvs_hanging,
                              PACKED_SEQUENCE &packed_sequence) const;
 
-  /** @brief Decodes the encoded string (of '0' and '1') into the corresponding
+  /** @brief Decodes the encoded sequence (of bits) into the corresponding
    sequence of characters from original alphabet.
    *
+   * The sequence is read a word at a time; each lookup in the decoding table
+   (@see BasicParser::build_decode_table) yields several decoded characters.
+   *
    * The last bits of the encoded sequence may not be enough to decipher the
    reverse_mapping (fewer than the size of an encoded character). Those
    (hanging) bits are returned in the 'pvs_hanging' to be used with the next
@@ -137,10 +247,12 @@ public:
    equal to the encoded character size).
    *
    * @param sequence reference to the encoded sequence to be decoded.
-   * @param pvs_hanging reference to the string containing remaining bits (last
-   bits which were not sufficient to decipher the encoded char) from the
+   * @param pvs_hanging reference to the integer containing remaining bits
+   (last bits which were not sufficient to decipher the encoded char) from the
    previous call (previous part of the sequence). Remaining such bits of this
    part of the sequence will be returned in it.
+   * @param num_hanging reference to the number of bits in pvs_hanging (updated
+   as well).
    * @param str reference to string in which decoded sequence will be
    stored.
    *
@@ -148,106 +260,184 @@ public:
      corresponding error code after logging the error.
 
      */
-  ReturnStatus decode_to_string(const SEQUENCE &sequence,
-                                std::string &pvs_hanging,
-                                std::string &str) const;
+  virtual ReturnStatus decode_to_string(const SEQUENCE &sequence,
+                                        UINT_64 &pvs_hanging, int &num_hanging,
+                                        std::string &str) const = 0;
+
+  /** @brief Appends the reverse complement (the other strand) of the encoded
+   sequence: its encoded characters in the reverse order, each one replaced by
+   its complement (@see DnaAlphabet).
+   *
+   * @param sequence reference to the encoded sequence (whole encoded
+   characters).
+   * @param rc reference to the encoded sequence to be appended to.
+   *
+   * @return execution status // ERR_INVALID_INPUT if the alphabet has no
+     complement (only DNA has) or the sequence is not made of whole encoded
+     characters.
+
+     */
+  virtual ReturnStatus append_reverse_complement(const SEQUENCE &sequence,
+                                                 SEQUENCE &rc) const = 0;
 
-  /** @brief Maps the given sequence of binary characters to that consisting
+  /** @brief Length (in bits) of an encoded character.
+   */
+  virtual int get_code_len() const = 0;
+
+  /** @brief Maps the given sequence of bits to that consisting
    * of DNA alphabet.
-   * Assumes that the string will always have valid characters ('0' or '1').
-   * One to one mapping from  '0' to 'A' and '1' to 'C'.
+   * One to one mapping from  0 to 'A' and 1 to 'C'.
    * @return mapped sting
    */
-  std::string binary_to_dna(const std::string &str) const;
+  std::string binary_to_dna(const SEQUENCE &seq) const;
 
   /** @brief Maps the given sequence of DNA alphabet characters ('A' and 'C')
-   * to that consisting of binary ('0' and '1').
+   * to the corresponding sequence of bits.
    * Assumes that the string will always have valid characters ('A' or 'C').
-   * One to one mapping from  'A' to '0' and 'C' to '1'.
-   * @return mapped sting
+   * One to one mapping from  'A' to 0 and 'C' to 1.
+   * @return mapped sequence
    */
-  std::string dna_to_binary(const std::string &str) const;
+  SEQUENCE dna_to_binary(const std::string &str) const;
+};
+
+/** Class BasicParser
+ * Parser specialised for the given alphabet (@see DnaAlphabet, ProtAlphabet,
+ * GenAlphabet, SelAlphabet).
+ * The length of an encoded character is a compile-time constant (except for
+ * SelAlphabet) so that the encoding and decoding loops can be unrolled.
+ */
+template <class Alphabet> class BasicParser : public Parser {
+public:
+  /** @brief Constructs the parser.
+   *
+   * @param alphabet string containing all the letters of the alphabet
+   * (required only for the user-defined alphabet SelAlphabet).
+   */
+  explicit BasicParser(const std::string &alphabet = std::string());
+
+  ReturnStatus encode_from_string(const std::string &str,
+                                  SEQUENCE &sequence) const override;
+
+  ReturnStatus encode_in_place(const char *str, const UINT_64 len,
+                               Bit_writer &writer) const override;
+
+  UINT_64 count_codes(const char *str, const UINT_64 len) const override;
+
+  ReturnStatus decode_to_string(const SEQUENCE &sequence, UINT_64 &pvs_hanging,
+                                int &num_hanging,
+                                std::string &str) const override;
+
+  ReturnStatus append_reverse_complement(const SEQUENCE &sequence,
+                                         SEQUENCE &rc) const override;
+
+  int get_code_len() const override { return code_len(); }
 
 private:
-  const AlphabetType _cAlphabetType; //< Type of alphabet: DNA, PROT, SEL or GEN
   const std::string
       _cAlphabet; //< Original alphabet (string of valid characters)
   // Assumes alphabet size to be not more than 2^8-1 (i.e. 255)
-  const int _cOriginal_alphbet_size; // Size of the original alphabet: s
   const int _cEncoded_char_len; // log_2 s (for specialised alphabet) or 8 (for
                                 // general alphabet)
 
-  /** Checks the validity of the given character.
-   * Tests whether the character is graphical or space character.
-   * */
-  bool is_valid_char_general(const char c) const;
+  /** Entries of the encoding table which are not codes */
+  static const UINT_16 cSkip_code = 0x100;    //< character is ignored
+  static const UINT_16 cInvalid_code = 0x200; //< character is invalid
+  /** Number of characters encoded together by the SIMD encoder */
+  static const int cSimd_block = 16;
 
-  /** @brief Maps some character from the alphabet to corresponding encoded
-   * representation (string of '0' and '1').
-   * Assumes will always be a valid character.
+  /** Kinds of SIMD encoder (@see build_encode_table)
+   * NONE: not available for this alphabet
+   * NIBBLE: code of a character is given by its low nibble (e.g. DNA)
+   * BYTE: code of a character is the character itself (GEN)
    */
-  ENCODED_CHAR map_char_general(const char c) const;
+  enum class SimdEncoder { NONE, NIBBLE, BYTE };
+
+  /** Encoding table: code of each of the 256 characters, or cSkip_code or
+   * cInvalid_code */
+  std::array<UINT_16, 256> _encode_table;
+  SimdEncoder _simd_encoder;
+  /** Tables (indexed by nibbles) used by the NIBBLE SIMD encoder:
+   * A character c is valid iff (_lo_class[lo(c)] & _hi_class[hi(c)]) != 0 and
+   * its code is _nibble_code[lo(c)]. */
+  std::array<UINT_8, 16> _nibble_code;
+  std::array<UINT_8, 16> _lo_class;
+  std::array<UINT_8, 16> _hi_class;
+
+  /** Decoding tables
+   * _decode_char[code] is the character of an encoded character (or
+   * cInvalid_code);
+   * _decode_table[bits] gives the characters (first in the lowest byte) of the
+   * decode_symbols() encoded characters in bits (decode_bits() of them), and in
+   * its highest byte the number of leading ones that are valid codes.
+   */
+  std::vector<UINT_16> _decode_char;
+  std::vector<UINT_64> _decode_table;
 
-  /** @brief Maps the encoded representation to the corresponding character in
-   * the alphabet.
-   * Assumes will always be a valid encoded character.
-   * Considers the given encoded character to be the binary representation of
-   * the corresponding character.
+  /** @brief Length of an encoded character (a constant unless SelAlphabet).
    */
-  char reverse_map_char_general(const ENCODED_CHAR c) const;
-
-  /** Checks the validity of the given character.
-   * Tries to find the character in the alphabet string .
-    * */
-  bool is_valid_char_select(const char c) const;
-
-  /** @brief Maps some character from the alphabet to corresponding encoded
-   * representation.
-   * Assumes will always be a valid character.
-   * Uses the binary representation of the corresponding position of the
-   * character in the alphabet.
+  int code_len() const {
+    return (Alphabet::cCode_len != 0) ? static_cast<int>(Alphabet::cCode_len)
+                                      : _cEncoded_char_len;
+  }
+
+  /** @brief Number of encoded characters decoded per lookup: as many as fit in
+   * 12 bits (table stays in L1/L2), at most 7 (the highest byte of an entry is
+   * the count).
    */
-  ENCODED_CHAR map_char_select(const char c) const;
+  int decode_symbols() const {
+    return (code_len() >= 12) ? 1 : ((12 / code_len() > 7) ? 7
+                                                           : 12 / code_len());
+  }
 
-  /** @brief Maps the encoded representation to the corresponding character in
-   * the alphabet.
-   * Assumes will always be a valid encoded character.
-   * Considers the given encoded character to be the binary representation of
-   * some position in the alphabet and maps it to the corresponding character.
+  /** @brief Number of bits consumed per lookup in the decoding table.
    */
-  char reverse_map_char_select(const ENCODED_CHAR c) const;
-
-  /** Checks the validity of the given DNA character.
-   * Hard-coded.
-   * */
-  bool is_valid_char_dna(const char c) const;
+  int decode_bits() const { return decode_symbols() * code_len(); }
 
-  /** @brief Maps the DNA character to corresponding encoded representation.
-   * Assumes will always be a valid character.
+  /** @brief Code of the character (or -1 if invalid) as defined by the
+   * alphabet.
    */
-  ENCODED_CHAR map_char_dna(const char c) const;
+  int char_code(const char c) const;
 
-  /** @brief Maps the encoded representation to the corresponding DNA character.
-   * Assumes will always be a valid encoded character.
+  /** @brief Builds the encoding table (and the SIMD tables when the alphabet
+   * permits) from the codes of the alphabet.
+   * Called once by the constructor.
    */
-  char reverse_map_char_dna(const ENCODED_CHAR c) const;
+  void build_encode_table();
 
-  /** Checks the validity of the given PROT character.
-     * Hard-coded.
-     * */
-  bool is_valid_char_prot(const char c) const;
+  /** @brief Builds the decoding tables by reversing the encoding table (the
+   * first character with a code is the decoded one, e.g. upper-case for DNA).
+   * Called once by the constructor (after build_encode_table).
+   */
+  void build_decode_table();
 
-  /** @brief Maps the PROT character to corresponding encoded representation.
-     * Assumes will always be a valid character.
-     */
-  ENCODED_CHAR map_char_prot(const char c) const;
+  /** @brief Encodes the characters, appending them to OUT (SEQUENCE or
+   * Bit_writer): in SIMD blocks and through the table.
+   * @return execution status // ERR_INVALID_INPUT for an invalid character.
+   */
+  template <class OUT>
+  ReturnStatus encode(const char *str, const UINT_64 len, OUT &out) const;
 
-  /** @brief Maps the encoded representation to the corresponding PROT
-   * character.
-   * Assumes will always be a valid encoded character.
+  /** @brief Encodes the characters one at a time using the encoding table.
+   * @return execution status // ERR_INVALID_INPUT for an invalid character.
    */
-  char reverse_map_char_prot(const ENCODED_CHAR c) const;
+  template <class OUT>
+  ReturnStatus encode_scalar(const char *str, const UINT_64 len,
+                             OUT &sequence) const;
+
+  /** @brief Encodes the blocks of cSimd_block characters using SIMD
+   * instructions while each block can be (is either valid or one of ' ', '\n',
+   * '\r', '\t').
+   * @return number of characters encoded (a multiple of cSimd_block).
+   */
+  template <class OUT>
+  UINT_64 encode_simd(const char *str, const UINT_64 len,
+                      OUT &sequence) const;
 };
 
+using DnaParser = BasicParser<DnaAlphabet>;
+using ProtParser = BasicParser<ProtAlphabet>;
+using GenParser = BasicParser<GenAlphabet>;
+using SelParser = BasicParser<SelAlphabet>;
+
 } // end namespace
 #endif
@@ -0,0 +1,93 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/** @file Sequence_file.hpp
+ * @brief Defines the class Sequence_file.
+ * It is an encoded sequence kept in a file (of the scratch directory) rather
+ * than in memory.
+ */
+
+#ifndef SEQUENCE_FILE_HPP
+#define SEQUENCE_FILE_HPP
+
+#include <fstream>
+
+#include "globalDefs.hpp"
+
+namespace mawcd {
+/** Class Sequence_file
+ * A Sequence_file is a growable sequence of bits stored in a file: bits are
+ * appended at the end and any part of them read back, so that only a buffer
+ * of the sequence is in memory at a time.
+ * - The file holds the words of the Bit_sequence (@see Bit_sequence) in the
+ *   byte order of the machine; it is meant to be read back by the same
+ *   process (e.g. by Maw_engine in external memory), not to be kept.
+ * - The last bits appended (fewer than cBuffer_bits) are kept in memory until
+ *   they fill whole words.
+ * The file is removed with the object (or by remove()).
+ */
+class Sequence_file {
+public:
+  Sequence_file() = default;
+  Sequence_file(const Sequence_file &) = delete;
+  Sequence_file &operator=(const Sequence_file &) = delete;
+  ~Sequence_file();
+
+  /** @brief Creates the (empty) file, removing the earlier one.
+   *
+   * @return execution status // ERR_FILE_OPEN if the file cannot be created.
+   */
+  ReturnStatus create(const std::string &filename);
+
+  /** @brief Appends the bits at the end.
+   *
+   * @return execution status // ERR_FILE_OPEN if the file cannot be written.
+   */
+  ReturnStatus append(const SEQUENCE &bits);
+
+  /** @brief Reads 'len' bits starting at position 'pos' (pos + len at most
+   * size()).
+   *
+   * @param bits reference in which the bits will be stored (replaced).
+   *
+   * @return execution status // ERR_FILE_OPEN if the file cannot be read.
+   */
+  ReturnStatus read(const UINT_64 pos, const UINT_64 len, SEQUENCE &bits);
+
+  /** @brief Number of bits in the sequence.
+   */
+  UINT_64 size() const { return _flushed + _pending.size(); }
+
+  /** @brief Closes and removes the file.
+   */
+  void remove();
+
+  //////////////////////// private ////////////////////////
+private:
+  static const UINT_64 cBuffer_bits = UINT_64(1) << 23; //< kept before writing
+
+  /** @brief Writes the whole words of the pending bits.
+   */
+  ReturnStatus flush();
+
+  std::fstream _file;     //< opened for reading and writing
+  std::string _filename;  //< empty if no file is created
+  SEQUENCE _pending;      //< last bits, not written yet
+  UINT_64 _flushed = 0;   //< bits written (whole words)
+};
+
+} // end namespace
+#endif
@@ -28,6 +28,8 @@ Pissis
 #include <string>
 #include <vector>
 
+#include "Bit_sequence.hpp"
+
 namespace mawcd {
 #define DEBUG
 
@@ -36,15 +38,26 @@ using UINT_64 = uint64_t;
 using UINT_32 = uint32_t;
 using UINT_16 = uint16_t;
 using UINT_8 = std::uint8_t;
+using INT_64 = int64_t;
 
-using KEY_SIZE = UINT_8;   //< Length of the key to be used (should fit in a byte as it is no more than 32 currently)
-using KEY_TYPE = uint32_t; //< data-type of the key; currently unsigned integer of (32-bits maximum)
+using KEY_SIZE = UINT_8;   //< Length of the key to be used (should fit in a byte as it is no more than 64 currently)
+using KEY_TYPE = uint64_t; //< data-type of the key; currently unsigned integer of (64-bits maximum)
 const int cMax_key_size =
-    32; //< Maximum size of key in the hash-table(anti-dictionary)
+    64; //< Maximum size of key in the hash-table(anti-dictionary)
 const int cNum_table = 2; //< Two hash tables in AD; one each for '0' and '1'
 
-/** Path to the maw tool (which is generating MAWs) */
-const std::string cPath_maw = "./external/maw-master/";
+/** Entries returned by the lookup structures of the anti-dictionary (@see
+ * Ad_bitmap, Ad_hash_table) for a key */
+const UINT_8 cAd_absent = 0;  //< key is not in the anti-dictionary
+const UINT_8 cAd_force_0 = 2; //< key is followed only by '0'
+const UINT_8 cAd_force_1 = 3; //< key is followed only by '1'
+
+/** @brief Mask of the lowest 'len' bits of a key (0 to cMax_key_size).
+ */
+constexpr KEY_TYPE key_mask(const int len) {
+  return (len >= cMax_key_size) ? ~static_cast<KEY_TYPE>(0)
+                                : ((static_cast<KEY_TYPE>(1) << len) - 1);
+}
 
 /** Constants defining various alphabets */
 const std::string cPROTAlphabet = "ACDEFGHIKLMNPQRSTUVWY";
@@ -53,6 +66,7 @@ const std::string cDNAAlphabet = "ACGTN";
 /** Constants defining various extensions of the output files */
 const std::string cExt_com = ".com"; //< extension for compressed file
 const std::string cExt_decom = ".decom"; //< extension for decompressed file
+const std::string cExt_upd = ".upd"; //< extension for updated anti-dictionary
 
 
 /** Enum for various possible states (success or errors) rsturned from a
@@ -76,25 +90,79 @@ enum class ReturnStatus {
 */
 enum class AlphabetType { DNA, PROT, GEN, SEL };
 
+/** Options for the creation of the anti-dictionary (mode AD).
+ * is_multi_length: keep the maws of all the lengths (compiled into an
+ * automaton) instead of only those of the best length
+ * max_states: (multi-length only) maximum number of states of the automaton;
+ * maws are kept in the order of decreasing frequency of their prefixes while
+ * they fit (0 for no limit)
+ * max_memory: maximum memory (in bytes) for indexing the sequence; creation
+ * fails if the index would not fit (0 for no limit)
+ * is_external_memory: build the index of the sequence in files of
+ * scratch_dir (read sequentially) instead of memory, within max_memory
+ * (@see Maw_engine)
+ * scratch_dir: directory of the files of the external-memory index
+ * num_threads: number of threads for the creation (0 for the OpenMP default);
+ * the anti-dictionary does not depend on it
+ * max_keys: maximum number of keys (maws) in the anti-dictionary; those of
+ * highest gain (occurrences of their longest proper prefix, less one for
+ * storing them) are kept (0 for no limit)
+ * is_gain_selection: select the maws of all the lengths by their own gain
+ * (keeping only those of positive gain) instead of all the maws of the best
+ * length; the anti-dictionary is then multi-length
+ * is_compact: save the anti-dictionary compactly (only its keys, coded; the
+ * lookup structure is built when it is loaded)
+ * is_adding_maws: (update only) the maws of the new sequences of positive
+ * gain which are absent from the earlier ones are added to the
+ * anti-dictionary, those of highest gain first, within max_keys and
+ * max_states (@see Anti_dictionary::update)
+ */
+struct AdOptions {
+  bool is_multi_length = false;
+  UINT_64 max_states = 0;
+  UINT_64 max_memory = 0;
+  int num_threads = 0;
+  bool is_external_memory = false;
+  std::string scratch_dir = ".";
+  UINT_64 max_keys = 0;
+  bool is_gain_selection = false;
+  bool is_compact = false;
+  bool is_adding_maws = false;
+};
+
+/** Options for the compression of a file.
+ * block_size: number of (encoded) characters of a block (at least
+ * cMin_block_size); the blocks are compressed independently of one another
+ * (from the context recorded before each one) so that several of them can be
+ * compressed or decompressed at once
+ * num_threads: number of threads for the compression (0 for the OpenMP
+ * default); the compressed file does not depend on it
+ */
+struct ComOptions {
+  UINT_64 block_size = 1 << 24;
+  int num_threads = 0;
+};
+/** Smallest block size: a block is longer than a key */
+const UINT_64 cMin_block_size = cMax_key_size;
+
 /** Various modes of operation of the tools.
  * AD: Creating anti-dictionary
  * COM: Compression
  * DECOM: Decompression
  * BCOM: Batch compression
  * BDECOM: Batch decompression
+ * ADUPDATE: Updating anti-dictionary with new sequences
  */
-enum class Mode { AD, COM, DECOM, BCOM, BDECOM };
+enum class Mode { AD, COM, DECOM, BCOM, BDECOM, ADUPDATE };
 
 /** Types for the internal representation (encoded) of the sequence.
  * */
-/** Assumes alphabet letters are encoded in 0s and 1s ; each of which is
-* represented by an 8 bit char
+/** Assumes alphabet letters are encoded in 0s and 1s ; which are packed into
+* 64-bit words (one bit per bit) by Bit_sequence
 */
-using SEQUENCE = std::string; //< encoded sequence
+using SEQUENCE = Bit_sequence; //< encoded sequence
 using SUBSEQUENCE =
     SEQUENCE; //< subsequence or substring is the same type as that of sequence
-using ENCODED_CHAR =
-    std::string; //< a character is encoded as a string of 0s and 1s
 
 /** Type for the encoded seuquence  when bits are packed into bytes
 */
@@ -26,9 +26,12 @@ Pissis
 #include <getopt.h>
 //#include <sys/time.h>
 
+#include "Sequence_file.hpp"
 #include "globalDefs.hpp"
 
 namespace mawcd {
+class Parser; // Parser.hpp includes this file
+
 /** Structure defining various input flags.
  * */
 struct InputFlags {
@@ -37,6 +40,12 @@ struct InputFlags {
   std::string selected_alphabet;
   std::string input_filename;
   std::string anti_dictionary_filename;
+  AdOptions ad_options;
+  ComOptions com_options;
+  bool is_succinct_lookup = false; //< look keys up in compressed space
+  bool is_corpus = false;          //< input file names the training files
+  bool is_both_strands = false;    //< reverse complements added (DNA)
+  std::string old_input_filename;  //< earlier training files (ADUPDATE)
 };
 
 /** @brief Prints the usage instructions of the tool.
@@ -47,6 +56,22 @@ void usage(void);
  * */
 ReturnStatus decodeFlags(int argc, char *argv[], struct InputFlags &flags);
 
+/** @brief Encodes the sequences of a file (or of the files it names), one
+ * document each, in memory (SEQUENCE) or in a file (Sequence_file).
+ * */
+template <class OUT>
+ReturnStatus encode_documents(const Parser &parser,
+                              const std::string &in_filename,
+                              const bool is_corpus, const bool is_both_strands,
+                              OUT &en_sequence,
+                              std::vector<UINT_64> &doc_start);
+
+/** @brief Encodes (appends) the sequence of a file.
+ * */
+template <class OUT>
+ReturnStatus encode_file(const Parser &parser, const std::string &in_filename,
+                         OUT &en_sequence);
+
 } // end namespace
 
 #endif
@@ -25,8 +25,8 @@ ALPHABET = ['A', 'C', 'G', 'T', 'N']
 param_separator = '\t'
 ###################################################
 INDEX_FILE_NAME = './scripts/quick.index'
-MERGED_FILE_NAME = EXPERIMENT_FOLDER + 'sequence.merged'
-AD_FILE_NAME = EXPERIMENT_FOLDER + 'sequence.merged.ad'
+MANIFEST_FILE_NAME = EXPERIMENT_FOLDER + 'sequence.manifest'
+AD_FILE_NAME = EXPERIMENT_FOLDER + 'sequence.ad'
 
 STATS_FILE_NAME = EXPERIMENT_FOLDER + 'expertiments.stats'
 AD_STATS_FILE_NAME = EXPERIMENT_FOLDER + 'ad.stats'
@@ -73,10 +73,10 @@ def cure_files(log_file):
     comp.wait()
     print ('Index created : ' + INDEX_FILE_NAME + '\n')
 
-    # Open a file to write merged sequence
-    merged_f = open(MERGED_FILE_NAME, 'w')
+    # Open a file to write the names of the cured files (training corpus)
+    manifest_f = open(MANIFEST_FILE_NAME, 'w')
 
-    # Extract each file, create cured copy, delete original, merge sequences
+    # Extract each file, create cured copy, delete original, list it
     with open(INDEX_FILE_NAME) as index_f:
         f_ind = 0
         for index_line in index_f:
@@ -94,6 +94,7 @@ def cure_files(log_file):
             f_name = gz_name[0:-ext]
             cured_f = open(EXPERIMENT_FOLDER + f_name + CURED_EXTENSION, 'w')
             FILES.append(f_name)
+            manifest_f.write(EXPERIMENT_FOLDER + f_name + CURED_EXTENSION + '\n')
 
             # start reading and writing sequences
             with open(DATA_FOLDER + f_name) as f:
@@ -103,14 +104,15 @@ def cure_files(log_file):
                         cured_line = ''.join(cure_char(c)
                                              for c in line.strip())
                         cured_f.write(cured_line)
-                        merged_f.write(cured_line)
                 f.close()
+                cured_f.close()
                 # delete this file
                 cmd = 'rm ' + DATA_FOLDER +f_name
                 comp = subprocess.Popen(cmd, shell=True)
                 comp.wait()
 
         index_f.close()
+        manifest_f.close()
         log_file.write("Number of files: " + str(len(FILES)) + '\n')
 
 # extract key_size and number of total keys from the anti-dictionary
@@ -120,7 +122,18 @@ def collect_ad_stats(ad_file):
     key_size = 0
     num_keys = 0
     with open(ad_file, "rb") as f:
-
+        header = f.read(64)
+        if header[:8] == b'MAWCDAD\0':
+            # version 2 or 3 (compact): fixed header (written on a little
+            # endian machine)
+            key_size = header[16]
+            num_keys = int.from_bytes(
+                    header[24:32], byteorder='little', signed=False)
+            f.close()
+            return (key_size, num_keys)
+        f.seek(0)
+
+        # written before the versioned format
         # read key-size
         chunk = f.read(1)
         if chunk:
@@ -157,7 +170,7 @@ def create_ad(log_file):
     # Append reverse compliment in the reference
     f = open(AD_STATS_FILE_NAME, 'w')
 
-    ad_cmd = TOOL + ' -m AD -a DNA -i ' + MERGED_FILE_NAME + ' -d ' + AD_FILE_NAME
+    ad_cmd = TOOL + ' -m AD -a DNA -c -i ' + MANIFEST_FILE_NAME + ' -d ' + AD_FILE_NAME
     print (ad_cmd)
     t = time.time()
     comp = subprocess.Popen(ad_cmd, stdout=subprocess.PIPE, shell=True)
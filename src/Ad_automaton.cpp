@@ -0,0 +1,108 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/** Implements class Ad_automaton
+ */
+#include "../include/Ad_automaton.hpp"
+
+namespace mawcd {
+
+const Ad_automaton::STATE Ad_automaton::cRoot;
+const UINT_64 Ad_automaton::cMax_states;
+
+ReturnStatus
+Ad_automaton::build(const std::vector<std::vector<KEY_TYPE>> &maws) {
+  const INT_64 cNone = -1;
+  /* Trie of the maws: leaves are the maws; other nodes are the states */
+  std::vector<std::array<INT_64, 2>> child(1, {{cNone, cNone}});
+  std::vector<bool> is_maw(1, false);
+  for (std::size_t len = 1; len < maws.size(); ++len) {
+    for (auto maw : maws[len]) {
+      INT_64 node = 0;
+      for (int i = static_cast<int>(len) - 1; i >= 0 && !is_maw[node]; --i) {
+        const int bit = (maw >> i) & 1;
+        if (child[node][bit] == cNone) {
+          child[node][bit] = static_cast<INT_64>(child.size());
+          child.push_back({{cNone, cNone}});
+          is_maw.push_back(false);
+        }
+        node = child[node][bit];
+      }
+      is_maw[node] = true; // a maw having another as prefix is redundant
+    }
+  }
+
+  /* States numbered in breadth-first order, failure links (longest proper
+   * suffix which is a state) and transitions as in Aho-Corasick */
+  std::vector<INT_64> node_of(1, 0); // node of each state (in order)
+  std::vector<STATE> fail(1, cRoot);
+  std::vector<std::array<STATE, 2>> delta(1);
+  std::vector<std::array<bool, 2>> forbidden(1);
+  for (UINT_64 u = 0; u < node_of.size(); ++u) {
+    const INT_64 node = node_of[u];
+    for (int bit = 0; bit < 2; ++bit) {
+      const INT_64 c = child[node][bit];
+      if (c != cNone && !is_maw[c]) { // child is a state
+        if (node_of.size() > cMax_states) {
+          std::cerr << "Anti-dictionary automaton has too many states (at most "
+                    << cMax_states << ")" << std::endl;
+          return ReturnStatus::ERR_LIMIT_EXCEEDS;
+        }
+        const STATE v = static_cast<STATE>(node_of.size());
+        node_of.push_back(c);
+        fail.push_back((u == cRoot) ? cRoot : delta[fail[u]][bit]);
+        delta.push_back({{cRoot, cRoot}});
+        forbidden.push_back({{false, false}});
+        delta[u][bit] = v;
+      } else {
+        delta[u][bit] = (u == cRoot) ? cRoot : delta[fail[u]][bit];
+      }
+      // ub is a maw, or has a shorter suffix which is a maw
+      forbidden[u][bit] = (c != cNone && is_maw[c]) ||
+                          (u != cRoot && forbidden[fail[u]][bit]);
+    }
+  }
+  const UINT_64 num_states = node_of.size();
+
+  /* Records */
+  _storage.assign(num_states, 0);
+  for (STATE u = 0; u < num_states; ++u) {
+    UINT_64 entry = cAd_absent;
+    if (forbidden[u][0] != forbidden[u][1]) { // both => only at the end
+      entry = forbidden[u][0] ? cAd_force_1 : cAd_force_0;
+    }
+    _storage[u] = static_cast<UINT_64>(delta[u][0]) |
+                  (static_cast<UINT_64>(delta[u][1]) << 31) | (entry << 62);
+  }
+  _states = _storage.data();
+  _num_states = _storage.size();
+  return ReturnStatus::SUCCESS;
+}
+
+void Ad_automaton::map(const UINT_64 *states, const UINT_64 num_states) {
+  clear();
+  _states = states;
+  _num_states = num_states;
+}
+
+void Ad_automaton::clear() {
+  _storage.clear();
+  _storage.shrink_to_fit();
+  _states = nullptr;
+  _num_states = 0;
+}
+
+} // end namespace
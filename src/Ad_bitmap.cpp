@@ -0,0 +1,67 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/** Implements class Ad_bitmap
+ */
+#include "../include/Ad_bitmap.hpp"
+
+namespace mawcd {
+
+const int Ad_bitmap::cMax_key_size;
+
+void Ad_bitmap::build(const int key_size,
+                      const std::vector<std::unordered_set<KEY_TYPE>> &ad) {
+  build_from(key_size, ad);
+}
+
+void Ad_bitmap::build(const int key_size,
+                      const std::vector<std::vector<KEY_TYPE>> &ad) {
+  build_from(key_size, ad);
+}
+
+template <class TABLES>
+void Ad_bitmap::build_from(const int key_size, const TABLES &ad) {
+  _storage.assign(num_words_for(key_size), 0);
+  const UINT_64 entries[cNum_table] = {cAd_force_1, cAd_force_0};
+  for (auto i = 0; i < cNum_table; ++i) {
+    for (auto k : ad[i]) {
+      _storage[k >> 5] |= entries[i] << ((k & 31) << 1);
+    }
+  }
+  _words = _storage.data();
+  _num_words = _storage.size();
+}
+
+void Ad_bitmap::map(const UINT_64 *words, const UINT_64 num_words) {
+  clear();
+  _words = words;
+  _num_words = num_words;
+}
+
+UINT_64 Ad_bitmap::num_words_for(const int key_size) {
+  // At least one word (32 entries) even for the shortest keys
+  const UINT_64 num_keys = static_cast<UINT_64>(1) << key_size;
+  return (num_keys + 31) / 32;
+}
+
+void Ad_bitmap::clear() {
+  _storage.clear();
+  _storage.shrink_to_fit();
+  _words = nullptr;
+  _num_words = 0;
+}
+
+} // end namespace
@@ -0,0 +1,121 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/** Implements class Ad_hash_table
+ */
+#include "../include/Ad_hash_table.hpp"
+
+namespace mawcd {
+
+const int Ad_hash_table::cGroup_size;
+constexpr double Ad_hash_table::cMax_load;
+const UINT_8 Ad_hash_table::cEmpty;
+const UINT_8 Ad_hash_table::cTag_mask;
+const int Ad_hash_table::cForced_shift;
+const UINT_64 Ad_hash_table::cLow_bits;
+const UINT_64 Ad_hash_table::cHigh_bits;
+
+static_assert(sizeof(Ad_hash_table::Group) == 64,
+              "A group must fill a cache line");
+
+/** Size of a cache line, on which the groups are aligned */
+static const std::uintptr_t cCache_line = 64;
+
+void Ad_hash_table::build(const std::vector<std::unordered_set<KEY_TYPE>> &ad) {
+  build_from(ad);
+}
+
+void Ad_hash_table::build(const std::vector<std::vector<KEY_TYPE>> &ad) {
+  build_from(ad);
+}
+
+template <class TABLES> void Ad_hash_table::build_from(const TABLES &ad) {
+  UINT_64 num_keys = 0;
+  for (auto i = 0; i < cNum_table; ++i) {
+    num_keys += ad[i].size();
+  }
+  // Smallest power of 2 number of groups keeping the load within the limit
+  UINT_64 num_groups = 1;
+  while (num_groups * cGroup_size * cMax_load < num_keys) {
+    num_groups <<= 1;
+  }
+  // one more group to align them on a cache line
+  _group_storage.assign(num_groups + 1, Group());
+  const auto address = reinterpret_cast<std::uintptr_t>(_group_storage.data());
+  Group *groups = reinterpret_cast<Group *>((address + cCache_line - 1) &
+                                            ~(cCache_line - 1));
+  for (UINT_64 g = 0; g < num_groups; ++g) {
+    groups[g] = Group();
+    groups[g].ctrl = cEmpty * cLow_bits;
+  }
+  _groups = groups;
+  _group_mask = num_groups - 1;
+  _size = 0;
+
+  const UINT_8 entries[cNum_table] = {cAd_force_1, cAd_force_0};
+  for (auto i = 0; i < cNum_table; ++i) {
+    for (auto k : ad[i]) {
+      insert(k, entries[i]);
+    }
+  }
+}
+
+void Ad_hash_table::map(const Group *groups, const UINT_64 num_groups,
+                        const UINT_64 size) {
+  clear();
+  _groups = groups;
+  _group_mask = num_groups - 1;
+  _size = size;
+}
+
+void Ad_hash_table::clear() {
+  _group_storage.clear();
+  _group_storage.shrink_to_fit();
+  _groups = nullptr;
+  _group_mask = 0;
+  _size = 0;
+}
+
+double Ad_hash_table::load_factor() const {
+  return empty() ? 0.0
+                 : static_cast<double>(_size) / (num_groups() * cGroup_size);
+}
+
+UINT_64 Ad_hash_table::size_in_bytes() const {
+  return num_groups() * sizeof(Group);
+}
+
+//////////////////////// private ////////////////////////
+void Ad_hash_table::insert(const KEY_TYPE key, const UINT_8 entry) {
+  const UINT_64 h = hash(key);
+  Group *groups = const_cast<Group *>(_groups); // built: owned
+  UINT_64 group = (h >> 7) & _group_mask;
+  for (UINT_64 step = 1;; ++step) {
+    Group &g = groups[group];
+    const UINT_64 empty = g.ctrl & cHigh_bits;
+    if (empty != 0) {
+      const int i = __builtin_ctzll(empty) / cByte_Size;
+      const UINT_64 ctrl = (h & cTag_mask) | ((entry & 1) << cForced_shift);
+      g.ctrl ^= (cEmpty ^ ctrl) << (i * cByte_Size);
+      g.keys[i] = key;
+      ++_size;
+      return;
+    }
+    group = (group + step) & _group_mask;
+  }
+}
+
+} // end namespace
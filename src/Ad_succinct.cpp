@@ -0,0 +1,59 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+/** Implements class Ad_succinct
+ */
+#include "../include/Ad_succinct.hpp"
+
+namespace mawcd {
+
+void Ad_succinct::build(const std::vector<std::vector<KEY_TYPE>> &keys) {
+  clear();
+  for (auto i = 0; i < cNum_table; ++i) {
+    auto end = keys[i].end();
+    if (!keys[i].empty() && keys[i].back() == ~static_cast<KEY_TYPE>(0)) {
+      _has_all_ones[i] = true;
+      --end;
+    }
+    _tables[i] = sdsl::sd_vector<>(keys[i].begin(), end);
+    _size += keys[i].size();
+  }
+  _is_built = true;
+}
+
+void Ad_succinct::clear() {
+  for (auto i = 0; i < cNum_table; ++i) {
+    _tables[i] = sdsl::sd_vector<>();
+    _has_all_ones[i] = false;
+  }
+  _size = 0;
+  _is_built = false;
+}
+
+UINT_64 Ad_succinct::size_in_bytes() const {
+  UINT_64 bytes = 0;
+  for (auto &table : _tables) {
+    bytes += sdsl::size_in_bytes(table);
+  }
+  return bytes;
+}
+
+double Ad_succinct::bits_per_key() const {
+  return (_size == 0) ? 0.0 : 8.0 * size_in_bytes() / _size;
+}
+
+} // end namespace
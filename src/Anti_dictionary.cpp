@@ -16,40 +16,133 @@ Pissis
 
 /** Implements class Anti_dictionary
  */
+#include <cstring>
+#include <functional>
+#include <omp.h>
+#include <parallel/algorithm>
+#include <unordered_map>
+
 #include "../include/Anti_dictionary.hpp"
 
 namespace mawcd {
 
-ReturnStatus Anti_dictionary::create(const std::string filename,
-                                     const Parser &parser) {
-  /* Call maw tool to create output file containing maws of size from k to K */
-  std::string temp_output_file = "tmp_out_" + filename;
+ReturnStatus Anti_dictionary::create(const SEQUENCE &seq,
+                                     const AdOptions &options) {
+  return create(seq, std::vector<UINT_64>(1, 0), options);
+}
 
-  const std::string k = "2";
-  // int max_maw_size = static_cast<int>(std::ceil(log2(seq_len + 1))); // Max
-  // MAW size can be log (s+1)
-  int max_maw_size = cMax_key_size; // Currently 32
-  std::string K = std::to_string(max_maw_size);
-  std::string cmd = cPath_maw + "maw -a DNA -i " + filename + " -o " +
-                    temp_output_file + " -k " + k + " -K " + K;
+ReturnStatus Anti_dictionary::create(const SEQUENCE &seq,
+                                     const std::vector<UINT_64> &doc_start,
+                                     const AdOptions &options) {
+  /* Index the sequence to compute its maws of size from 2 to K */
+  Maw_engine engine;
+  auto status = engine.build(seq, doc_start, options);
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
+  return create_from(engine, options);
+}
 
-  if (system(cmd.c_str()) != 0) {
-    std::cerr << "Could not run MAW Tool \n";
-    return ReturnStatus::ERR_EXTERNAL;
+ReturnStatus Anti_dictionary::create(Sequence_file &seq_file,
+                                     const std::vector<UINT_64> &doc_start,
+                                     const AdOptions &options) {
+  Maw_engine engine;
+  auto status = engine.build(seq_file, doc_start, options);
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
   }
+  return create_from(engine, options);
+}
 
-  /* Choose the length of the maws */
-  choose_maw_size(filename, temp_output_file, max_maw_size);
-  /* Read the output (maws) and store them in hash-table after encoding them */
-  load_chosen_maws(temp_output_file, parser);
-  /* Delete temp temp file */
-  remove(temp_output_file.c_str());
+ReturnStatus Anti_dictionary::create_from(const Maw_engine &engine,
+                                          const AdOptions &options) {
+  const int max_maw_size = cMax_key_size + 1; // key is one bit shorter than maw
+  ReturnStatus status;
+  if (options.is_multi_length || options.is_gain_selection) {
+    /* Keep the maws of all the lengths */
+    status = load_all_maws(engine, options);
+  } else {
+    /* Choose the length of the maws */
+    status = choose_maw_size(engine, max_maw_size, options.max_keys);
+    if (status == ReturnStatus::SUCCESS) {
+      /* Store the maws of chosen length in hash-table after encoding them */
+      status = load_chosen_maws(engine, options);
+    }
+  }
+  if (status == ReturnStatus::SUCCESS) {
+    /* Built once here as it is saved (@see write_binary) */
+    status = choose_lookup();
+  }
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
 
   std::cout << "Anti-dictionary created successfully of size: " << _ad_size
             << std::endl;
   return ReturnStatus::SUCCESS;
 }
 
+ReturnStatus Anti_dictionary::update(const SEQUENCE &seq,
+                                     const std::vector<UINT_64> &doc_start,
+                                     const AdOptions &options,
+                                     const SEQUENCE &old_seq,
+                                     const std::vector<UINT_64> &old_doc_start) {
+  /* Remove the keys whose maw occurs in the new documents */
+  auto keys = sorted_keys();
+  const auto occurring = find_occurring(keys, seq, doc_start);
+  UINT_64 num_removed = 0;
+  std::vector<std::vector<KEY_TYPE>> removed(keys.size());
+  for (std::size_t g = 0; g < keys.size(); ++g) {
+    std::size_t num_kept = 0;
+    for (std::size_t i = 0; i < keys[g].size(); ++i) {
+      if (!occurring[g][i]) {
+        keys[g][num_kept++] = keys[g][i];
+      } else {
+        removed[g].push_back(keys[g][i]);
+      }
+    }
+    num_removed += keys[g].size() - num_kept;
+    keys[g].resize(num_kept);
+  }
+  std::cout << "Update: removed " << num_removed
+            << " keys whose maw occurs in the new sequences" << std::endl;
+
+  /* Add the maws of the new documents */
+  if (options.is_adding_maws) {
+    auto status = add_maws(seq, doc_start, options, old_seq, old_doc_start,
+                           removed, keys);
+    if (status != ReturnStatus::SUCCESS) {
+      return status;
+    }
+  }
+
+  /* Lookup structure of the keys (no longer those of the file if loaded) */
+  UINT_64 num_keys = 0;
+  for (auto &group : keys) {
+    num_keys += group.size();
+  }
+  for (auto &table : _ad) {
+    table.clear();
+  }
+  _maws.clear();
+  if (_is_multi_length) {
+    _maws.swap(keys);
+  } else {
+    for (int i = 0; i < cNum_table; ++i) {
+      _ad[i].insert(keys[i].begin(), keys[i].end());
+    }
+  }
+  _ad_size = static_cast<int>(num_keys);
+  auto status = choose_lookup();
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
+
+  std::cout << "Anti-dictionary updated successfully of size: " << _ad_size
+            << std::endl;
+  return ReturnStatus::SUCCESS;
+}
+
 ReturnStatus Anti_dictionary::read(std::ifstream &adfile) {
 
   std::string line;
@@ -69,7 +162,7 @@ ReturnStatus Anti_dictionary::read(std::ifstream &adfile) {
         break;
       }
     } else {
-      KEY_TYPE key = static_cast<KEY_TYPE>(std::stoi(line));
+      KEY_TYPE key = static_cast<KEY_TYPE>(std::stoull(line));
       _ad[letter].insert(key);
       ++_ad_size;
     }
@@ -80,16 +173,27 @@ ReturnStatus Anti_dictionary::read(std::ifstream &adfile) {
               << std::endl;
     return ReturnStatus::ERR_INVALID_INPUT;
   }
+  auto status = choose_lookup();
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
   std::cout << "Anti-dictionary created successfully of size: " << _ad_size
             << std::endl;
   return ReturnStatus::SUCCESS;
 }
 
 ReturnStatus Anti_dictionary::write(std::ofstream &adfile) const {
+  if (_is_multi_length) {
+    std::cerr << "Multi-length anti-dictionary can only be saved in the binary "
+                 "format"
+              << std::endl;
+    return ReturnStatus::ERR_INVALID_INPUT;
+  }
   // First line gives the key size;
   adfile << _key_size << std::endl;
+  const auto keys = sorted_keys();
   for (auto i = 0; i < cNum_table; ++i) {
-    for (auto k : _ad[i]) {
+    for (auto k : keys[i]) {
       adfile << k << std::endl;
     }
     adfile << std::endl;
@@ -98,136 +202,338 @@ ReturnStatus Anti_dictionary::write(std::ofstream &adfile) const {
   return ReturnStatus::SUCCESS;
 }
 
-ReturnStatus Anti_dictionary::read_binary(std::ifstream &adfile) {
+// Keys are grouped by the number of bytes (1, 2, 4) they need
+/** Reads the given number of keys, each of sizeof(T) bytes, into the table */
+template <class T>
+static void read_keys(std::ifstream &adfile, const UINT_64 num,
+               std::unordered_set<KEY_TYPE> &table) {
+  std::vector<T> keys(num);
+  adfile.read((char *)(keys.data()), num * sizeof(T));
+  for (auto k : keys) {
+    table.insert(static_cast<KEY_TYPE>(k));
+  }
+}
 
-  std::vector<std::vector<UINT_8>> keys_1B{{}, {}};
-  std::vector<std::vector<UINT_16>> keys_2B{{}, {}};
-  std::vector<std::vector<UINT_32>> keys_4B{{}, {}};
+/** Reads a number (of keys) stored in sizeof(T) bytes */
+template <class T> static UINT_64 read_num(std::ifstream &adfile) {
+  T num = 0;
+  adfile.read((char *)(&num), sizeof(num));
+  return num;
+}
+
+/** Keys of the unversioned files (@see read_binary) are of at most 32 bits,
+ * the width of KEY_TYPE when they were written */
+static const int cMax_unversioned_key_size = 32;
+
+/* Binary format of version 2 (@see write_binary) */
+/** Header of the file */
+struct Ad_header {
+  char magic[8];
+  UINT_32 version;
+  UINT_32 byte_order;
+  UINT_8 key_size;
+  UINT_8 key_width;
+  UINT_8 lookup;
+  UINT_8 pad;
+  UINT_32 id; //< @see Anti_dictionary::get_id
+  UINT_64 ad_size;
+  UINT_64 num_lookup; //< words, slots or states
+  UINT_64 num_hashed; //< keys in the hash-table
+  UINT_64 payload_size;
+  UINT_64 checksum;
+};
+static_assert(sizeof(Ad_header) == 64, "Header must be of 64 bytes");
+static const char cAd_magic[8] = "MAWCDAD";
+static const UINT_32 cAd_version = 2;
+static const UINT_32 cAd_compact_version = 3;
+static const UINT_32 cByte_order_mark = 0x01020304;
+/** Lookup structure saved in the file (1 was a hash-table with its control
+ * bytes apart from its slots; it is no longer read) */
+enum class Lookup : UINT_8 { BITMAP, AUTOMATON = 2, HASH_TABLE };
+/** Sections of the payload are padded to a multiple of this many bytes */
+static const UINT_64 cSection_align = 32;
+
+/** Number of bytes of a section (padded) */
+static UINT_64 section_bytes(const UINT_64 bytes) {
+  return (bytes + cSection_align - 1) / cSection_align * cSection_align;
+}
 
+/** Checksum of a payload: four independent lanes over the words (a multiple
+ * of four) so that it is checked at the speed of reading memory */
+class Checksum {
+public:
+  void add(const UINT_64 *words, const UINT_64 num) {
+    for (UINT_64 i = 0; i < num; i += 4) {
+      for (int j = 0; j < 4; ++j) {
+        _lanes[j] = (_lanes[j] ^ words[i + j]) * cMix;
+        _lanes[j] ^= _lanes[j] >> 32;
+      }
+    }
+  }
+  UINT_64 value() const {
+    UINT_64 sum = 0;
+    for (int j = 0; j < 4; ++j) {
+      sum = (sum ^ _lanes[j]) * cMix;
+      sum ^= sum >> 32;
+    }
+    return sum;
+  }
+
+private:
+  static const UINT_64 cMix = 0x9e3779b97f4a7c15ULL;
+  UINT_64 _lanes[4] = {1, 2, 3, 4};
+};
+
+/* Compact format (version 3): the keys of each group, ascending, are coded as
+ * their gaps (the first key itself) in varints: 7 bits per byte, least
+ * significant first, the highest bit set on every byte but the last */
+/** Appends the varint of the value */
+static void put_varint(UINT_64 value, std::vector<UINT_8> &bytes) {
+  while (value >= 0x80) {
+    bytes.push_back(static_cast<UINT_8>(value | 0x80));
+    value >>= 7;
+  }
+  bytes.push_back(static_cast<UINT_8>(value));
+}
+
+/** Reads a varint at p (before end), advancing p; false if it is cut by end
+ * or does not fit in 64 bits */
+static bool get_varint(const UINT_8 *&p, const UINT_8 *end, UINT_64 &value) {
+  value = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    const UINT_8 byte = *p++;
+    value |= static_cast<UINT_64>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return shift < 63 || (byte >> 1) == 0;
+    }
+  }
+  return false;
+}
+
+/** Decodes the num keys (of at most max_key) of a group at p (before end) into
+ * keys, advancing p; false if they are not valid.
+ * Eight bytes are read at a time: when none continues a varint (the common
+ * case of dense keys), they are eight gaps at once. */
+static bool get_keys(const UINT_8 *&p, const UINT_8 *end, const UINT_64 num,
+                     const KEY_TYPE max_key, std::vector<KEY_TYPE> &keys) {
+  keys.resize(num);
+  KEY_TYPE key = 0;
+  UINT_64 i = 0;
+  // Adds the gap to the key (no gap but the first one is 0)
+  auto add = [&](const UINT_64 gap) {
+    if ((i != 0 && gap == 0) || gap > max_key - key) {
+      return false;
+    }
+    key += gap;
+    keys[i++] = key;
+    return true;
+  };
+  while (i < num) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (num - i >= 8 && end - p >= 8) {
+      UINT_64 word;
+      std::memcpy(&word, p, sizeof(word));
+      if ((word & 0x8080808080808080ULL) == 0) {
+        for (int b = 0; b < 8; ++b) {
+          if (!add((word >> (b * cByte_Size)) & 0xff)) {
+            return false;
+          }
+        }
+        p += 8;
+        continue;
+      }
+    }
+#endif
+    UINT_64 gap;
+    if (!get_varint(p, end, gap) || !add(gap)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+ReturnStatus Anti_dictionary::read_binary(std::ifstream &adfile) {
   /* Start reading */
   // Actual key length
   adfile.read((char *)(&_key_size), sizeof(_key_size));
+  if (!adfile || _key_size == 0 || _key_size > cMax_unversioned_key_size) {
+    std::cerr << "Invalid Input: Anti-dictionary File has keys of "
+              << static_cast<int>(_key_size) << " bits" << std::endl;
+    return ReturnStatus::ERR_INVALID_INPUT;
+  }
 
   // Number of keys of length 1B in ad_0, then in ad_1; folllowed by info for
   // 2B; then 4B
-  std::vector<std::vector<UINT_32>> num_keys{{}, {}};
+  std::vector<std::vector<UINT_64>> num_keys{{}, {}};
   for (auto ad = 0; ad < cNum_table; ++ad) {
-    UINT_8 num;
-    adfile.read((char *)(&num), sizeof(num));
-    num_keys[ad].push_back(num);
+    num_keys[ad].push_back(read_num<UINT_8>(adfile));
   }
   for (auto ad = 0; ad < cNum_table; ++ad) {
-    UINT_16 num;
-    adfile.read((char *)(&num), sizeof(num));
-    num_keys[ad].push_back(num);
+    num_keys[ad].push_back(read_num<UINT_16>(adfile));
   }
   for (auto ad = 0; ad < cNum_table; ++ad) {
-    UINT_32 num;
-    adfile.read((char *)(&num), sizeof(num));
-    num_keys[ad].push_back(num);
+    num_keys[ad].push_back(read_num<UINT_32>(adfile));
   }
 
-  // Read keys of length 1B, 2B, 4B in ad_0, then in ad_1;
+  // The keys make the rest of the file
+  UINT_64 num_bytes = 0;
   for (auto ad = 0; ad < cNum_table; ++ad) {
-    keys_1B[ad].resize(num_keys[ad][0]);
-    keys_2B[ad].resize(num_keys[ad][1]);
-    keys_4B[ad].resize(num_keys[ad][2]);
-    adfile.read((char *)(keys_1B[ad].data()), num_keys[ad][0] * sizeof(UINT_8));
-    adfile.read((char *)(keys_2B[ad].data()),
-                num_keys[ad][1] * sizeof(UINT_16));
-    adfile.read((char *)(keys_4B[ad].data()),
-                num_keys[ad][2] * sizeof(UINT_32));
+    num_bytes += num_keys[ad][0] * sizeof(UINT_8) +
+                 num_keys[ad][1] * sizeof(UINT_16) +
+                 num_keys[ad][2] * sizeof(UINT_32);
   }
+  const auto keys_start = adfile.tellg();
+  adfile.seekg(0, std::ios::end);
+  const UINT_64 num_left = adfile ? adfile.tellg() - keys_start : 0;
+  adfile.seekg(keys_start);
+  if (!adfile || num_left < num_bytes) {
+    std::cerr << "Invalid Input: Anti-dictionary File is truncated"
+              << std::endl;
+    return ReturnStatus::ERR_INVALID_INPUT;
+  }
+  if (num_left > num_bytes) {
+    std::cerr << "Invalid Input: Anti-dictionary File has bytes after its keys"
+              << std::endl;
+    return ReturnStatus::ERR_INVALID_INPUT;
+  }
+
   // Read keys of length 1B, 2B, 4B in ad_0, then in ad_1;
   for (auto ad = 0; ad < cNum_table; ++ad) {
-    for (auto k : keys_1B[ad]) {
-      KEY_TYPE key = static_cast<KEY_TYPE>(k);
-      _ad[ad].insert(key);
-      ++_ad_size;
-    }
-    for (auto k : keys_2B[ad]) {
-      KEY_TYPE key = static_cast<KEY_TYPE>(k);
-      _ad[ad].insert(key);
-      ++_ad_size;
-    }
-    for (auto k : keys_4B[ad]) {
-      KEY_TYPE key = static_cast<KEY_TYPE>(k);
-      _ad[ad].insert(key);
-      ++_ad_size;
+    read_keys<UINT_8>(adfile, num_keys[ad][0], _ad[ad]);
+    read_keys<UINT_16>(adfile, num_keys[ad][1], _ad[ad]);
+    read_keys<UINT_32>(adfile, num_keys[ad][2], _ad[ad]);
+    _ad_size += _ad[ad].size();
+  }
+  const KEY_TYPE mask = key_mask(_key_size);
+  for (auto ad = 0; ad < cNum_table; ++ad) {
+    for (auto k : _ad[ad]) {
+      if ((k & ~mask) != 0) {
+        std::cerr << "Invalid Input: Anti-dictionary File has a key longer "
+                     "than its key size"
+                  << std::endl;
+        return ReturnStatus::ERR_INVALID_INPUT;
+      }
     }
   }
+  auto status = choose_lookup();
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
   std::cout << "Anti-dictionary created successfully of size: " << _ad_size
             << std::endl;
   return ReturnStatus::SUCCESS;
 }
 
-ReturnStatus Anti_dictionary::write_binary(std::ofstream &adfile) const {
-  // Highest unsigned ints of size (in Bytes) 1, 2, 4
-  std::vector<UINT_64> thresholds = {0xff, 0xffff, 0xffffffff};
+ReturnStatus Anti_dictionary::write_binary(std::ofstream &adfile,
+                                           const bool is_compact) const {
+  if (!_succinct.empty() && !is_compact) {
+    std::cerr << "Anti-dictionary looked up in compressed space can not be "
+                 "saved"
+              << std::endl;
+    return ReturnStatus::ERR_INVALID_INPUT;
+  }
+  Ad_header header{};
+  std::memcpy(header.magic, cAd_magic, sizeof(cAd_magic));
+  header.version = cAd_version;
+  header.byte_order = cByte_order_mark;
+  header.key_size = _is_multi_length ? 0 : _key_size;
+  header.key_width = sizeof(KEY_TYPE);
+  header.id = _id;
+  header.ad_size = static_cast<UINT_64>(_ad_size);
+  const auto start = adfile.tellp();
+  adfile.write((char *)(&header), sizeof(header)); // completed at the end
+
+  Checksum checksum;
+  UINT_64 payload_size = 0;
+  // Writes a section, padded
+  auto write_section = [&](const void *data, const UINT_64 bytes) {
+    const UINT_64 whole = bytes / cSection_align * cSection_align;
+    adfile.write((const char *)(data), whole);
+    checksum.add((const UINT_64 *)(data), whole / sizeof(UINT_64));
+    if (whole != bytes) {
+      UINT_64 tail[cSection_align / sizeof(UINT_64)] = {}; // last part, padded
+      std::memcpy(tail, (const char *)(data) + whole, bytes - whole);
+      adfile.write((char *)(tail), sizeof(tail));
+      checksum.add(tail, cSection_align / sizeof(UINT_64));
+    }
+    payload_size += section_bytes(bytes);
+  };
 
-  std::vector<std::vector<UINT_8>> keys_1B{{}, {}};
-  std::vector<std::vector<UINT_16>> keys_2B{{}, {}};
-  std::vector<std::vector<UINT_32>> keys_4B{{}, {}};
-  // check the number of bytes of each key in each ad and add in corrsponding
-  // vector
-  for (auto ad = 0; ad < cNum_table; ++ad) {
-    for (auto i : _ad[ad]) {
-      if (i <= thresholds[0]) {
-        keys_1B[ad].push_back(static_cast<UINT_8>(i));
-      } else if (i <= thresholds[1]) {
-        keys_2B[ad].push_back(static_cast<UINT_16>(i));
-      } else if (i <= thresholds[2]) {
-        keys_4B[ad].push_back(static_cast<UINT_32>(i));
+  if (is_compact) {
+    /* Keys only: their number in each group, then their gaps */
+    header.version = cAd_compact_version;
+    const auto keys = sorted_keys();
+    header.num_lookup = keys.size();
+    std::vector<UINT_8> bytes;
+    for (auto &group : keys) {
+      put_varint(group.size(), bytes);
+      KEY_TYPE previous = 0;
+      for (auto k : group) {
+        put_varint(k - previous, bytes);
+        previous = k;
       }
     }
+    write_section(bytes.data(), bytes.size());
+  } else if (_is_multi_length) { /* Lookup structure */
+    header.lookup = static_cast<UINT_8>(Lookup::AUTOMATON);
+    header.num_lookup = _automaton.num_states();
+    write_section(_automaton.states(), _automaton.size_in_bytes());
+  } else if (!_bitmap.empty()) {
+    header.lookup = static_cast<UINT_8>(Lookup::BITMAP);
+    header.num_lookup = _bitmap.num_words();
+    write_section(_bitmap.words(), _bitmap.size_in_bytes());
+  } else {
+    header.lookup = static_cast<UINT_8>(Lookup::HASH_TABLE);
+    header.num_lookup = _hash_table.num_groups();
+    header.num_hashed = _hash_table.size();
+    write_section(_hash_table.groups(), _hash_table.size_in_bytes());
   }
-  /* Start writing */
-  // Actual key length
-  adfile.write((char *)(&_key_size), sizeof(_key_size));
-  // Number of keys of length 1B in ad_0, then in ad_1; folllowed by info for
-  // 2B; then 4B
-  for (auto ad = 0; ad < cNum_table; ++ad) {
-    const UINT_8 num = static_cast<UINT_8>(keys_1B[ad].size());
-    adfile.write((char *)(&num), sizeof(num));
-  }
-  for (auto ad = 0; ad < cNum_table; ++ad) {
-    const UINT_16 num = static_cast<UINT_16>(keys_2B[ad].size());
-    adfile.write((char *)&num, sizeof(num));
-  }
-  for (auto ad = 0; ad < cNum_table; ++ad) {
-    const UINT_32 num = static_cast<UINT_32>(keys_4B[ad].size());
-    adfile.write((char *)&num, sizeof(num));
+
+  /* Keys */
+  if (!is_compact) {
+    const auto keys = sorted_keys();
+    std::vector<UINT_64> counts;
+    std::vector<KEY_TYPE> all_keys;
+    for (auto &group : keys) {
+      counts.push_back(group.size());
+      all_keys.insert(all_keys.end(), group.begin(), group.end());
+    }
+    write_section(counts.data(), counts.size() * sizeof(UINT_64));
+    write_section(all_keys.data(), all_keys.size() * sizeof(KEY_TYPE));
   }
-  // Write keys of length 1B, 2B, 4B in ad_0, then in ad_1;
-  for (auto ad = 0; ad < cNum_table; ++ad) {
-    adfile.write((char *)(keys_1B[ad].data()),
-                 keys_1B[ad].size() * sizeof(UINT_8));
-    adfile.write((char *)(keys_2B[ad].data()),
-                 keys_2B[ad].size() * sizeof(UINT_16));
-    adfile.write((char *)(keys_4B[ad].data()),
-                 keys_4B[ad].size() * sizeof(UINT_32));
+
+  header.payload_size = payload_size;
+  header.checksum = checksum.value();
+  adfile.seekp(start);
+  adfile.write((char *)(&header), sizeof(header));
+  adfile.seekp(0, std::ios::end);
+  if (!adfile) {
+    std::cerr << "Anti-dictionary could not be written" << std::endl;
+    return ReturnStatus::ERR_FILE_OPEN;
   }
   std::cout << "Anti-dictionary saved successfully. " << std::endl;
   return ReturnStatus::SUCCESS;
 }
 
-bool Anti_dictionary::find_following_letter(const KEY_TYPE &key,
-                                            char &letter) const {
-  bool found = false;
-  for (auto i = 0; i < cNum_table; ++i) {
-    auto it = _ad[i].find(key);
-    if (it != _ad[i].end()) { // search successful => this k-1mer is
-      // followed by this letter
-      if (i == 0) {
-        letter = '1';
-      } else {
-        letter = '0';
-      }
-      found = true;
-      break;
-    }
+ReturnStatus Anti_dictionary::load_binary(const std::string &filename,
+                                          const bool is_succinct) {
+  _is_succinct = is_succinct;
+  if (_file.open(filename) != ReturnStatus::SUCCESS) {
+    std::cerr << "Cannot open anti-dictionary file \n";
+    return ReturnStatus::ERR_FILE_OPEN;
   }
-  return found;
+  if (_file.size() >= sizeof(cAd_magic) &&
+      std::memcmp(_file.data(), cAd_magic, sizeof(cAd_magic)) == 0) {
+    return map_binary();
+  }
+  /* Version 1: parsed */
+  _file.close();
+  std::ifstream adfile(filename, std::ios::binary);
+  if (!adfile.is_open()) {
+    std::cerr << "Cannot open anti-dictionary file \n";
+    return ReturnStatus::ERR_FILE_OPEN;
+  }
+  return read_binary(adfile);
 }
 
 // Finds the size of the key
@@ -239,10 +545,20 @@ int Anti_dictionary::get_key_size() const {
 int Anti_dictionary::get_ad_size() const { return _ad_size; }
 
 void Anti_dictionary::print() const {
+  const auto keys = sorted_keys();
+  if (_is_multi_length) {
+    for (std::size_t len = 1; len < keys.size(); ++len) {
+      for (auto maw : keys[len]) {
+        std::string full_maw = (std::bitset<cMax_key_size>(maw)).to_string();
+        std::cout << full_maw.substr(cMax_key_size - len) << std::endl;
+      }
+    }
+    return;
+  }
   int valid_bits = cMax_key_size - _key_size;
   for (auto i = 0; i < cNum_table; ++i) {
     std::cout << "AD " << i << std::endl;
-    for (auto k : _ad[i]) {
+    for (auto k : keys[i]) {
       std::string full_key = (std::bitset<cMax_key_size>(k)).to_string();
       std::cout << full_key.substr(valid_bits, _key_size) << std::endl;
     }
@@ -250,168 +566,728 @@ void Anti_dictionary::print() const {
 }
 
 //////////////////////// private ////////////////////////
-ReturnStatus Anti_dictionary::choose_maw_size(const std::string &seqfilename,
-                                              const std::string &mawfilename,
-                                              const int max_maw_size) {
-  std::ifstream infile(mawfilename);
-  std::cout << "OPENED:::" << mawfilename << std::endl;
-  if (!infile.is_open()) {
-    std::cerr << "Cannot open MAW file \n";
-    return ReturnStatus::ERR_FILE_OPEN;
+ReturnStatus Anti_dictionary::choose_lookup() {
+  _bitmap.clear();
+  _hash_table.clear();
+  _automaton.clear();
+  _succinct.clear();
+  _key_counts = nullptr;
+  _decoded_keys.clear();
+  _file.close();
+  if (_is_multi_length) {
+    auto status = _automaton.build(_maws);
+    if (status != ReturnStatus::SUCCESS) {
+      return status;
+    }
+    std::cout << "Lookup: automaton of " << _automaton.num_states()
+              << " states in " << _automaton.size_in_bytes() << " bytes"
+              << std::endl;
+  } else if (_is_succinct) {
+    build_succinct();
+  } else if (_key_size <= Ad_bitmap::cMax_key_size) {
+    _bitmap.build(_key_size, _ad);
+    std::cout << "Lookup: bitmap of " << _bitmap.size_in_bytes() << " bytes"
+              << std::endl;
+  } else {
+    _hash_table.build(_ad);
+    std::cout << "Lookup: hash-table of " << _hash_table.size_in_bytes()
+              << " bytes (load factor " << _hash_table.load_factor() << ")"
+              << std::endl;
   }
-  std::string line;
-  int lineNum = 0;
-  // Read the first line with sequence name
-  getline(infile, line);
-  if (line.empty()) {
-    std::cerr << "Invalid Input: Empty MAW File: " << std::endl;
+  _id = compute_id();
+  return ReturnStatus::SUCCESS;
+}
+
+ReturnStatus Anti_dictionary::map_binary() {
+  auto invalid = [](const std::string &reason) {
+    std::cerr << "Invalid Input: Anti-dictionary File " << reason << std::endl;
     return ReturnStatus::ERR_INVALID_INPUT;
+  };
+  _bitmap.clear();
+  _hash_table.clear();
+  _automaton.clear();
+  _succinct.clear();
+  _key_counts = nullptr;
+  _decoded_keys.clear();
+  if (_file.size() < sizeof(Ad_header)) {
+    return invalid("is truncated");
   }
-  if (line[0] != '>') {
-    std::cerr
-        << "Invalid Input: Not a proper MAW format: Expected '>' at line number"
-        << lineNum << std::endl;
-    return ReturnStatus::ERR_INVALID_INPUT;
+  Ad_header header;
+  std::memcpy(&header, _file.data(), sizeof(header));
+  if (header.byte_order != cByte_order_mark) {
+    return invalid("is written on a machine of the other byte order");
   }
-  /* Read the input sequence and create suffix array to answer frquency of maws
-     */
-  sdsl::csa_bitcompressed<> csa;
-  create_seq_csa(seqfilename, csa);
-  /* Read the file once to choose the length of maws. */
-  std::vector<int> freq(max_maw_size + 1,
-                        0); // freq[i] = total frequencies of maws of length i
-  std::vector<int> num_maws(
-      max_maw_size + 1,
-      0); // num_maws[i] = total number of maws of length i
-
-  // Collect the frequency and number of maws of each length
-  int min_maw_size = max_maw_size;
-  int line_num = 0;
-  while (getline(infile, line)) {
-    ++line_num;
-    if (!line.empty()) {
-      int maw_len = line.size();
-      // Find the number of occs of the longest prefix of this maw
-      auto f = sdsl::count(csa, line.substr(0, maw_len - 1));
-      ++num_maws[maw_len];
-      freq[maw_len] += f;
-      if (maw_len < min_maw_size) {
-        min_maw_size = maw_len;
+  if (header.version != cAd_version &&
+      header.version != cAd_compact_version) {
+    return invalid("has unknown version: " + std::to_string(header.version));
+  }
+  if (header.key_width != sizeof(KEY_TYPE) ||
+      header.key_size > cMax_key_size) {
+    std::cerr << "Anti-dictionary keys of "
+              << static_cast<int>(header.key_size)
+              << " bits exceed the maximum key size " << cMax_key_size
+              << std::endl;
+    return ReturnStatus::ERR_LIMIT_EXCEEDS;
+  }
+  const UINT_64 payload_size = _file.size() - sizeof(Ad_header);
+  if (header.payload_size != payload_size ||
+      payload_size % cSection_align != 0) {
+    return invalid("is truncated");
+  }
+  const UINT_64 *payload =
+      reinterpret_cast<const UINT_64 *>(_file.data() + sizeof(Ad_header));
+  Checksum checksum;
+  checksum.add(payload, payload_size / sizeof(UINT_64));
+  if (checksum.value() != header.checksum) {
+    return invalid("is corrupt (checksum mismatch)");
+  }
+  if (header.version == cAd_compact_version) {
+    auto status = decode_compact(header.key_size);
+    if (status == ReturnStatus::SUCCESS) {
+      _id = (header.id != 0) ? header.id : compute_id();
+    }
+    return status;
+  }
+
+  /* Lookup structure */
+  const char *section = _file.data() + sizeof(Ad_header);
+  const UINT_64 num = header.num_lookup;
+  if (num > payload_size) {
+    return invalid("has an invalid lookup structure");
+  }
+  UINT_64 lookup_bytes = 0;
+  const Lookup lookup = static_cast<Lookup>(header.lookup);
+  _is_multi_length = (lookup == Lookup::AUTOMATON);
+  _key_size = header.key_size;
+  if (lookup == Lookup::BITMAP && _key_size != 0 &&
+      _key_size <= Ad_bitmap::cMax_key_size &&
+      num == Ad_bitmap::num_words_for(_key_size)) {
+    lookup_bytes = section_bytes(num * sizeof(UINT_64));
+  } else if (lookup == Lookup::HASH_TABLE && _key_size != 0 &&
+             num != 0 && (num & (num - 1)) == 0 &&
+             header.num_hashed <=
+                 num * Ad_hash_table::cGroup_size * Ad_hash_table::cMax_load) {
+    lookup_bytes = section_bytes(num * sizeof(Ad_hash_table::Group));
+  } else if (lookup == Lookup::AUTOMATON && _key_size == 0 && num != 0 &&
+             num <= Ad_automaton::cMax_states) {
+    lookup_bytes = section_bytes(num * sizeof(UINT_64));
+  } else {
+    return invalid("has an invalid lookup structure");
+  }
+
+  /* Keys (left in the file) */
+  const UINT_64 num_groups =
+      _is_multi_length ? cMax_key_size + 1 : cNum_table;
+  const UINT_64 counts_bytes = section_bytes(num_groups * sizeof(UINT_64));
+  if (lookup_bytes + counts_bytes > payload_size) {
+    return invalid("is truncated");
+  }
+  const UINT_64 *counts =
+      reinterpret_cast<const UINT_64 *>(section + lookup_bytes);
+  UINT_64 num_keys = 0;
+  for (UINT_64 g = 0; g < num_groups; ++g) {
+    if (counts[g] > payload_size) {
+      return invalid("is truncated");
+    }
+    num_keys += counts[g];
+  }
+  if (lookup_bytes + counts_bytes +
+          section_bytes(num_keys * sizeof(KEY_TYPE)) !=
+      payload_size) {
+    return invalid("is truncated");
+  }
+
+  _key_counts = counts;
+  if (_is_succinct && !_is_multi_length) { // the mapped lookup is not used
+    build_succinct();
+  } else if (lookup == Lookup::BITMAP) {
+    _bitmap.map(reinterpret_cast<const UINT_64 *>(section), num);
+    std::cout << "Lookup: bitmap of " << _bitmap.size_in_bytes()
+              << " bytes (mapped)" << std::endl;
+  } else if (lookup == Lookup::HASH_TABLE) {
+    _hash_table.map(reinterpret_cast<const Ad_hash_table::Group *>(section),
+                    num, header.num_hashed);
+    std::cout << "Lookup: hash-table of " << _hash_table.size_in_bytes()
+              << " bytes (mapped; load factor " << _hash_table.load_factor()
+              << ")" << std::endl;
+  } else {
+    _automaton.map(reinterpret_cast<const UINT_64 *>(section), num);
+    std::cout << "Lookup: automaton of " << _automaton.num_states()
+              << " states in " << _automaton.size_in_bytes()
+              << " bytes (mapped)" << std::endl;
+  }
+  for (auto &table : _ad) {
+    table.clear();
+  }
+  _maws.clear();
+  _ad_size = static_cast<int>(num_keys);
+  _id = (header.id != 0) ? header.id : compute_id();
+  std::cout << "Anti-dictionary created successfully of size: " << _ad_size
+            << std::endl;
+  return ReturnStatus::SUCCESS;
+}
+
+ReturnStatus Anti_dictionary::decode_compact(const int key_size) {
+  _key_size = key_size;
+  _is_multi_length = (key_size == 0);
+  const UINT_64 num_groups =
+      _is_multi_length ? cMax_key_size + 1 : cNum_table;
+  const UINT_8 *p =
+      reinterpret_cast<const UINT_8 *>(_file.data() + sizeof(Ad_header));
+  const UINT_8 *end = reinterpret_cast<const UINT_8 *>(_file.data()) +
+                      _file.size();
+  std::vector<std::vector<KEY_TYPE>> keys(num_groups);
+  UINT_64 num_keys = 0;
+  for (UINT_64 g = 0; g < num_groups; ++g) {
+    const int len = _is_multi_length ? static_cast<int>(g) : key_size;
+    UINT_64 num = 0;
+    // a key takes a byte at least
+    if (!get_varint(p, end, num) || num > static_cast<UINT_64>(end - p) ||
+        (_is_multi_length && g == 0 && num != 0) ||
+        !get_keys(p, end, num, key_mask(len), keys[g])) {
+      std::cerr << "Invalid Input: Anti-dictionary File has invalid keys"
+                << std::endl;
+      return ReturnStatus::ERR_INVALID_INPUT;
+    }
+    num_keys += num;
+  }
+  _file.close();
+
+  /* The lookup structure is built from the keys (kept for sorted_keys()) */
+  for (auto &table : _ad) {
+    table.clear();
+  }
+  _maws.clear();
+  _ad_size = static_cast<int>(num_keys);
+  if (_is_multi_length) {
+    _maws.swap(keys);
+    auto status = choose_lookup();
+    if (status != ReturnStatus::SUCCESS) {
+      return status;
+    }
+  } else {
+    _decoded_keys.swap(keys);
+    if (_is_succinct) {
+      build_succinct();
+    } else if (_key_size <= Ad_bitmap::cMax_key_size) {
+      _bitmap.build(_key_size, _decoded_keys);
+      std::cout << "Lookup: bitmap of " << _bitmap.size_in_bytes()
+                << " bytes" << std::endl;
+    } else {
+      _hash_table.build(_decoded_keys);
+      std::cout << "Lookup: hash-table of " << _hash_table.size_in_bytes()
+                << " bytes (load factor " << _hash_table.load_factor() << ")"
+                << std::endl;
+    }
+  }
+  std::cout << "Anti-dictionary created successfully of size: " << _ad_size
+            << std::endl;
+  return ReturnStatus::SUCCESS;
+}
+
+void Anti_dictionary::build_succinct() {
+  _succinct.build(sorted_keys());
+  std::cout << "Lookup: succinct of " << _succinct.size_in_bytes()
+            << " bytes (" << _succinct.bits_per_key() << " bits per key)"
+            << std::endl;
+}
+
+std::vector<std::vector<KEY_TYPE>> Anti_dictionary::sorted_keys() const {
+  std::vector<std::vector<KEY_TYPE>> keys;
+  if (_key_counts != nullptr) { // mapped: already sorted
+    const UINT_64 num_groups =
+        _is_multi_length ? cMax_key_size + 1 : cNum_table;
+    const UINT_64 *key = _key_counts + section_bytes(num_groups *
+                                                     sizeof(UINT_64)) /
+                                           sizeof(UINT_64);
+    for (UINT_64 g = 0; g < num_groups; ++g) {
+      keys.emplace_back(key, key + _key_counts[g]);
+      key += _key_counts[g];
+    }
+    return keys;
+  }
+  if (!_decoded_keys.empty()) { // read from a compact file: already sorted
+    return _decoded_keys;
+  }
+  if (_is_multi_length) {
+    keys = _maws;
+    keys.resize(cMax_key_size + 1);
+  } else {
+    for (auto &table : _ad) {
+      keys.emplace_back(table.begin(), table.end());
+    }
+  }
+  for (auto &group : keys) {
+    std::sort(group.begin(), group.end());
+  }
+  return keys;
+}
+
+UINT_32 Anti_dictionary::compute_id() const {
+  // key size, number of keys of each group, then the keys (in whole blocks)
+  const auto keys = sorted_keys();
+  std::vector<UINT_64> words(1, _is_multi_length ? 0 : _key_size);
+  for (auto &group : keys) {
+    words.push_back(group.size());
+  }
+  for (auto &group : keys) {
+    words.insert(words.end(), group.begin(), group.end());
+  }
+  words.resize((words.size() + 3) / 4 * 4, 0);
+  Checksum checksum;
+  checksum.add(words.data(), words.size());
+  const UINT_64 sum = checksum.value();
+  const UINT_32 id = static_cast<UINT_32>(sum ^ (sum >> 32));
+  return (id != 0) ? id : 1; // 0 is for no id
+}
+
+ReturnStatus Anti_dictionary::choose_maw_size(const Maw_engine &engine,
+                                              const int max_maw_size,
+                                              const UINT_64 max_keys) {
+  /* Collect the frequency and number of maws of each length in one pass */
+  std::vector<UINT_64> freq;     // freq[i] = total frequencies of maws of length i
+  std::vector<UINT_64> num_maws; // num_maws[i] = total number of maws of length i
+  if (max_keys == 0) {
+    engine.length_histogram(max_maw_size, num_maws, freq);
+  } else {
+    // Only the max_keys maws of highest gain of each length count: kept in
+    // a heap of each length (the smallest gain on top)
+    std::vector<std::vector<UINT_64>> gains(max_maw_size + 1);
+    num_maws.assign(max_maw_size + 1, 0);
+    freq.assign(max_maw_size + 1, 0);
+    engine.for_each_maw(2, max_maw_size, [&](const KEY_TYPE, const int key_len,
+                                             const bool, const UINT_64 f) {
+      auto &g = gains[key_len + 1];
+      if (g.size() < max_keys || f - 1 > g.front()) {
+        g.push_back(f - 1);
+        std::push_heap(g.begin(), g.end(), std::greater<UINT_64>());
+        if (g.size() > max_keys) {
+          std::pop_heap(g.begin(), g.end(), std::greater<UINT_64>());
+          g.pop_back();
+        }
       }
+    });
+    for (auto l = 2; l <= max_maw_size; ++l) {
+      auto &g = gains[l];
+      // so that freq[l] - num_maws[l] is the gain of those kept
+      freq[l] = std::accumulate(g.begin(), g.end(), g.size());
+      num_maws[l] = g.size();
+    }
+  }
+  int min_maw_size = max_maw_size;
+  for (auto l = max_maw_size; l > 1; --l) {
+    if (num_maws[l] != 0) {
+      min_maw_size = l;
     }
   }
   // find the length that gives maximum (positive) number of compressed bits
   // (i.e. freq[l] - num_maws[l])
   // If no such positive number then choose the shortest
   int chosen_maw_size = min_maw_size; // length of the chosen maw
-  int max_comp_bits = 0;
+  INT_64 max_comp_bits = 0;
   for (auto l = max_maw_size; l > 1; --l) {
-    if ((freq[l] - num_maws[l]) > max_comp_bits) {
-      max_comp_bits = freq[l] - num_maws[l];
+    const INT_64 comp_bits =
+        static_cast<INT_64>(freq[l]) - static_cast<INT_64>(num_maws[l]);
+    if (comp_bits > max_comp_bits) {
+      max_comp_bits = comp_bits;
       chosen_maw_size = l;
     }
   }
-  if (chosen_maw_size > cMax_key_size) {
+  if (chosen_maw_size - 1 > cMax_key_size) {
     std::cerr << "Minimum MAW size exceeds the maximum key size in hash-table: "
                  "Mawsize = "
               << min_maw_size << " and key size allowed = " << cMax_key_size
               << " \n";
     return ReturnStatus::ERR_LIMIT_EXCEEDS;
   }
-  _key_size = static_cast<KEY_TYPE>(chosen_maw_size -
+  _key_size = static_cast<KEY_SIZE>(chosen_maw_size -
                                     1); // key is only the first k-1 bits
 #ifdef VERBOSE
   std::cout << "The shortest and chosen maw size: freq: " << min_maw_size
             << " : " << chosen_maw_size << " : " << freq[chosen_maw_size]
             << std::endl;
 #endif
+  return ReturnStatus::SUCCESS;
 }
 
-ReturnStatus Anti_dictionary::load_chosen_maws(const std::string &filename,
-                                               const Parser &parser) {
+ReturnStatus Anti_dictionary::load_chosen_maws(const Maw_engine &engine,
+                                               const AdOptions &options) {
   const int chosen_maw_size = _key_size + 1;
-  std::ifstream infile(filename);
-  if (!infile.is_open()) {
-    std::cerr << "Cannot open MAW file \n";
-    return ReturnStatus::ERR_FILE_OPEN;
+  if (options.max_keys != 0) {
+    std::vector<Maw> maws;
+    engine.for_each_maw(chosen_maw_size, chosen_maw_size,
+                        [&](const KEY_TYPE key, const int, const bool last,
+                            const UINT_64 freq) {
+      maws.push_back(Maw{chosen_maw_size, (key << 1) | last, freq});
+    });
+    // A key which is the prefix of two maws (thus never followed) is dropped
+    std::sort(maws.begin(), maws.end(),
+              [](const Maw &a, const Maw &b) { return a.value < b.value; });
+    std::vector<Maw> single;
+    for (std::size_t i = 0; i < maws.size(); ++i) {
+      if (i + 1 < maws.size() &&
+          (maws[i].value >> 1) == (maws[i + 1].value >> 1)) {
+        ++i;
+      } else {
+        single.push_back(maws[i]);
+      }
+    }
+    std::stable_sort(
+        single.begin(), single.end(),
+        [](const Maw &a, const Maw &b) { return a.freq > b.freq; });
+    select_maws(single, options, false);
+    for (auto &m : single) {
+      _ad[m.value & 1].insert(m.value >> 1);
+    }
+    _ad_size = single.size();
+    return ReturnStatus::SUCCESS;
   }
-  std::string line;
-  int lineNum = 0;
-  // Read the first line with sequence name
-  getline(infile, line);
-  if (line.empty()) {
-    std::cerr << "Invalid Input: Empty MAW File: " << std::endl;
-    return ReturnStatus::ERR_INVALID_INPUT;
+  // Go through the maws again to get only the chosen ones.
+  engine.for_each_maw(chosen_maw_size, chosen_maw_size,
+                      [&](const KEY_TYPE key, const int, const bool last,
+                          const UINT_64) {
+    const int last_letter = last;
+    // k-1 char must only be followed by this last char
+    // Check in the other ad.
+    bool found = false;
+    for (auto i = 0; i < cNum_table; ++i) {
+      if (i != last_letter) {
+        auto it = _ad[i].find(key);
+        if (it != _ad[i].end()) { // search successful => this k-1mer is
+                                  // followed by the other letter
+          _ad[i].erase(it);       // Remove it
+          found = true;
+        }
+      }
+    }
+    if (!found) { // k-1mer is followed only by the last char
+      _ad[last_letter].insert(key);
+      ++_ad_size;
+    }
+  });
+  return ReturnStatus::SUCCESS;
+}
+
+ReturnStatus Anti_dictionary::load_all_maws(const Maw_engine &engine,
+                                            const AdOptions &options) {
+  // the order is total (maws are distinct) hence the same for any threads
+  auto more_frequent = [](const Maw &a, const Maw &b) {
+    if (a.freq != b.freq) {
+      return a.freq > b.freq;
+    }
+    return (a.len != b.len) ? a.len < b.len : a.value < b.value;
+  };
+  /* Collect the maws (that fit in a key); when only max_keys of them are
+   * kept, in a heap of the max_keys most frequent (the least one on top) */
+  const bool is_bounded = options.max_keys != 0 && options.max_states == 0;
+  std::vector<Maw> maws;
+  engine.for_each_maw(2, cMax_key_size, [&](const KEY_TYPE key,
+                                            const int key_len,
+                                            const bool last,
+                                            const UINT_64 freq) {
+    // a maw of no gain saves no more bits than it takes
+    if (options.is_gain_selection && freq <= 1) {
+      return;
+    }
+    const Maw maw{key_len + 1, (key << 1) | last, freq};
+    if (!is_bounded) {
+      maws.push_back(maw);
+    } else if (maws.size() < options.max_keys ||
+               more_frequent(maw, maws.front())) {
+      maws.push_back(maw);
+      std::push_heap(maws.begin(), maws.end(), more_frequent);
+      if (maws.size() > options.max_keys) {
+        std::pop_heap(maws.begin(), maws.end(), more_frequent);
+        maws.pop_back();
+      }
+    }
+  });
+
+  /* Prune: highest gain (most frequent) first while the budgets allow */
+  if (options.max_states != 0 || options.max_keys != 0 ||
+      options.is_gain_selection) {
+    const int num_threads = (options.num_threads > 0) ? options.num_threads
+                                                      : omp_get_max_threads();
+    __gnu_parallel::sort(maws.begin(), maws.end(), more_frequent,
+                         __gnu_parallel::default_parallel_tag(num_threads));
+    select_maws(maws, options, true);
   }
-  if (line[0] != '>') {
-    std::cerr
-        << "Invalid Input: Not a proper MAW format: Expected '>' at line number"
-        << lineNum << std::endl;
-    return ReturnStatus::ERR_INVALID_INPUT;
+
+  _is_multi_length = true;
+  _key_size = 0;
+  _maws.assign(cMax_key_size + 1, std::vector<KEY_TYPE>());
+  for (auto &m : maws) {
+    _maws[m.len].push_back(m.value);
   }
+  _ad_size = maws.size();
+  return ReturnStatus::SUCCESS;
+}
 
-  // Read the file again to get only the chosen maws.
-  while (getline(infile, line)) {
-    if (line.empty()) {
-      break; // empty line => sequence ends
-    }
-    if (line.size() == chosen_maw_size) {
-      SUBSEQUENCE maw = parser.dna_to_binary(line);
-      // Store only (k-1) char
-      const SUBSEQUENCE k_1mer(maw, 0, maw.size() - 1);
-      const int last_letter = std::stoi(maw.substr(maw.size() - 1, 1));
-      KEY_TYPE key = static_cast<KEY_TYPE>(std::stoi(k_1mer, nullptr, 2));
-      // std::cout << "maw: " << maw<< std::endl;
-
-      // k-1 char must only be followed by this last char
-      // Check in the other ad.
-      bool found = false;
-      for (auto i = 0; i < cNum_table; ++i) {
-        if (i != last_letter) {
-          auto it = _ad[i].find(key);
-          if (it != _ad[i].end()) { // search successful => this k-1mer is
-                                    // followed by the other letter
-            _ad[i].erase(it);       // Remove it
-            found = true;
-          }
+void Anti_dictionary::select_maws(std::vector<Maw> &maws,
+                                  const AdOptions &options,
+                                  const bool is_multi_length) const {
+  std::vector<Maw> kept;
+  // states of the automaton: distinct proper prefixes, encoded with a leading
+  // 1 bit (root is the empty prefix)
+  std::unordered_set<KEY_TYPE> prefixes;
+  const bool has_state_limit = is_multi_length && options.max_states != 0;
+  prefixes.insert(1);
+  for (const Maw &m : maws) {
+    if (options.max_keys != 0 && kept.size() >= options.max_keys) {
+      break;
+    }
+    if (has_state_limit) {
+      std::vector<KEY_TYPE> added;
+      for (int p = 1; p < m.len; ++p) {
+        const KEY_TYPE prefix =
+            (static_cast<KEY_TYPE>(1) << p) | (m.value >> (m.len - p));
+        if (prefixes.find(prefix) == prefixes.end()) {
+          added.push_back(prefix);
         }
       }
-      if (!found) { // k-1mer is followed only by the last char
-        _ad[last_letter].insert(key);
-        ++_ad_size;
+      if (prefixes.size() + added.size() > options.max_states) {
+        continue;
       }
+      prefixes.insert(added.begin(), added.end());
     }
-  } // maws for the sequence end
+    kept.push_back(m);
+  }
+  maws.swap(kept);
 }
 
-// TODO: Use SDSL to directly construct csa from the file.
-ReturnStatus Anti_dictionary::create_seq_csa(const std::string &filename,
-                                             sdsl::csa_bitcompressed<> &csa) {
-  std::ifstream infile(filename);
-  if (!infile.is_open()) {
-    std::cerr << "Cannot open input sequence file \n";
-    return ReturnStatus::ERR_FILE_OPEN;
+std::vector<std::vector<bool>> Anti_dictionary::find_occurring(
+    const std::vector<std::vector<KEY_TYPE>> &keys, const SEQUENCE &seq,
+    const std::vector<UINT_64> &doc_start) const {
+  /* where[p]: for each key of p bits, its group and its index there for
+   * each last letter of its maw (a key never followed may have both);
+   * lengths: those in use, shortest first */
+  const std::size_t cNone = static_cast<std::size_t>(-1);
+  struct Key_ref {
+    std::size_t group[2];
+    std::size_t index[2];
+  };
+  std::vector<std::unordered_map<KEY_TYPE, Key_ref>> where(cMax_key_size + 1);
+  std::vector<std::vector<bool>> occurring(keys.size());
+  for (std::size_t g = 0; g < keys.size(); ++g) {
+    occurring[g].assign(keys[g].size(), false);
+    for (std::size_t i = 0; i < keys[g].size(); ++i) {
+      // a maw itself (multi-length), or a key of the group of its last letter
+      const int p = _is_multi_length ? static_cast<int>(g) - 1 : _key_size;
+      const KEY_TYPE key = _is_multi_length ? keys[g][i] >> 1 : keys[g][i];
+      const int last = _is_multi_length ? (keys[g][i] & 1) : g;
+      auto it = where[p]
+                    .insert({key, Key_ref{{cNone, cNone}, {cNone, cNone}}})
+                    .first;
+      it->second.group[last] = g;
+      it->second.index[last] = i;
+    }
   }
-  std::string line;
-  // Get the sequence
-  getline(infile, line);
-  if (line.empty()) {
-    std::cerr << "No Input: Empty File: " << std::endl;
-    return ReturnStatus::ERR_INVALID_INPUT;
+  std::vector<int> lengths;
+  for (int p = 0; p <= cMax_key_size; ++p) {
+    if (!where[p].empty()) {
+      lengths.push_back(p);
+    }
   }
-  if (line[0] != '>') {
-    std::cerr << "Invalid Input: Not a proper MAW format: Expected '>' "
-              << std::endl;
-    return ReturnStatus::ERR_INVALID_INPUT;
+
+  KEY_TYPE window = 0; // last bits read (the latest the least significant)
+  const UINT_64 n = seq.size();
+  std::size_t next_doc = 0;
+  UINT_64 start = 0; // of the current document
+  for (UINT_64 j = 0; j < n; ++j) {
+    if (next_doc < doc_start.size() && doc_start[next_doc] == j) {
+      start = j;
+      window = 0;
+      ++next_doc;
+    }
+    const bool bit = seq[j];
+    for (auto p : lengths) {
+      if (static_cast<UINT_64>(p) > j - start) {
+        break;
+      }
+      auto it = where[p].find(window & key_mask(p));
+      if (it != where[p].end() && it->second.index[bit] != cNone) {
+        occurring[it->second.group[bit]][it->second.index[bit]] = true;
+      }
+    }
+    window = (window << 1) | static_cast<KEY_TYPE>(bit);
   }
-  std::string seq_value = "";
-  while (std::getline(infile, line)) {
-    if (line.empty()) {
-      break; // end of this sequece
+  return occurring;
+}
+
+ReturnStatus
+Anti_dictionary::add_maws(const SEQUENCE &seq,
+                          const std::vector<UINT_64> &doc_start,
+                          const AdOptions &options, const SEQUENCE &old_seq,
+                          const std::vector<UINT_64> &old_doc_start,
+                          const std::vector<std::vector<KEY_TYPE>> &removed,
+                          std::vector<std::vector<KEY_TYPE>> &keys) const {
+  Maw_engine engine;
+  auto status = engine.build(seq, doc_start, options);
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
+  /* Candidates: maws of positive gain (of the lengths of the keys), in the
+   * group they would be in */
+  struct Candidate {
+    std::size_t group;
+    KEY_TYPE key;
+    UINT_64 freq; //< number of occs of the longest proper prefix
+  };
+  std::vector<Candidate> candidates;
+  const int min_len = _is_multi_length ? 2 : _key_size + 1;
+  const int max_len = _is_multi_length ? cMax_key_size : _key_size + 1;
+  engine.for_each_maw(min_len, max_len, [&](const KEY_TYPE key,
+                                            const int key_len,
+                                            const bool last,
+                                            const UINT_64 freq) {
+    if (freq <= 1) { // saves no more bits than it takes
+      return;
+    }
+    if (_is_multi_length) {
+      candidates.push_back(Candidate{static_cast<std::size_t>(key_len + 1),
+                                     (key << 1) | last, freq});
+    } else {
+      candidates.push_back(Candidate{static_cast<std::size_t>(last), key,
+                                     freq});
     }
-    seq_value += line;
+  });
+  engine.clear();
+  // the order is total (maws are distinct) hence the same for any threads
+  auto by_key = [](const Candidate &a, const Candidate &b) {
+    return (a.key != b.key) ? a.key < b.key : a.group < b.group;
+  };
+  std::sort(candidates.begin(), candidates.end(), by_key);
+  if (!_is_multi_length) {
+    // A key which is the prefix of both maws (thus never followed) is left
+    // out, as when the anti-dictionary is created (@see load_chosen_maws)
+    std::size_t num_single = 0;
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+      if (i + 1 < candidates.size() &&
+          candidates[i].key == candidates[i + 1].key) {
+        ++i;
+      } else {
+        candidates[num_single++] = candidates[i];
+      }
+    }
+    candidates.resize(num_single);
+  }
 
-  }                                      // sequence ends
-  sdsl::construct_im(csa, seq_value, 1); // 1 for alphabet type
+  /* Only the maws absent from the earlier documents: those not occurring
+   * there if they are given, else those having a maw removed (absent from
+   * them) as a factor */
+  const bool has_old_seq = !old_seq.empty();
+  if (has_old_seq) {
+    std::vector<std::vector<KEY_TYPE>> grouped(keys.size());
+    for (const auto &c : candidates) { // ascending in each group
+      grouped[c.group].push_back(c.key);
+    }
+    const auto occurring = find_occurring(grouped, old_seq, old_doc_start);
+    std::vector<std::size_t> next(keys.size(), 0);
+    std::size_t num_absent = 0;
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+      const std::size_t g = candidates[i].group;
+      if (!occurring[g][next[g]++]) {
+        candidates[num_absent++] = candidates[i];
+      }
+    }
+    candidates.resize(num_absent);
+  }
+  // maws removed of each length (multi-length: a single-length maw has no
+  // proper factor of the length of the keys)
+  std::vector<std::pair<int, std::unordered_set<KEY_TYPE>>> removed_maws;
+  if (_is_multi_length) {
+    for (std::size_t g = 0; g < removed.size(); ++g) {
+      if (!removed[g].empty()) {
+        removed_maws.emplace_back(
+            static_cast<int>(g),
+            std::unordered_set<KEY_TYPE>(removed[g].begin(),
+                                         removed[g].end()));
+      }
+    }
+  }
+  auto has_removed_factor = [&](const Candidate &c) {
+    const int len = static_cast<int>(c.group);
+    for (const auto &r : removed_maws) {
+      for (int shift = 0; r.first < len && shift <= len - r.first; ++shift) {
+        if (r.second.count((c.key >> shift) & key_mask(r.first)) != 0) {
+          return true;
+        }
+      }
+    }
+    return false;
+  };
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate &a, const Candidate &b) {
+              if (a.freq != b.freq) {
+                return a.freq > b.freq;
+              }
+              return (a.group != b.group) ? a.group < b.group : a.key < b.key;
+            });
+
+  /* Highest gain first while the budgets allow */
+  UINT_64 num_keys = 0;
+  // states of the automaton: distinct proper prefixes, encoded with a leading
+  // 1 bit (root is the empty prefix) (@see select_maws)
+  std::unordered_set<KEY_TYPE> prefixes;
+  const bool has_state_limit = _is_multi_length && options.max_states != 0;
+  auto prefix = [](const std::size_t len, const KEY_TYPE maw, const int p) {
+    return (static_cast<KEY_TYPE>(1) << p) | (maw >> (len - p));
+  };
+  prefixes.insert(1);
+  for (std::size_t g = 0; g < keys.size(); ++g) {
+    num_keys += keys[g].size();
+    for (auto k : keys[g]) {
+      for (int p = 1; has_state_limit && p < static_cast<int>(g); ++p) {
+        prefixes.insert(prefix(g, k, p));
+      }
+    }
+  }
+  std::vector<std::vector<KEY_TYPE>> added(keys.size());
+  for (auto &c : candidates) {
+    if (options.max_keys != 0 && num_keys >= options.max_keys) {
+      break;
+    }
+    auto is_kept = [&](const std::size_t g) {
+      return std::binary_search(keys[g].begin(), keys[g].end(), c.key);
+    };
+    // kept already; a single-length key is in one group only
+    if (is_kept(c.group) || (!_is_multi_length && is_kept(1 - c.group))) {
+      continue;
+    }
+    if (!has_old_seq && !has_removed_factor(c)) {
+      continue; // may occur in the earlier documents
+    }
+    if (has_state_limit) {
+      std::vector<KEY_TYPE> new_prefixes;
+      for (int p = 1; p < static_cast<int>(c.group); ++p) {
+        if (prefixes.find(prefix(c.group, c.key, p)) == prefixes.end()) {
+          new_prefixes.push_back(prefix(c.group, c.key, p));
+        }
+      }
+      if (prefixes.size() + new_prefixes.size() > options.max_states) {
+        continue;
+      }
+      prefixes.insert(new_prefixes.begin(), new_prefixes.end());
+    }
+    added[c.group].push_back(c.key);
+    ++num_keys;
+  }
+
+  UINT_64 num_added = 0;
+  for (std::size_t g = 0; g < keys.size(); ++g) {
+    num_added += added[g].size();
+    keys[g].insert(keys[g].end(), added[g].begin(), added[g].end());
+    std::sort(keys[g].begin(), keys[g].end());
+  }
+  std::cout << "Update: added " << num_added
+            << " maws of the new sequences (absent from the earlier ones)"
+            << std::endl;
+  if (!has_old_seq && !_is_multi_length) {
+    std::cout << "Update: the earlier sequences (--old-input) are needed to "
+                 "add maws to a single-length anti-dictionary"
+              << std::endl;
+  }
+  return ReturnStatus::SUCCESS;
 }
+
 } // end namespace
@@ -0,0 +1,97 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/** Implements class Bit_sequence
+ */
+#include "../include/Bit_sequence.hpp"
+
+namespace mawcd {
+
+Bit_sequence::Bit_sequence() : _words(), _size(0) {}
+
+Bit_sequence::Bit_sequence(const std::string &bits) : _words(), _size(0) {
+  reserve(bits.size());
+  for (char c : bits) {
+    push_back(c == '1');
+  }
+}
+
+void Bit_sequence::reserve(const std::uint64_t num_bits) {
+  _words.reserve((num_bits + cWord_size - 1) / cWord_size);
+}
+
+void Bit_sequence::clear() {
+  _words.clear();
+  _size = 0;
+}
+
+void Bit_sequence::resize(const std::uint64_t num_bits) {
+  _words.resize((num_bits + cWord_size - 1) / cWord_size, 0);
+  const int rest = static_cast<int>(num_bits & (cWord_size - 1));
+  if (num_bits < _size && rest != 0) { // keep the unused bits zero
+    _words.back() &= ~static_cast<WORD>(0) << (cWord_size - rest);
+  }
+  _size = num_bits;
+}
+
+void Bit_sequence::shrink_to_fit() { _words.shrink_to_fit(); }
+
+void Bit_sequence::append(const Bit_sequence &other) {
+  reserve(_size + other._size);
+  const std::uint64_t full_words = other._size / cWord_size;
+  if ((_size & (cWord_size - 1)) == 0) { // word-aligned: copy words as is
+    _words.insert(_words.end(), other._words.begin(),
+                  other._words.begin() + full_words);
+    _size += full_words * cWord_size;
+  } else {
+    for (std::uint64_t w = 0; w < full_words; ++w) {
+      append(other._words[w], cWord_size);
+    }
+  }
+  const int rest = static_cast<int>(other._size & (cWord_size - 1));
+  if (rest != 0) {
+    append(other._words[full_words] >> (cWord_size - rest), rest);
+  }
+}
+
+Bit_sequence Bit_sequence::slice(const std::uint64_t pos,
+                                 const std::uint64_t len) const {
+  Bit_sequence sub;
+  sub.reserve(len);
+  std::uint64_t i = pos;
+  const std::uint64_t end = pos + len;
+  for (; i + cWord_size <= end; i += cWord_size) {
+    sub.append(get_bits(i, cWord_size), cWord_size);
+  }
+  sub.append(get_bits(i, static_cast<int>(end - i)),
+             static_cast<int>(end - i));
+  return sub;
+}
+
+std::string Bit_sequence::to_string() const {
+  std::string str;
+  str.reserve(_size);
+  for (std::uint64_t i = 0; i < _size; ++i) {
+    str.push_back(get(i) ? '1' : '0');
+  }
+  return str;
+}
+
+bool Bit_sequence::operator==(const Bit_sequence &other) const {
+  return _size == other._size && _words == other._words;
+}
+
+} // end namespace
@@ -16,11 +16,106 @@ Pissis
 
 /** Implements class Codec
  */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <omp.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
 #include "../include/Codec.hpp"
 
 namespace mawcd {
-Codec::Codec(const Anti_dictionary &ad)
-    : _cAd(ad), _cSuff_len(ad.get_key_size()) {}
+/* Compressed file format (@see compress_file) */
+/** Header of the file */
+struct Com_header {
+  char magic[8];
+  UINT_32 version;
+  UINT_32 ad_id; //< @see Anti_dictionary::get_id
+  UINT_64 orig_seq_size;
+};
+static_assert(sizeof(Com_header) == 24, "Header must be of 24 bytes");
+/** Header of a block */
+struct Com_block_header {
+  UINT_64 num_bits;
+  UINT_64 context;
+  UINT_64 num_bytes;
+};
+static_assert(sizeof(Com_block_header) == 24,
+              "Header of a block must be of 24 bytes");
+static const char cCom_magic[8] = "MAWCDCF";
+static const UINT_32 cCom_version = 2;
+static const UINT_32 cCom_version_single = 1; //< a single block, no header
+/** Number of blocks decompressed together (@see Codec::decompress_blocks) */
+static const std::size_t cNum_streams = 8;
+/** Least number of blocks whose lookups overlap enough to be decompressed
+ * together; fewer are decompressed one after the other */
+static const std::size_t cMin_streams = 2;
+
+/** Encodes the string in slices of (about) the given number of characters, in
+ * parallel, each one straight into its place in seq (which is replaced): the
+ * encoded characters of the slices are counted first, and the slices are cut
+ * where the bits encoded before them fill whole words, so that no two slices
+ * write the same word */
+static ReturnStatus encode_slices(const Parser &parser, const std::string &str,
+                                  const UINT_64 slice_size,
+                                  const int num_threads, SEQUENCE &seq) {
+  const int w = parser.get_code_len();
+  const INT_64 num_slices =
+      static_cast<INT_64>((str.size() + slice_size - 1) / slice_size);
+  std::vector<UINT_64> counts(num_slices);
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+  for (INT_64 i = 0; i < num_slices; ++i) {
+    const UINT_64 start = i * slice_size;
+    counts[i] = parser.count_codes(str.data() + start,
+                                   std::min(slice_size, str.size() - start));
+  }
+  // the codes before a cut fill whole words if they are a multiple of step
+  const UINT_64 step = SEQUENCE::cWord_size / (w & -w);
+  std::vector<UINT_64> starts(num_slices + 1, str.size());
+  std::vector<UINT_64> codes_before(num_slices, 0);
+  starts[0] = 0;
+  UINT_64 num_codes = 0; // before the uncut start of the slice
+  for (INT_64 i = 1; i < num_slices; ++i) {
+    num_codes += counts[i - 1];
+    UINT_64 start = i * slice_size;
+    UINT_64 before = num_codes;
+    if (start < starts[i - 1]) { // the previous cut went past this start
+      start = starts[i - 1];
+      before = codes_before[i - 1];
+    }
+    while (before % step != 0 && start < str.size()) {
+      before += parser.count_codes(str.data() + start, 1);
+      ++start;
+    }
+    starts[i] = start;
+    codes_before[i] = before;
+  }
+  if (num_slices > 0) {
+    num_codes += counts.back();
+  }
+  seq.clear();
+  seq.resize(num_codes * w);
+  std::vector<ReturnStatus> results(num_slices, ReturnStatus::SUCCESS);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+  for (INT_64 i = 0; i < num_slices; ++i) {
+    Bit_writer writer(seq, codes_before[i] * w);
+    results[i] = parser.encode_in_place(str.data() + starts[i],
+                                        starts[i + 1] - starts[i], writer);
+  }
+  for (const ReturnStatus result : results) {
+    if (result != ReturnStatus::SUCCESS) {
+      return result;
+    }
+  }
+  return ReturnStatus::SUCCESS;
+}
+
+Codec::Codec(const Anti_dictionary &ad, const ComOptions &options)
+    : _cAd(ad), _cSuff_len(ad.get_key_size()), _cOptions(options),
+      _cNum_threads((options.num_threads > 0) ? options.num_threads
+                                               : omp_get_max_threads()) {}
 
 ReturnStatus Codec::compress_file(const Parser &parser,
                                   const std::string &in_filename) const {
@@ -38,11 +133,16 @@ ReturnStatus Codec::compress_file(const Parser &parser,
     std::cerr << "Cannot open output file " << out_filename << " \n";
     return ReturnStatus::ERR_FILE_OPEN;
   }
+  const UINT_64 block_size = std::max(_cOptions.block_size, cMin_block_size);
   UINT_64 orig_seq_size = 0;
-  /* Write length of the original sequence */
-  // First 4 bytes represent the length of the original sequence
-  // Write dummy to rewrite the correct value at the end
-  outfile.write((char *)(&orig_seq_size), sizeof(orig_seq_size));
+  /* Write the header */
+  Com_header header{};
+  std::memcpy(header.magic, cCom_magic, sizeof(cCom_magic));
+  header.version = cCom_version;
+  header.ad_id = _cAd.get_id();
+  // Length of the original sequence: dummy to rewrite the correct value at
+  // the end
+  outfile.write((char *)(&header), sizeof(header));
 
   /* Preapare to read fil in chunks */
   // find file size
@@ -63,8 +163,6 @@ ReturnStatus Codec::compress_file(const Parser &parser,
   // Flag to indicate whether the first chunk
   bool is_initial = true;  // First chunk is initials
   KEY_TYPE pvs_suffix = 0; // suffix from previous chunk (initially 0)
-  // Part of packed representation remained hanging from the previous chunk
-  std::string pvs_hanging = ""; // initially empty
 
   /* Start reading file in chunks */
   for (std::size_t chunk = 0; chunk < totalChunks; ++chunk) {
@@ -81,54 +179,52 @@ ReturnStatus Codec::compress_file(const Parser &parser,
 #ifdef VERBOSE
     std::cout << "BUFFER str: " << buffer << std::endl;
 #endif
-    /* Encode data in buffer */
+    /* Encode data in buffer (in slices of a block) */
     SEQUENCE encoded_sequence;
-    auto result = parser.encode_from_string(buffer, encoded_sequence);
+    auto result = encode_slices(parser, buffer, block_size,
+                                _cNum_threads, encoded_sequence);
     orig_seq_size += encoded_sequence.size();
     if (result != ReturnStatus::SUCCESS) {
       return result;
     }
 #ifdef VERBOSE
-    std::cout << "ENCODED str: " << encoded_sequence << std::endl;
+    std::cout << "ENCODED str: " << encoded_sequence.to_string() << std::endl;
 #endif
-    /* Compress the sequence */
-    SEQUENCE compressed_seq =
-        compress(encoded_sequence, is_initial, pvs_suffix);
+    /* Compress the sequence in blocks */
+    bool is_contradicted = false;
+    const std::vector<Block> blocks = compress_blocks(
+        parser, encoded_sequence, is_initial, pvs_suffix, is_contradicted);
+    if (is_contradicted) {
+      std::cerr << "Invalid Input: File " << in_filename
+                << " has a word which is absent from the anti-dictionary "
+                   "(not created for it)"
+                << std::endl;
+      outfile.close();
+      std::remove(out_filename.c_str());
+      return ReturnStatus::ERR_INVALID_INPUT;
+    }
     if (is_initial) { // turn the flag off for the other chunks than the first
       is_initial = false;
     }
-#ifdef VERBOSE
-    std::cout << "COMPRESSED str: " << compressed_seq << std::endl;
-#endif
-    /* Pack the sequence */
-    PACKED_SEQUENCE packed;
-    parser.pack_sequence(compressed_seq, pvs_hanging, packed);
-#ifdef VERBOSE
-    std::cout << "PACKED size: " << packed.size() << "\n ";
-
-    for (auto p : packed) {
-      std::cout << "PACKED str: "
-                << " " << std::hex << (int)p << " ";
-    }
-    std::cout << "\n pvs_hanging: " << pvs_hanging << std::endl;
-#endif
     /* Write to output */
-    outfile.write((char *)packed.data(),
-                  packed.size()); // leave out last hanging bits
-  }
-
-  /* Write the hanging bits from the last chunk (if any) */
-  if (!pvs_hanging.empty()) { // pad hanging bits with zeroes
-    /* Pack the sequence */
-    PACKED_SEQUENCE packed;
-    parser.pack_sequence("", pvs_hanging, packed);
-    outfile.write((char *)packed.data(), packed.size());
+    for (const Block &block : blocks) {
+      const Com_block_header block_header{block.num_bits, block.context,
+                                          block.packed.size()};
+      outfile.write((char *)(&block_header), sizeof(block_header));
+      outfile.write((char *)block.packed.data(), block.packed.size());
+    }
   }
 
-  // First 4 bytes represent the length of the original sequence
-  // ReWrite dummy written in the beginning with the correct value
+  // ReWrite the header written in the beginning with the correct length
+  header.orig_seq_size = orig_seq_size;
   outfile.seekp(std::ios::beg);
-  outfile.write((char *)(&orig_seq_size), sizeof(orig_seq_size));
+  outfile.write((char *)(&header), sizeof(header));
+  outfile.close();
+  if (!outfile) {
+    std::cerr << "Cannot write output file " << out_filename << " \n";
+    std::remove(out_filename.c_str());
+    return ReturnStatus::ERR_FILE_OPEN;
+  }
 
   std::cout << "File compressed successfully: " << in_filename << std::endl;
   return ReturnStatus::SUCCESS;
@@ -145,25 +241,125 @@ ReturnStatus Codec::decompress_file(const Parser &parser,
   }
   /* Open output file (with extension .decom) */
   std::string out_filename(in_filename + cExt_decom);
-  std::ofstream outfile(out_filename);
-  if (!infile.is_open()) {
+  std::ofstream outfile(out_filename, std::ios::binary);
+  if (!outfile.is_open()) {
     std::cerr << "Cannot open output file " << out_filename << " \n";
     return ReturnStatus::ERR_FILE_OPEN;
   }
-  /* Read length of the original sequence */
-  UINT_64 orig_seq_size = 0;
-  // First 4 bytes represent the length of the original sequence
-  infile.read((char *)(&orig_seq_size), sizeof(orig_seq_size));
+  /* Read the header */
+  // find file size
+  struct stat filestatus;
+  stat(in_filename.c_str(), &filestatus);
+  const std::size_t file_size = filestatus.st_size;
+  Com_header header{};
+  std::size_t header_size = sizeof(header);
+  infile.read((char *)(&header), sizeof(header.magic));
+  if (std::memcmp(header.magic, cCom_magic, sizeof(cCom_magic)) == 0) {
+    infile.read((char *)(&header) + sizeof(header.magic),
+                sizeof(header) - sizeof(header.magic));
+  } else { // written by the earlier releases: only the length
+    std::memcpy(&header.orig_seq_size, header.magic,
+                sizeof(header.orig_seq_size));
+    header_size = sizeof(header.orig_seq_size);
+    header.version = cCom_version_single;
+  }
+  auto invalid = [&](const std::string &reason) {
+    std::cerr << "Invalid Input: Compressed File " << reason << std::endl;
+    outfile.close();
+    std::remove(out_filename.c_str());
+    return ReturnStatus::ERR_INVALID_INPUT;
+  };
+  // the stream state after the last write (once flushed by closing)
+  auto written = [&]() {
+    outfile.close();
+    if (!outfile) {
+      std::cerr << "Cannot write output file " << out_filename << " \n";
+      std::remove(out_filename.c_str());
+      return ReturnStatus::ERR_FILE_OPEN;
+    }
+    std::cout << "File decompressed successfully: " << in_filename
+              << std::endl;
+    return ReturnStatus::SUCCESS;
+  };
+  if (!infile || file_size < header_size) {
+    return invalid("is truncated");
+  }
+  if (header.version != cCom_version &&
+      header.version != cCom_version_single) {
+    return invalid("has unknown version: " + std::to_string(header.version));
+  }
+  if (header.ad_id != 0 && header.ad_id != _cAd.get_id()) {
+    return invalid("was compressed with another anti-dictionary (id " +
+                   std::to_string(header.ad_id) + "; this one has id " +
+                   std::to_string(_cAd.get_id()) + ")");
+  }
+  /* Length of the original sequence */
+  UINT_64 orig_seq_size = header.orig_seq_size;
 #ifdef VERBOSE
   std::cout << "Len of original string: " << orig_seq_size << std::endl;
 #endif
+  // Part of encoded representation of a character remained hanging from the
+  // previous chunk (or block)
+  UINT_64 pvs_remaining = 0; // initially empty
+  int num_remaining = 0;
+
+  if (header.version == cCom_version) {
+    /* Read the blocks, a few at a time */
+    const UINT_64 max_context = _cAd.is_multi_length()
+                                    ? _cAd.get_automaton().num_states() - 1
+                                    : key_mask(_cSuff_len);
+    std::size_t offset = header_size;
+    bool is_initial = true; // First block is initial
+    while (orig_seq_size > 0) {
+      std::vector<Block> blocks;
+      while (blocks.size() < cNum_streams && orig_seq_size > 0) {
+        Com_block_header block_header{};
+        infile.read((char *)(&block_header), sizeof(block_header));
+        offset += sizeof(block_header);
+        if (!infile || file_size < offset ||
+            block_header.num_bytes > file_size - offset) {
+          return invalid("is truncated");
+        }
+        if (block_header.num_bits == 0 ||
+            block_header.num_bits > orig_seq_size ||
+            block_header.context > max_context) {
+          return invalid("has a corrupt block");
+        }
+        Block block;
+        block.num_bits = block_header.num_bits;
+        block.context = block_header.context;
+        block.is_initial = is_initial;
+        block.packed.resize(block_header.num_bytes);
+        infile.read((char *)block.packed.data(), block_header.num_bytes);
+        offset += block_header.num_bytes;
+        orig_seq_size -= block.num_bits;
+        is_initial = false;
+        blocks.push_back(std::move(block));
+      }
+
+      /* Decompress the blocks together */
+      const std::vector<SEQUENCE> decompressed_seqs = decompress_blocks(blocks);
+      for (std::size_t i = 0; i < blocks.size(); ++i) {
+        if (decompressed_seqs[i].size() != blocks[i].num_bits) {
+          return invalid("is truncated");
+        }
+        /* Decode the decompressed sequence */
+        std::string decoded_str;
+        auto result = parser.decode_to_string(
+            decompressed_seqs[i], pvs_remaining, num_remaining, decoded_str);
+        if (result != ReturnStatus::SUCCESS) {
+          return result;
+        }
+        /* Save in the file (except possibly the last character) */
+        outfile.write(decoded_str.data(), decoded_str.size());
+      }
+    }
+    return written();
+  }
 
   /* Preapare to read file in chunks */
-  // find file size
-  struct stat filestatus;
-  stat(in_filename.c_str(), &filestatus);
-  // FExclude the first bytes represent length of the original size
-  std::size_t totalSize = filestatus.st_size - sizeof(orig_seq_size);
+  // Exclude the header
+  std::size_t totalSize = file_size - header_size;
   constexpr std::size_t bufferSize = 1024 * 1024 * 1024; // Read in chunks of
   // 1MB
   std::size_t totalChunks = totalSize / bufferSize;
@@ -177,9 +373,6 @@ ReturnStatus Codec::decompress_file(const Parser &parser,
   // Flag to indicate whether the first chunk
   bool is_initial = true;  // First chunk is initials
   KEY_TYPE pvs_suffix = 0; // suffix from previous chunk (initially 0)
-  // Part of encoded representation of a character remained hanging from the
-  // previous chunk
-  std::string pvs_remaining = ""; // initially empty
 
   for (std::size_t chunk = 0; chunk < totalChunks; ++chunk) {
     std::size_t this_chunk_size = bufferSize;
@@ -202,75 +395,257 @@ ReturnStatus Codec::decompress_file(const Parser &parser,
       is_initial = false;
     }
 #ifdef VERBOSE
-    std::cout << "DECOMPRESSED str: " << decompressed_seq << std::endl;
+    std::cout << "DECOMPRESSED str: " << decompressed_seq.to_string()
+              << std::endl;
 #endif
     /* Decode the decompressed sequence */
     std::string decoded_str;
-    parser.decode_to_string(decompressed_seq, pvs_remaining, decoded_str);
+    auto result = parser.decode_to_string(decompressed_seq, pvs_remaining,
+                                          num_remaining, decoded_str);
+    if (result != ReturnStatus::SUCCESS) {
+      return result;
+    }
 #ifdef VERBOSE
     std::cout << "DECODED str: " << decoded_str << std::endl;
 #endif
     /* Save in the file (except possibly the last character) */
     outfile.write(decoded_str.data(), decoded_str.size());
   }
+  return written();
+}
 
-  std::cout << "File decompressed successfully: " << in_filename << std::endl;
-  return ReturnStatus::SUCCESS;
+/* Steps through an anti-dictionary
+ * The record of the context of a bit (the key or the state before it) gives
+ * the entry inferring the bit; the context of the next bit follows from it
+ * and the bit. The kernels below are compiled for each kind of STEPS.
+ */
+
+/** STEPS of a single-length anti-dictionary through its LOOKUP structure:
+ * the record of a key is its entry */
+template <class LOOKUP> struct Key_steps {
+  using CONTEXT = KEY_TYPE;
+  const LOOKUP &lookup;
+  const KEY_TYPE mask;
+  UINT_64 record(const KEY_TYPE key) const { return lookup.lookup(key); }
+  static UINT_8 entry(const UINT_64 rec) { return static_cast<UINT_8>(rec); }
+  KEY_TYPE next(const KEY_TYPE key, const UINT_64, const UINT_64 bit) const {
+    return ((key << 1) | bit) & mask;
+  }
+};
+
+/** STEPS of a multi-length anti-dictionary through its automaton: the
+ * record of a state holds its transitions */
+struct Automaton_steps {
+  using CONTEXT = Ad_automaton::STATE;
+  const Ad_automaton &aut;
+  UINT_64 record(const CONTEXT state) const { return aut.record(state); }
+  static UINT_8 entry(const UINT_64 rec) { return Ad_automaton::entry(rec); }
+  CONTEXT next(const CONTEXT, const UINT_64 rec, const UINT_64 bit) const {
+    return Ad_automaton::next(rec, bit);
+  }
+};
+
+/* Compression kernel
+ * The bits of the sequence are read a word at a time, the context being kept
+ * in a register. The bits that are not inferred are gathered in a word which
+ * is appended to the compressed sequence once full; they are counted without
+ * branching as the entries are as good as random.
+ */
+
+/** Appends the bits of seq from start on that are not inferred (from context
+ * on; the last one is returned in it) to compressed_seq; sets
+ * is_contradicted if a bit inferred is not the one of seq. */
+template <class STEPS>
+static void compress_bits(const SEQUENCE &seq, const UINT_64 start,
+                          const STEPS &steps,
+                          typename STEPS::CONTEXT &context,
+                          SEQUENCE &compressed_seq, bool &is_contradicted) {
+  const auto &words = seq.words();
+  const UINT_64 n = seq.size();
+  UINT_64 literals = 0; // bits not inferred (last one lowest) to be appended
+  int num_literals = 0;
+  UINT_64 contradicted = 0;
+  for (UINT_64 i = start; i < n;) {
+    // rest of the word of bit i (most significant first)
+    const int offset = static_cast<int>(i & (SEQUENCE::cWord_size - 1));
+    const int len = static_cast<int>(std::min<UINT_64>(
+        SEQUENCE::cWord_size - offset, n - i));
+    UINT_64 word = words[i / SEQUENCE::cWord_size] << offset;
+    for (int j = 0; j < len; ++j) {
+      const UINT_64 bit = word >> (SEQUENCE::cWord_size - 1);
+      word <<= 1;
+      const UINT_64 rec = steps.record(context);
+      const UINT_8 entry = STEPS::entry(rec);
+      context = steps.next(context, rec, bit);
+      // forced (cAd_force_0 or cAd_force_1) but not to this bit
+      contradicted |= (entry >> 1) & (entry ^ bit);
+      const int is_literal = (entry == cAd_absent);
+      literals = (literals << is_literal) | (bit & is_literal);
+      num_literals += is_literal;
+      if (num_literals == SEQUENCE::cWord_size) {
+        compressed_seq.append(literals, SEQUENCE::cWord_size);
+        num_literals = 0;
+      }
+    }
+    i += len;
+  }
+  compressed_seq.append(literals, num_literals);
+  if (contradicted & 1) {
+    is_contradicted = true;
+  }
+}
+
+/* Compression kernel of the keys looked up in Ad_bitmap or Ad_hash_table
+ * The key before a bit depends only on the bits of the sequence, not on what
+ * was inferred; thus the keys of a batch (a word) of bits are computed first
+ * and their lookups started (prefetched), then those of the previous batch
+ * are looked up, each independently of the others, so that the cache misses
+ * of the lookups overlap instead of being waited for one after the other.
+ * The bits not inferred are gathered as in compress_bits; with BMI2 they are
+ * instead extracted together (pext) from the batch by the word of the bits
+ * forced.
+ */
+
+/** Size of the lookup structure from which the lookups are batched: below it,
+ * the structure stays in the (L2) cache and the lookups are faster one by
+ * one */
+static const UINT_64 cBatch_min_bytes = 1 << 20;
+
+/** Bits of a batch (most significant first) and the keys before them */
+struct Key_batch {
+  UINT_64 bits;
+  int len;
+  KEY_TYPE keys[SEQUENCE::cWord_size];
+};
+
+/** Collects the bits of seq from i to the end of its word (or of seq) in
+ * batch with their keys, starting their lookups; moves i and suffix past
+ * them. */
+template <class LOOKUP>
+static void load_batch(const SEQUENCE &seq, UINT_64 &i, const LOOKUP &lookup,
+                       const KEY_TYPE mask, KEY_TYPE &suffix,
+                       Key_batch &batch) {
+  const int offset = static_cast<int>(i & (SEQUENCE::cWord_size - 1));
+  batch.len = static_cast<int>(
+      std::min<UINT_64>(SEQUENCE::cWord_size - offset, seq.size() - i));
+  batch.bits = seq.words()[i / SEQUENCE::cWord_size] << offset;
+  UINT_64 word = batch.bits;
+  for (int j = 0; j < batch.len; ++j) {
+    lookup.prefetch(suffix);
+    batch.keys[j] = suffix;
+    suffix = ((suffix << 1) | (word >> (SEQUENCE::cWord_size - 1))) & mask;
+    word <<= 1;
+  }
+  i += batch.len;
+}
+
+/** Appends the bits of seq from start on that are not inferred from their
+ * keys (from suffix on; the last one is returned in it) to compressed_seq;
+ * sets is_contradicted if a bit inferred is not the one of seq. */
+template <class LOOKUP>
+static void compress_keys(const SEQUENCE &seq, const UINT_64 start,
+                          const LOOKUP &lookup, const KEY_TYPE mask,
+                          KEY_TYPE &suffix, SEQUENCE &compressed_seq,
+                          bool &is_contradicted) {
+  Key_batch batches[2];
+  int curr = 0;
+  UINT_64 i = start;
+  if (i < seq.size()) {
+    load_batch(seq, i, lookup, mask, suffix, batches[curr]);
+  }
+  UINT_64 contradicted = 0;
+  for (bool has_batch = start < seq.size(); has_batch; curr ^= 1) {
+    has_batch = i < seq.size();
+    if (has_batch) { // next batch
+      load_batch(seq, i, lookup, mask, suffix, batches[curr ^ 1]);
+    }
+    const Key_batch &batch = batches[curr];
+#ifdef __BMI2__
+    UINT_64 forced = 0; // bits inferred (set)
+#else
+    UINT_64 literals = 0; // bits not inferred (last one lowest)
+    int num_literals = 0;
+#endif
+    for (int j = 0; j < batch.len; ++j) {
+      const UINT_64 entry = lookup.lookup(batch.keys[j]);
+      const int pos = SEQUENCE::cWord_size - 1 - j;
+      const UINT_64 bit = (batch.bits >> pos) & 1;
+      // forced (cAd_force_0 or cAd_force_1) but not to this bit
+      contradicted |= (entry >> 1) & (entry ^ bit);
+#ifdef __BMI2__
+      forced |= (entry >> 1) << pos;
+#else
+      const int is_literal = (entry == cAd_absent);
+      literals = (literals << is_literal) | (bit & is_literal);
+      num_literals += is_literal;
+#endif
+    }
+#ifdef __BMI2__ // extract the bits not inferred together
+    const UINT_64 literal_mask =
+        ~forced &
+        (~static_cast<UINT_64>(0) << (SEQUENCE::cWord_size - batch.len));
+    compressed_seq.append(_pext_u64(batch.bits, literal_mask),
+                          __builtin_popcountll(literal_mask));
+#else
+    compressed_seq.append(literals, num_literals);
+#endif
+  }
+  if (contradicted & 1) {
+    is_contradicted = true;
+  }
 }
 
 // pvs_suffix is seq initially
 SEQUENCE Codec::compress(const SEQUENCE &seq, bool is_initial,
-                         KEY_TYPE &pvs_suffix) const {
+                         KEY_TYPE &pvs_suffix, bool &is_contradicted) const {
+  if (_cAd.is_multi_length()) {
+    return compress_automaton(seq, pvs_suffix, is_contradicted);
+  }
 #ifdef VERBOSE
-  std::cout << "Compression starts." << seq << std::endl;
+  std::cout << "Compression starts." << seq.to_string() << std::endl;
 #endif
   auto n = seq.size();
   SEQUENCE compressed_seq;
+  compressed_seq.reserve(n);
   KEY_TYPE suffix = pvs_suffix;
-  KEY_TYPE mask = ~((~1) << (_cSuff_len - 1));
-  int start_ind = 0;
+  const KEY_TYPE mask = key_mask(_cSuff_len);
+  UINT_64 start_ind = 0;
   if (is_initial) {
-    start_ind = _cSuff_len;
-    // handle until the suffix is collected
-    for (auto i = 0; i < _cSuff_len && i < n; ++i) {
-      suffix = suffix << 1;
-      if (seq[i] == '1') {
-        suffix = suffix | 1;
-      }
-      compressed_seq.push_back(seq[i]);
-#ifdef VERBOSE
-      std::cout << "Initial : Added: " << seq[i] << std::endl;
-#endif
+    // copy the bits until the suffix is collected
+    start_ind = std::min<UINT_64>(_cSuff_len, n);
+    const int num_initial = static_cast<int>(start_ind);
+    if (num_initial > 0) {
+      suffix = seq.get_bits(0, num_initial);
+      compressed_seq.append(suffix, num_initial);
     }
   }
 #ifdef VERBOSE
   std::cout << "Suffix collected: " << std::bitset<cMax_key_size>(suffix)
             << std::endl;
 #endif
-  for (auto i = start_ind; i < n; ++i) {
-    char following_char;
-    // test if the current char can be figured out from the ad
-    if (_cAd.find_following_letter(
-            suffix, following_char)) { // found the key => following char
-// Do nothing => compress current symbol
-#ifdef VERBOSE
-      std::cout << "Skipped: \n";
-#endif
-    } else {
-      compressed_seq.push_back(seq[i]);
-#ifdef VERBOSE
-      std::cout << "Rem : Added: " << seq[i] << std::endl;
-#endif
-    }
-    suffix = suffix << 1;
-    if (seq[i] == '1') {
-      suffix = suffix | 1;
-    }
-    suffix = suffix & mask;
-#ifdef VERBOSE
-    std::cout << "New Suffix collected: " << std::bitset<cMax_key_size>(suffix)
-              << std::endl;
-#endif
+  // the loop is compiled for the structure used for lookups; its lookups are
+  // batched only if they miss the cache
+  const Ad_bitmap &bitmap = _cAd.get_bitmap();
+  const Ad_hash_table &hash_table = _cAd.get_hash_table();
+  if (!bitmap.empty() && bitmap.size_in_bytes() >= cBatch_min_bytes) {
+    compress_keys(seq, start_ind, bitmap, mask, suffix, compressed_seq,
+                  is_contradicted);
+  } else if (!bitmap.empty()) {
+    const Key_steps<Ad_bitmap> steps{bitmap, mask};
+    compress_bits(seq, start_ind, steps, suffix, compressed_seq,
+                  is_contradicted);
+  } else if (!hash_table.empty() &&
+             hash_table.size_in_bytes() >= cBatch_min_bytes) {
+    compress_keys(seq, start_ind, hash_table, mask, suffix, compressed_seq,
+                  is_contradicted);
+  } else if (!hash_table.empty()) {
+    const Key_steps<Ad_hash_table> steps{hash_table, mask};
+    compress_bits(seq, start_ind, steps, suffix, compressed_seq,
+                  is_contradicted);
+  } else { // its lookups are bound by computation, not by cache misses
+    const Key_steps<Ad_succinct> steps{_cAd.get_succinct(), mask};
+    compress_bits(seq, start_ind, steps, suffix, compressed_seq,
+                  is_contradicted);
   }
   pvs_suffix = suffix; // save suffix for the next chunk
 #ifdef VERBOSE
@@ -281,121 +656,362 @@ SEQUENCE Codec::compress(const SEQUENCE &seq, bool is_initial,
   return compressed_seq;
 }
 
-SEQUENCE Codec::decompress(const UINT_64 n,
-                           const PACKED_SEQUENCE &comp_packed_seq,
-                           bool is_initial, KEY_TYPE &pvs_suffix) const {
-  SEQUENCE seq;
-  seq.reserve(n);
-  auto comp_packed_seq_len = comp_packed_seq.size();
+/* Decompression kernel
+ * The compressed bits are read from a word refilled 8 bytes at a time. The
+ * bits forced from a context up to the next literal are always the same: a
+ * run of them (up to a word) is found once from the context where it starts
+ * and kept in a small cache (direct-mapped on the context), so that it is
+ * then appended at once with the context at its end instead of bit by bit.
+ * Most runs are of a single bit (but on repetitive sequences), which is
+ * appended before the cache is probed.
+ */
 
-  KEY_TYPE suff_mask = ~((~1) << (_cSuff_len - 1));
-  KEY_TYPE suffix = pvs_suffix;
+/** Reader of the bits of a packed sequence (most significant first) */
+class Bit_reader {
+public:
+  explicit Bit_reader(const PACKED_SEQUENCE &packed)
+      : _bytes(packed.data()), _num_bytes(packed.size()) {}
+  /** Tests if all the bits have been read */
+  bool empty() const { return _num_buffered == 0 && _next == _num_bytes; }
+  /** Reads the next bit (assumes not empty) */
+  UINT_64 get() {
+    if (_num_buffered == 0) {
+      refill();
+    }
+    const UINT_64 bit = _buffer >> (SEQUENCE::cWord_size - 1);
+    _buffer <<= 1;
+    --_num_buffered;
+    return bit;
+  }
+  /** Next bit (0 once all have been read), to be skipped or not */
+  UINT_64 peek() {
+    if (_num_buffered == 0) {
+      refill();
+    }
+    return _buffer >> (SEQUENCE::cWord_size - 1);
+  }
+  /** Skips the bit peeked (num is 1) or not (num is 0) */
+  void skip(const UINT_64 num) {
+    _buffer <<= num;
+    _num_buffered -= static_cast<int>(num);
+  }
+  /** Tests if more bits have been skipped than there were */
+  bool is_overrun() const { return _num_buffered < 0; }
 
-  int curr_byte_ind = 0;
-  UINT_8 curr_byte = comp_packed_seq[curr_byte_ind];
-  int curr_bit_ind = 0;
-  UINT_8 byte_mask = 0x80;
-  int start_ind = 0;
-  bool is_hit_end = false;
-#ifdef VERBOSE
-  std::cout << "BYTE MASK: " << std::bitset<cMax_key_size>(byte_mask)
-            << std::endl;
-#endif
-  if (is_initial) {
-    start_ind = _cSuff_len;
-    // handle until the suffix is collected
-    for (auto i = 0; i < _cSuff_len && i < n; ++i) {
-#ifdef VERBOSE
-      std::cout << "Initial : byte num: bt num: byte: " << curr_byte_ind
-                << " : " << curr_bit_ind << " : "
-                << std::bitset<cMax_key_size>(curr_byte) << std::endl;
-#endif
-      suffix = suffix << 1;
-      if (curr_byte & byte_mask) { // bit is 1
-        seq.push_back('1');
-        suffix = suffix | 1;
-#ifdef VERBOSE
-        std::cout << "Added 1\n";
-#endif
-      } else { // bit is 0
-        seq.push_back('0');
-#ifdef VERBOSE
-        std::cout << "Added 0\n";
-#endif
+private:
+  const UINT_8 *_bytes;
+  UINT_64 _num_bytes;
+  UINT_64 _next = 0;   //< next byte to be buffered
+  UINT_64 _buffer = 0; //< bits buffered (the next one highest)
+  int _num_buffered = 0;
+  void refill() {
+    const UINT_64 num = std::min<UINT_64>(_num_bytes - _next, 8);
+    _buffer = 0;
+    for (UINT_64 i = 0; i < num; ++i) {
+      _buffer |= static_cast<UINT_64>(_bytes[_next + i])
+                 << (SEQUENCE::cWord_size - cByte_Size * (i + 1));
+    }
+    _next += num;
+    _num_buffered = static_cast<int>(num * cByte_Size);
+  }
+};
+
+/** Run of bits forced from a context: bits (last one lowest) and the context
+ * reached (len is 0 if none is cached) */
+template <class CONTEXT> struct Forced_run {
+  CONTEXT start;
+  CONTEXT end;
+  UINT_64 bits;
+  int len = 0;
+};
+
+/** Number of runs cached (a power of 2) */
+static const int cRun_cache_bits = 12;
+
+/** Appends the bits to seq (from context on; the last one is returned in it)
+ * until it has n bits or a literal is needed once reader is empty. */
+template <class STEPS>
+static void decompress_bits(const UINT_64 n, Bit_reader &reader,
+                            const STEPS &steps,
+                            typename STEPS::CONTEXT &context, SEQUENCE &seq) {
+  using CONTEXT = typename STEPS::CONTEXT;
+  std::vector<Forced_run<CONTEXT>> runs(1 << cRun_cache_bits);
+  UINT_64 rec = steps.record(context);
+  while (seq.size() < n) {
+    const UINT_8 entry = STEPS::entry(rec);
+    if (entry == cAd_absent) { // literal
+      if (reader.empty()) {
+        break;
       }
-      curr_byte = curr_byte << 1;
-#ifdef VERBOSE
-      std::cout << "Suffix collected: " << std::bitset<cMax_key_size>(suffix)
-                << std::endl;
-#endif
-      if ((++curr_bit_ind) == cByte_Size) { // this byte done
-        curr_bit_ind = 0;
-        ++curr_byte_ind;
-        if (curr_byte_ind < comp_packed_seq_len) {
-          curr_byte = comp_packed_seq[curr_byte_ind];
-        } else {
-          is_hit_end = true;
-        }
+      const UINT_64 bit = reader.get();
+      seq.push_back(bit);
+      context = steps.next(context, rec, bit);
+      rec = steps.record(context);
+      continue;
+    }
+    // first bit of the run
+    seq.push_back(entry & 1);
+    context = steps.next(context, rec, entry & 1);
+    rec = steps.record(context);
+    if (STEPS::entry(rec) == cAd_absent || seq.size() == n) {
+      continue;
+    }
+    Forced_run<CONTEXT> &run =
+        runs[(static_cast<UINT_64>(context) * 0x9E3779B97F4A7C15ULL) >>
+             (SEQUENCE::cWord_size - cRun_cache_bits)];
+    if (run.len == 0 || run.start != context) { // find the rest of the run
+      run.start = context;
+      run.bits = 0;
+      run.len = 0;
+      CONTEXT c = context;
+      for (UINT_64 r = rec; STEPS::entry(r) != cAd_absent &&
+                            run.len < SEQUENCE::cWord_size;
+           r = steps.record(c)) {
+        const UINT_64 bit = STEPS::entry(r) & 1;
+        run.bits = (run.bits << 1) | bit;
+        c = steps.next(c, r, bit);
+        ++run.len;
+      }
+      run.end = c;
+    }
+    if (static_cast<UINT_64>(run.len) <= n - seq.size()) {
+      seq.append(run.bits, run.len);
+      context = run.end;
+    } else { // only the first bits of the run
+      const int len = static_cast<int>(n - seq.size());
+      const UINT_64 bits = run.bits >> (run.len - len);
+      seq.append(bits, len);
+      for (int j = len - 1; j >= 0; --j) {
+        context = steps.next(context, steps.record(context), (bits >> j) & 1);
       }
     }
+    rec = steps.record(context);
   }
-  bool isCharAdded = true;
-  for (auto i = start_ind; i < n; ++i) {
-    char following_char;
-    // test if the current char can be figured out from the ad
-    if (_cAd.find_following_letter(
-            suffix, following_char)) { // found the key => following char
-      seq.push_back(following_char);
-#ifdef VERBOSE
-      std::cout << "Following: Added " << following_char << std::endl;
-      ;
-#endif
-    } else {            // try to extract character from the com_seq
-      if (is_hit_end) { // if it has already been exhausted
-        isCharAdded = false;
-        break;
-      } else {
-#ifdef VERBOSE
-        std::cout << "Rem : byte num: bt num: byte: " << curr_byte_ind << " : "
-                  << curr_bit_ind << " : " << std::bitset<8>(curr_byte)
-                  << std::endl;
-#endif
-        if (curr_byte & byte_mask) { // bit is 1
-          seq.push_back('1');
-          #ifdef VERBOSE
-          std::cout << "Added 1\n";
-          #endif
-        } else { // bit is 1
-          seq.push_back('0');
-          #ifdef VERBOSE
-          std::cout << "Added 0\n";
-          #endif
-        }
-        curr_byte = curr_byte << 1;
-        if ((++curr_bit_ind) == cByte_Size) { // this byte done
-          curr_bit_ind = 0;
-          ++curr_byte_ind;
-          if (curr_byte_ind < comp_packed_seq_len) {
-            curr_byte = comp_packed_seq[curr_byte_ind];
-          } else {
-            is_hit_end = true;
-          }
-        }
+}
+
+/** Copies the first bits of reader (until the key is collected, at most n of
+ * them) to seq as is; they make the key returned in suffix. */
+static void copy_initial(const int num_initial, const UINT_64 n,
+                         Bit_reader &reader, KEY_TYPE &suffix, SEQUENCE &seq) {
+  for (int i = 0; i < num_initial && seq.size() < n && !reader.empty(); ++i) {
+    const UINT_64 bit = reader.get();
+    seq.push_back(bit);
+    suffix = (suffix << 1) | bit;
+  }
+}
+
+/** State of a block decompressed in lock-step with others: the context of
+ * its next bit (and the record of it), and its bits not yet appended to seq */
+template <class CONTEXT> struct Stream_state {
+  Bit_reader reader;
+  CONTEXT context;
+  UINT_64 rec;
+  UINT_64 bits;
+  SEQUENCE *seq;
+  UINT_64 num_left; //< number of bits left to be decompressed
+};
+
+/** Decompresses the blocks in lock-step (@see Codec::decompress_blocks): a
+ * bit of each block in turn, without branching on the entries so that the
+ * lookups of the blocks overlap. Too few blocks to overlap (less than
+ * cMin_streams) are rather decompressed one after the other (@see
+ * decompress_bits). The bits of the initial block until its key is collected
+ * (num_initial) are copied first. A block whose packed bytes run out is cut
+ * short. */
+template <class STEPS>
+static void decompress_streams(const STEPS &steps, const int num_initial,
+                               const std::vector<Codec::Block> &blocks,
+                               std::vector<SEQUENCE> &seqs) {
+  using CONTEXT = typename STEPS::CONTEXT;
+  if (blocks.size() < cMin_streams) { // one after the other (runs are cached)
+    for (std::size_t i = 0; i < blocks.size(); ++i) {
+      const Codec::Block &block = blocks[i];
+      seqs[i].reserve(block.num_bits);
+      Bit_reader reader(block.packed);
+      KEY_TYPE context = block.context;
+      if (block.is_initial) {
+        copy_initial(num_initial, block.num_bits, reader, context, seqs[i]);
       }
+      auto c = static_cast<CONTEXT>(context);
+      decompress_bits(block.num_bits, reader, steps, c, seqs[i]);
     }
-    if (isCharAdded) { // we added something in the sequence
-      suffix = suffix << 1;
-      if (seq[i] == '1') {
-        suffix = suffix | 1;
+    return;
+  }
+  std::vector<Stream_state<CONTEXT>> streams;
+  streams.reserve(blocks.size());
+  for (std::size_t i = 0; i < blocks.size(); ++i) {
+    const Codec::Block &block = blocks[i];
+    seqs[i].reserve(block.num_bits);
+    Bit_reader reader(block.packed);
+    KEY_TYPE context = block.context;
+    if (block.is_initial) {
+      copy_initial(num_initial, block.num_bits, reader, context, seqs[i]);
+    }
+    const auto c = static_cast<CONTEXT>(context);
+    streams.push_back(Stream_state<CONTEXT>{reader, c, steps.record(c), 0,
+                                            &seqs[i],
+                                            block.num_bits - seqs[i].size()});
+  }
+  while (!streams.empty()) {
+    // a word of bits of each block (as many as the shortest one has left)
+    UINT_64 len = SEQUENCE::cWord_size;
+    for (const auto &stream : streams) {
+      len = std::min(len, stream.num_left);
+    }
+    for (UINT_64 r = 0; r < len; ++r) {
+      for (auto &stream : streams) {
+        const UINT_64 entry = STEPS::entry(stream.rec);
+        const UINT_64 is_literal = (entry >> 1) ^ 1;
+        const UINT_64 bit = (entry & 1) | (stream.reader.peek() & is_literal);
+        stream.reader.skip(is_literal);
+        stream.bits = (stream.bits << 1) | bit;
+        stream.context = steps.next(stream.context, stream.rec, bit);
+        stream.rec = steps.record(stream.context);
+      }
+    }
+    for (auto &stream : streams) {
+      if (stream.reader.is_overrun()) { // its literals ran out
+        stream.num_left = 0;
+        continue;
       }
-      suffix = suffix & suff_mask;
+      stream.seq->append(stream.bits, static_cast<int>(len));
+      stream.num_left -= len;
+    }
+    streams.erase(std::remove_if(streams.begin(), streams.end(),
+                                 [](const Stream_state<CONTEXT> &stream) {
+                                   return stream.num_left == 0;
+                                 }),
+                  streams.end());
+  }
+}
+
+SEQUENCE Codec::decompress(const UINT_64 n,
+                           const PACKED_SEQUENCE &comp_packed_seq,
+                           bool is_initial, KEY_TYPE &pvs_suffix) const {
+  if (_cAd.is_multi_length()) {
+    return decompress_automaton(n, comp_packed_seq, pvs_suffix);
+  }
+  SEQUENCE seq;
+  seq.reserve(n);
+  Bit_reader reader(comp_packed_seq);
+  KEY_TYPE suffix = pvs_suffix;
+  if (is_initial) {
+    // copy the bits until the suffix is collected
+    copy_initial(_cSuff_len, n, reader, suffix, seq);
+  }
 #ifdef VERBOSE
-      std::cout << "Suffix collected: " << std::bitset<cMax_key_size>(suffix)
-                << std::endl;
+  std::cout << "Suffix collected: " << std::bitset<cMax_key_size>(suffix)
+            << std::endl;
 #endif
-    }
+  // the loop is compiled for the structure used for lookups
+  const KEY_TYPE mask = key_mask(_cSuff_len);
+  if (!_cAd.get_bitmap().empty()) {
+    const Key_steps<Ad_bitmap> steps{_cAd.get_bitmap(), mask};
+    decompress_bits(n, reader, steps, suffix, seq);
+  } else if (!_cAd.get_hash_table().empty()) {
+    const Key_steps<Ad_hash_table> steps{_cAd.get_hash_table(), mask};
+    decompress_bits(n, reader, steps, suffix, seq);
+  } else {
+    const Key_steps<Ad_succinct> steps{_cAd.get_succinct(), mask};
+    decompress_bits(n, reader, steps, suffix, seq);
   }
   pvs_suffix = suffix;
   return seq;
 }
+
+std::vector<Codec::Block> Codec::compress_blocks(const Parser &parser,
+                                                 const SEQUENCE &seq,
+                                                 bool is_initial,
+                                                 KEY_TYPE &pvs_suffix,
+                                                 bool &is_contradicted) const {
+  // a block is longer than a key: the key before it is in the one before
+  const UINT_64 block_bits =
+      std::max(_cOptions.block_size, cMin_block_size) * parser.get_code_len();
+  const INT_64 num_blocks =
+      static_cast<INT_64>((seq.size() + block_bits - 1) / block_bits);
+  std::vector<Block> blocks(num_blocks);
+  // flags of the blocks (bytes, as they are set concurrently)
+  std::vector<UINT_8> contradicted(num_blocks, 0);
+  KEY_TYPE last_suffix = pvs_suffix;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(_cNum_threads)
+  for (INT_64 b = 0; b < num_blocks; ++b) {
+    const UINT_64 start = b * block_bits;
+    Block &block = blocks[b];
+    block.num_bits = std::min(block_bits, seq.size() - start);
+    block.is_initial = is_initial && b == 0;
+    KEY_TYPE suffix = pvs_suffix;
+    if (_cAd.is_multi_length()) { // every block starts from the root
+      suffix = Ad_automaton::cRoot;
+    } else if (b > 0) {
+      suffix = seq.get_bits(start - _cSuff_len, _cSuff_len);
+    }
+    block.context = suffix;
+    bool is_block_contradicted = false;
+    const SEQUENCE compressed_seq =
+        compress(seq.slice(start, block.num_bits), block.is_initial, suffix,
+                 is_block_contradicted);
+    contradicted[b] = is_block_contradicted;
+    SEQUENCE hanging;
+    parser.pack_sequence(compressed_seq, hanging, block.packed);
+    if (!hanging.empty()) { // pad hanging bits with zeroes
+      parser.pack_sequence(SEQUENCE(), hanging, block.packed);
+    }
+    if (b == num_blocks - 1) {
+      last_suffix = suffix;
+    }
+  }
+  pvs_suffix = last_suffix; // save suffix for the next chunk
+  if (std::find(contradicted.begin(), contradicted.end(), 1) !=
+      contradicted.end()) {
+    is_contradicted = true;
+  }
+  return blocks;
+}
+
+std::vector<SEQUENCE>
+Codec::decompress_blocks(const std::vector<Block> &blocks) const {
+  std::vector<SEQUENCE> seqs(blocks.size());
+  const KEY_TYPE mask = key_mask(_cSuff_len);
+  if (_cAd.is_multi_length()) {
+    decompress_streams(Automaton_steps{_cAd.get_automaton()}, 0, blocks,
+                       seqs);
+  } else if (!_cAd.get_bitmap().empty()) {
+    decompress_streams(Key_steps<Ad_bitmap>{_cAd.get_bitmap(), mask},
+                       _cSuff_len, blocks, seqs);
+  } else if (!_cAd.get_hash_table().empty()) {
+    decompress_streams(Key_steps<Ad_hash_table>{_cAd.get_hash_table(), mask},
+                       _cSuff_len, blocks, seqs);
+  } else {
+    decompress_streams(Key_steps<Ad_succinct>{_cAd.get_succinct(), mask},
+                       _cSuff_len, blocks, seqs);
+  }
+  return seqs;
+}
+//////////////////////// private ////////////////////////
+SEQUENCE Codec::compress_automaton(const SEQUENCE &seq, KEY_TYPE &pvs_state,
+                                   bool &is_contradicted) const {
+  SEQUENCE compressed_seq;
+  compressed_seq.reserve(seq.size());
+  const Automaton_steps steps{_cAd.get_automaton()};
+  auto state = static_cast<Ad_automaton::STATE>(pvs_state);
+  compress_bits(seq, 0, steps, state, compressed_seq, is_contradicted);
+  pvs_state = state; // save state for the next chunk
+  compressed_seq.shrink_to_fit();
+  return compressed_seq;
+}
+
+SEQUENCE Codec::decompress_automaton(const UINT_64 n,
+                                     const PACKED_SEQUENCE &comp_packed_seq,
+                                     KEY_TYPE &pvs_state) const {
+  SEQUENCE seq;
+  seq.reserve(n);
+  Bit_reader reader(comp_packed_seq);
+  const Automaton_steps steps{_cAd.get_automaton()};
+  auto state = static_cast<Ad_automaton::STATE>(pvs_state);
+  decompress_bits(n, reader, steps, state, seq);
+  pvs_state = state; // save state for the next chunk
+  seq.shrink_to_fit();
+  return seq;
+}
+
 } // end namespace
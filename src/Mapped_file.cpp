@@ -0,0 +1,64 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+/** Implements class Mapped_file
+ */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/Mapped_file.hpp"
+
+namespace mawcd {
+
+Mapped_file::~Mapped_file() { close(); }
+
+ReturnStatus Mapped_file::open(const std::string &filename) {
+  close();
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return ReturnStatus::ERR_FILE_OPEN;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    ::close(fd);
+    return ReturnStatus::ERR_FILE_OPEN;
+  }
+  const UINT_64 size = static_cast<UINT_64>(info.st_size);
+  if (size != 0) {
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      return ReturnStatus::ERR_FILE_OPEN;
+    }
+    _data = static_cast<const char *>(data);
+    _size = size;
+  }
+  ::close(fd); // the mapping stays valid
+  return ReturnStatus::SUCCESS;
+}
+
+void Mapped_file::close() {
+  if (_data != nullptr) {
+    munmap(const_cast<char *>(_data), _size);
+  }
+  _data = nullptr;
+  _size = 0;
+}
+
+} // end namespace
@@ -0,0 +1,1141 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/** Implements class Maw_engine
+ */
+#include <divsufsort.h>
+#include <divsufsort64.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <omp.h>
+#include <parallel/algorithm>
+#include <queue>
+#include <sdsl/io.hpp>
+#include <sdsl/util.hpp>
+
+#include "../include/Maw_engine.hpp"
+
+namespace mawcd {
+
+const int Maw_engine::cSigma;
+const int Maw_engine::cNo_letter;
+const int Maw_engine::cLcp_cap;
+const UINT_64 Maw_engine::cBuffer_size;
+const INT_64 Maw_engine::cWave_rows;
+const UINT_64 Maw_engine::cDefault_sort_memory;
+const UINT_64 Maw_engine::cMin_sort_memory;
+const UINT_64 Maw_engine::cMin_merge_buffer;
+const bool Maw_engine::Memory_index::cIs_shared;
+const bool Maw_engine::Memory_reader::cIs_shared;
+const bool Maw_engine::File_index::cIs_shared;
+
+/* Keys of the files of the index */
+static const char *cKey_seq = "mawcd_seq";
+static const char *cKey_run = "mawcd_run_";
+static const char *cKey_prefix = "mawcd_prefix";
+static const char *cKey_rest = "mawcd_rest";
+static const char *cKey_lcp = "mawcd_lcp";
+static const char *cKey_bwt = "mawcd_bwt";
+static const char *cKey_before[] = {"mawcd_before0", "mawcd_before1"};
+static const char *cKey_before_lcp[] = {"mawcd_before_lcp0",
+                                        "mawcd_before_lcp1"};
+static const char *cKey_seen = "mawcd_seen";
+
+/* Bytes of a record in the files of the runs: its prefix, rest and letter */
+static const std::size_t cRecord_bytes = sizeof(UINT_64) + 2;
+
+/* Writes records (@see Maw_engine::Record) to a file through a buffer */
+template <class RECORD> class Record_writer {
+public:
+  Record_writer(const std::string &filename, const std::size_t buffer_size)
+      : _file(filename, std::ios::binary | std::ios::trunc) {
+    _buffer.reserve(std::max(buffer_size / cRecord_bytes, std::size_t(1)) *
+                    cRecord_bytes);
+  }
+  void push_back(const RECORD &record) {
+    if (_buffer.size() == _buffer.capacity()) {
+      flush();
+    }
+    const std::size_t at = _buffer.size();
+    _buffer.resize(at + cRecord_bytes);
+    std::memcpy(&_buffer[at], &record.prefix, sizeof(UINT_64));
+    _buffer[at + sizeof(UINT_64)] = static_cast<char>(record.rest);
+    _buffer[at + sizeof(UINT_64) + 1] = static_cast<char>(record.before);
+  }
+  /* false if the file could not be written */
+  bool close() {
+    flush();
+    _file.close();
+    return !_file.fail();
+  }
+
+private:
+  void flush() {
+    _file.write(_buffer.data(), _buffer.size());
+    _buffer.clear();
+  }
+  std::ofstream _file;
+  std::vector<char> _buffer;
+};
+
+/* Reads the records of a file written by Record_writer through a buffer */
+template <class RECORD> class Record_reader {
+public:
+  Record_reader(const std::string &filename, const std::size_t buffer_size)
+      : _file(filename, std::ios::binary),
+        _buffer(std::max(buffer_size / cRecord_bytes, std::size_t(1)) *
+                cRecord_bytes) {}
+  /* false at the end of the file (or if it cannot be read) */
+  bool next(RECORD &record) {
+    if (_next == _size) {
+      _file.read(_buffer.data(), _buffer.size());
+      _size = static_cast<std::size_t>(_file.gcount());
+      _next = 0;
+      if (_size < cRecord_bytes) {
+        return false;
+      }
+    }
+    std::memcpy(&record.prefix, &_buffer[_next], sizeof(UINT_64));
+    record.rest = static_cast<UINT_8>(_buffer[_next + sizeof(UINT_64)]);
+    record.before = static_cast<UINT_8>(_buffer[_next + sizeof(UINT_64) + 1]);
+    _next += cRecord_bytes;
+    return true;
+  }
+  bool is_open() const { return _file.is_open(); }
+
+private:
+  std::ifstream _file;
+  std::vector<char> _buffer;
+  std::size_t _size = 0; //< bytes in the buffer
+  std::size_t _next = 0; //< first byte of the next record
+};
+
+/* Merges the records of the files (each sorted) in order, giving each to
+ * 'out'; each file is read through a buffer of buffer_size bytes */
+template <class RECORD, class OUT>
+static bool merge_records(const std::vector<std::string> &files,
+                          const std::size_t buffer_size, OUT &out) {
+  std::vector<Record_reader<RECORD>> readers;
+  readers.reserve(files.size());
+  using Head = std::pair<RECORD, std::size_t>; // a record and its file
+  auto later = [](const Head &a, const Head &b) {
+    return (b.first < a.first) || (!(a.first < b.first) && b.second < a.second);
+  };
+  std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+  for (std::size_t f = 0; f < files.size(); ++f) {
+    readers.emplace_back(files[f], buffer_size);
+    if (!readers.back().is_open()) {
+      std::cerr << "Cannot open file " << files[f] << " \n";
+      return false;
+    }
+    RECORD record;
+    if (readers.back().next(record)) {
+      heads.push(Head(record, f));
+    }
+  }
+  while (!heads.empty()) {
+    Head head = heads.top();
+    heads.pop();
+    out(head.first);
+    if (readers[head.second].next(head.first)) {
+      heads.push(head);
+    }
+  }
+  return true;
+}
+
+Maw_engine::~Maw_engine() { clear(); }
+
+ReturnStatus Maw_engine::build(const SEQUENCE &seq,
+                               const AdOptions &options) {
+  return build(seq, std::vector<UINT_64>(1, 0), options);
+}
+
+ReturnStatus Maw_engine::build(const SEQUENCE &seq,
+                               const std::vector<UINT_64> &doc_start,
+                               const AdOptions &options) {
+  clear();
+  if (options.is_external_memory && !seq.empty()) {
+    /* Copied to a file, a buffer at a time */
+    Sequence_file seq_file;
+    auto status = seq_file.create(sdsl::cache_file_name(
+        cKey_seq, sdsl::cache_config(true, options.scratch_dir)));
+    const UINT_64 chunk = UINT_64(1) << 23;
+    for (UINT_64 pos = 0;
+         status == ReturnStatus::SUCCESS && pos < seq.size(); pos += chunk) {
+      status = seq_file.append(
+          seq.slice(pos, std::min<UINT_64>(chunk, seq.size() - pos)));
+    }
+    if (status != ReturnStatus::SUCCESS) {
+      return status;
+    }
+    return build(seq_file, doc_start, options);
+  }
+  auto status = start_build(seq.size(), doc_start, options, false);
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
+  _seq = &seq;
+  for (std::size_t d = 0; d < _doc_start.size(); ++d) {
+    ++_num_last[(*_seq)[doc_end(_doc_start[d]) - 1]];
+  }
+  if (!compute_sa()) {
+    std::cerr << "Suffix array computation failed \n";
+    return ReturnStatus::ERR_EXTERNAL;
+  }
+  compute_lcp();
+  compute_bwt();
+  compute_before(_index);
+  compute_seen(_index);
+  return ReturnStatus::SUCCESS;
+}
+
+ReturnStatus Maw_engine::build(Sequence_file &seq_file,
+                               const std::vector<UINT_64> &doc_start,
+                               const AdOptions &options) {
+  clear();
+  auto status = start_build(seq_file.size(), doc_start, options, true);
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
+  _is_external_memory = true;
+  _config = sdsl::cache_config(true, options.scratch_dir);
+  /* The runs of the sort take the memory left by the buffers */
+  const UINT_64 buffers =
+      memory_estimate(_size, true, _num_threads) - cMin_sort_memory;
+  const UINT_64 sort_memory = (options.max_memory > 0)
+                                  ? options.max_memory - buffers
+                                  : cDefault_sort_memory;
+  SEQUENCE last;
+  for (std::size_t d = 0; d < _doc_start.size(); ++d) {
+    status = seq_file.read(doc_end(_doc_start[d]) - 1, 1, last);
+    if (status != ReturnStatus::SUCCESS) {
+      return status;
+    }
+    ++_num_last[last[0]];
+  }
+  std::vector<std::string> runs;
+  status = sort_runs(seq_file, sort_memory, runs);
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
+  File_index index(*this, std::ios::out);
+  for (const char *key : {cKey_prefix, cKey_rest, cKey_lcp, cKey_bwt,
+                          cKey_before[0], cKey_before[1], cKey_before_lcp[0],
+                          cKey_before_lcp[1], cKey_seen}) {
+    sdsl::register_cache_file(key, _config); // to be removed by clear()
+  }
+  status = merge_runs(runs, sort_memory, index);
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
+  compute_before(index);
+  compute_seen(index);
+  return ReturnStatus::SUCCESS;
+}
+
+UINT_64 Maw_engine::memory_estimate(const UINT_64 n,
+                                    const bool is_external_memory,
+                                    const int num_threads) {
+  /* for_each_maw(): at most two maws per letter at each row of a wave */
+  const UINT_64 waves = std::min<UINT_64>(n, cWave_rows) * 2 * cSigma *
+                        sizeof(Found_maw);
+  if (is_external_memory) {
+    /* The buffers of the files of the index (of each thread sweeping) and
+     * the runs of the sort */
+    const UINT_64 buffers =
+        num_threads * (4 + 2 * cSigma + 1) * cBuffer_size;
+    return buffers + waves + cMin_sort_memory;
+  }
+  /* Suffix sorting: one byte per letter and the (32 or 64-bit) suffix array */
+  const UINT_64 sa_width = (n < (UINT_64(1) << 31)) ? 4 : 8;
+  const UINT_64 sorting = n + n * sa_width;
+  /* Then: the bit-compressed suffix array, the LCP array (1 byte), the
+   * Before/Beforelcp bit-vectors (8 bits), the seen bit-vector and the BWT
+   * (2 bits) */
+  const UINT_64 sa_bits = sdsl::bits::hi(n) + 1;
+  const UINT_64 index = n * sa_bits / cByte_Size + n + n + n / 8 + n / 4;
+  return std::max(sorting, index + waves);
+}
+
+void Maw_engine::for_each_maw(const int min_len, const int max_len,
+                              const MAW_CALLBACK &report) const {
+  if (_is_external_memory) {
+    for_each_maw_in<File_index>(min_len, max_len, report);
+  } else {
+    for_each_maw_in<Memory_reader>(min_len, max_len, report);
+  }
+}
+
+void Maw_engine::length_histogram(const int max_len,
+                                  std::vector<UINT_64> &num_maws,
+                                  std::vector<UINT_64> &freq) const {
+  if (_is_external_memory) {
+    length_histogram_in<File_index>(max_len, num_maws, freq);
+  } else {
+    length_histogram_in<Memory_reader>(max_len, num_maws, freq);
+  }
+}
+
+template <class INDEX>
+void Maw_engine::for_each_maw_in(const int min_len, const int max_len,
+                                 const MAW_CALLBACK &report) const {
+  const INT_64 n = _size;
+  const INT_64 max_ranges = 4 * static_cast<INT_64>(_num_threads);
+
+  /* What a range of a wave finds: its maws in the order their intervals are
+   * closed; the intervals of its starting stack it closes (with the number
+   * of its maws reported before), whose maws found by the earlier ranges
+   * come first; and the maws of the intervals it leaves open */
+  struct Inherited {
+    std::size_t position;
+    Lcp_interval interval;
+    Letter_counts counts;
+  };
+  struct Range_maws {
+    std::vector<Found_maw> maws;
+    std::vector<Inherited> inherited;
+    std::vector<std::pair<Lcp_interval, std::vector<Found_maw>>> left_open;
+  };
+  // maws waiting for their interval (by first row and LCP value) to be
+  // closed: only those of the stack, thus at most cLcp_cap+1 intervals
+  std::map<std::pair<INT_64, INT_64>, std::vector<Found_maw>> waiting;
+  auto report_waiting = [&](const Lcp_interval &interval,
+                            const Letter_counts &counts) {
+    const auto it = waiting.find(std::make_pair(interval.lb, interval.lcp));
+    if (it != waiting.end()) {
+      for (const auto &m : it->second) {
+        report(m.key, m.key_len, m.last, key_freq(interval, counts, m.first));
+      }
+      waiting.erase(it);
+    }
+  };
+
+  Sweep_state state = Sweep_state(); // after the last wave
+  std::vector<INT_64> range_start;
+  std::vector<Sweep_state> start_state;
+  std::vector<Range_maws> found;
+#pragma omp parallel num_threads(_num_threads)
+  {
+    INDEX index(*this);
+    for (INT_64 begin = 0; begin < n; begin += cWave_rows) {
+      const INT_64 end = std::min(n, begin + cWave_rows);
+#pragma omp master
+      {
+        split_boundaries(index, begin, end,
+                         std::min(end - begin, max_ranges), state,
+                         range_start, start_state);
+        found.assign(start_state.size(), Range_maws());
+      }
+#pragma omp barrier
+      const INT_64 num_ranges = static_cast<INT_64>(start_state.size());
+#pragma omp for schedule(dynamic, 1)
+      for (INT_64 r = 0; r < num_ranges; ++r) {
+        Range_maws &range_found = found[r];
+        Sweep_state range_state = start_state[r];
+        // maws of each open interval
+        std::vector<std::vector<Found_maw>> pending(range_state.lifo.size());
+        size_t num_inherited = range_state.lifo.size(); // not closed yet
+        auto open = [&]() { pending.emplace_back(); };
+        auto close = [&](const Lcp_interval &interval,
+                         const Letter_counts &counts) {
+          if (pending.size() <= num_inherited) {
+            num_inherited = pending.size() - 1;
+            range_found.inherited.push_back(
+                {range_found.maws.size(), interval, counts});
+          }
+          for (auto &m : pending.back()) {
+            m.freq = key_freq(interval, counts, m.first);
+            range_found.maws.push_back(m);
+          }
+          pending.pop_back();
+        };
+        auto maw = [&](const INT_64 i, const INT_64 lcp, const int l) {
+          if (lcp + 2 < min_len || lcp + 2 > max_len) {
+            return;
+          }
+          // maw: l followed by the first lcp+1 letters of the suffix of row i
+          const UINT_64 prefix = index.prefix(i);
+          const KEY_TYPE key =
+              (static_cast<KEY_TYPE>(l) << lcp) |
+              ((lcp == 0) ? 0 : prefix >> (cLcp_cap - lcp));
+          pending.back().push_back(
+              {key, static_cast<int>(lcp) + 1,
+               ((prefix >> (cLcp_cap - 1 - lcp)) & 1) == 1,
+               static_cast<UINT_8>(l), 0});
+        };
+        sweep(index, range_start[r], range_start[r + 1], range_state, open,
+              close, maw);
+        for (size_t j = 0; j < range_state.lifo.size(); ++j) {
+          if (!pending[j].empty()) {
+            range_found.left_open.emplace_back(range_state.lifo[j],
+                                               std::move(pending[j]));
+          }
+        }
+      }
+#pragma omp master
+      for (auto &range_found : found) {
+        std::size_t next = 0;
+        for (const auto &c : range_found.inherited) {
+          for (; next < c.position; ++next) {
+            const auto &m = range_found.maws[next];
+            report(m.key, m.key_len, m.last, m.freq);
+          }
+          report_waiting(c.interval, c.counts);
+        }
+        for (; next < range_found.maws.size(); ++next) {
+          const auto &m = range_found.maws[next];
+          report(m.key, m.key_len, m.last, m.freq);
+        }
+        for (auto &o : range_found.left_open) {
+          auto &w = waiting[std::make_pair(o.first.lb, o.first.lcp)];
+          w.insert(w.end(), o.second.begin(), o.second.end());
+        }
+        range_found = Range_maws();
+      }
+#pragma omp barrier
+    }
+  }
+
+  /* The intervals still open are closed by the end (from the top) */
+  for (auto it = state.lifo.rbegin(); it != state.lifo.rend(); ++it) {
+    report_waiting(*it, state.counts);
+  }
+}
+
+template <class INDEX>
+void Maw_engine::length_histogram_in(const int max_len,
+                                     std::vector<UINT_64> &num_maws,
+                                     std::vector<UINT_64> &freq) const {
+  num_maws.assign(max_len + 1, 0);
+  freq.assign(max_len + 1, 0);
+  const INT_64 n = _size;
+  std::vector<INT_64> range_start;
+  std::vector<Sweep_state> start_state;
+  Sweep_state end_state = Sweep_state();
+  {
+    INDEX index(*this);
+    split_boundaries(index, 0, n,
+                     std::min<INT_64>(n, 4 * static_cast<INT_64>(_num_threads)),
+                     end_state, range_start, start_state);
+  }
+  const INT_64 num_ranges = static_cast<INT_64>(start_state.size());
+
+  /* Intervals left open by a range (with the number of maws of each letter
+   * waiting for them), and intervals of the starting stack closed by it */
+  struct Left_open {
+    Lcp_interval interval;
+    UINT_64 num[cSigma];
+  };
+  std::vector<std::vector<Left_open>> left_open(num_ranges);
+  std::vector<std::vector<std::pair<Lcp_interval, Letter_counts>>> closed(
+      num_ranges);
+#pragma omp parallel num_threads(_num_threads)
+  {
+    // Histograms of the ranges of this thread
+    std::vector<UINT_64> range_num_maws(max_len + 1, 0);
+    std::vector<UINT_64> range_freq(max_len + 1, 0);
+#pragma omp for schedule(dynamic, 1)
+    for (INT_64 r = 0; r < num_ranges; ++r) {
+      INDEX index(*this);
+      Sweep_state state = start_state[r];
+      std::vector<std::array<UINT_64, cSigma>> num(state.lifo.size(),
+                                                   {{0, 0}});
+      // bottom of the stack not closed yet
+      size_t num_inherited = state.lifo.size();
+      auto open = [&]() { num.push_back({{0, 0}}); };
+      auto close = [&](const Lcp_interval &interval,
+                       const Letter_counts &counts) {
+        const int maw_len = static_cast<int>(interval.lcp) + 2;
+        for (int l = 0; l < cSigma; ++l) {
+          if (num.back()[l] > 0) {
+            range_freq[maw_len] +=
+                num.back()[l] * key_freq(interval, counts, l);
+          }
+        }
+        num.pop_back();
+        if (num.size() < num_inherited) {
+          num_inherited = num.size();
+          closed[r].emplace_back(interval, counts);
+        }
+      };
+      auto maw = [&](const INT_64, const INT_64 lcp, const int l) {
+        if (lcp + 2 <= max_len) {
+          ++range_num_maws[lcp + 2];
+          ++num.back()[l];
+        }
+      };
+      sweep(index, range_start[r], range_start[r + 1], state, open, close,
+            maw);
+      for (size_t j = 0; j < state.lifo.size(); ++j) {
+        if (num[j][0] > 0 || num[j][1] > 0) {
+          left_open[r].push_back({state.lifo[j], {num[j][0], num[j][1]}});
+        }
+      }
+    }
+#pragma omp critical
+    for (int len = 0; len <= max_len; ++len) {
+      num_maws[len] += range_num_maws[len];
+      freq[len] += range_freq[len];
+    }
+  }
+
+  /* The intervals left open are closed by a later range or by the end */
+  const auto counts_at_close = closing_counts(closed);
+  for (const auto &range_left_open : left_open) {
+    for (const auto &o : range_left_open) {
+      const auto it =
+          counts_at_close.find(std::make_pair(o.interval.lb, o.interval.lcp));
+      const Letter_counts &counts =
+          (it == counts_at_close.end()) ? end_state.counts : it->second;
+      for (int l = 0; l < cSigma; ++l) {
+        freq[o.interval.lcp + 2] += o.num[l] * key_freq(o.interval, counts, l);
+      }
+    }
+  }
+}
+
+void Maw_engine::clear() {
+  _seq = nullptr;
+  _size = 0;
+  _index = Memory_index();
+  if (_is_external_memory) {
+    sdsl::util::delete_all_files(_config.file_map);
+    _is_external_memory = false;
+  }
+  _doc_start.clear();
+  _num_last[0] = _num_last[1] = 0;
+  _num_threads = 1;
+}
+
+//////////////////////// private ////////////////////////
+Maw_engine::Memory_reader::Memory_reader(const Maw_engine &engine)
+    : engine(engine), sa(engine._index.sa), lcp(engine._index.lcp),
+      bwt(engine._index.bwt), before(engine._index.before),
+      before_lcp(engine._index.before_lcp), seen(engine._index.seen) {}
+
+UINT_64 Maw_engine::Memory_reader::prefix(const INT_64 i) const {
+  const int len = static_cast<int>(std::min<INT_64>(cLcp_cap, rest(i)));
+  return engine._seq->get_bits(sa[i], len) << (cLcp_cap - len);
+}
+
+INT_64 Maw_engine::Memory_reader::rest(const INT_64 i) const {
+  const INT_64 suffix = sa[i];
+  return engine.doc_end(suffix) - suffix;
+}
+
+Maw_engine::File_index::File_index(const Maw_engine &engine,
+                                   const std::ios::openmode mode) {
+  const auto &config = engine._config;
+  prefixes = sdsl::int_vector_buffer<64>(
+      sdsl::cache_file_name(cKey_prefix, config), mode, cBuffer_size);
+  rests = sdsl::int_vector_buffer<8>(sdsl::cache_file_name(cKey_rest, config),
+                                     mode, cBuffer_size);
+  lcp = sdsl::int_vector_buffer<8>(sdsl::cache_file_name(cKey_lcp, config),
+                                   mode, cBuffer_size);
+  bwt = sdsl::int_vector_buffer<2>(sdsl::cache_file_name(cKey_bwt, config),
+                                   mode, cBuffer_size);
+  for (int j = 0; j < cSigma; ++j) {
+    before[j] = sdsl::int_vector_buffer<1>(
+        sdsl::cache_file_name(cKey_before[j], config), mode, cBuffer_size);
+    before_lcp[j] = sdsl::int_vector_buffer<1>(
+        sdsl::cache_file_name(cKey_before_lcp[j], config), mode,
+        cBuffer_size);
+  }
+  seen = sdsl::int_vector_buffer<1>(sdsl::cache_file_name(cKey_seen, config),
+                                    mode, cBuffer_size);
+}
+
+void Maw_engine::assign_zeros(sdsl::bit_vector &bits, const UINT_64 n) {
+  bits = sdsl::bit_vector(n, 0);
+}
+
+void Maw_engine::assign_zeros(sdsl::int_vector_buffer<1> &bits,
+                              const UINT_64 n) {
+  bits.reset();
+  for (UINT_64 i = 0; i < n; ++i) {
+    bits.push_back(0);
+  }
+}
+
+INT_64 Maw_engine::sequence_position(const INT_64 t) const {
+  // document d starts at _doc_start[d] + d in the text: find the last one
+  // starting at t or before
+  INT_64 lo = 0;
+  INT_64 hi = static_cast<INT_64>(_doc_start.size());
+  while (hi - lo > 1) {
+    const INT_64 mid = lo + (hi - lo) / 2;
+    if (_doc_start[mid] + mid <= t) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return t - lo;
+}
+
+INT_64 Maw_engine::doc_end(const INT_64 p) const {
+  const auto it = std::upper_bound(_doc_start.begin(), _doc_start.end(), p);
+  return (it == _doc_start.end()) ? _size : *it;
+}
+
+bool Maw_engine::is_doc_start(const INT_64 p) const {
+  return std::binary_search(_doc_start.begin(), _doc_start.end(), p);
+}
+
+ReturnStatus Maw_engine::start_build(const UINT_64 n,
+                                     const std::vector<UINT_64> &doc_start,
+                                     const AdOptions &options,
+                                     const bool is_external_memory) {
+  if (n == 0) {
+    std::cerr << "No Input: Empty sequence: " << std::endl;
+    return ReturnStatus::ERR_INVALID_INPUT;
+  }
+  for (std::size_t d = 0; d < doc_start.size(); ++d) {
+    const bool is_ordered =
+        (d == 0) ? doc_start[d] == 0 : doc_start[d] > doc_start[d - 1];
+    if (!is_ordered || doc_start[d] >= n) {
+      std::cerr << "Invalid documents: document " << d
+                << " is empty or out of the sequence " << std::endl;
+      return ReturnStatus::ERR_INVALID_INPUT;
+    }
+  }
+  _num_threads = (options.num_threads > 0) ? options.num_threads
+                                           : omp_get_max_threads();
+  const UINT_64 needed = memory_estimate(n, is_external_memory, _num_threads);
+  if (options.max_memory > 0 && needed > options.max_memory) {
+    std::cerr << "Memory limit exceeded: indexing the sequence needs "
+              << (is_external_memory ? "at least " : "about ")
+              << (needed >> 20) << " MB " << std::endl;
+    return ReturnStatus::ERR_LIMIT_EXCEEDS;
+  }
+  _size = static_cast<INT_64>(n);
+  _doc_start.assign(doc_start.begin(), doc_start.end());
+  if (_doc_start.empty()) {
+    _doc_start.push_back(0);
+  }
+  return ReturnStatus::SUCCESS;
+}
+
+bool Maw_engine::compute_sa() {
+  const INT_64 n = _size;
+  const INT_64 num_docs = static_cast<INT_64>(_doc_start.size());
+  const INT_64 len = n + num_docs - 1;
+  /* One letter per byte for suffix sorting (released afterwards): letters 1
+   * and 2, the documents being separated by 0 which sorts as the end of the
+   * text */
+  std::vector<UINT_8> text(len, 0);
+  for (INT_64 d = 0; d < num_docs; ++d) {
+    const INT_64 end = doc_end(_doc_start[d]);
+#pragma omp parallel for schedule(static) num_threads(_num_threads)
+    for (INT_64 i = _doc_start[d]; i < end; ++i) {
+      text[i + d] = (*_seq)[i] + 1;
+    }
+  }
+  sdsl::int_vector<> &sa = _index.sa;
+  if (len < (INT_64(1) << 31)) {
+    sa = sdsl::int_vector<>(len, 0, 32);
+    if (divsufsort(text.data(), reinterpret_cast<saidx_t *>(sa.data()),
+                   static_cast<saidx_t>(len)) != 0) {
+      return false;
+    }
+  } else {
+    sa = sdsl::int_vector<>(len, 0, 64);
+    if (divsufsort64(text.data(), reinterpret_cast<saidx64_t *>(sa.data()),
+                     len) != 0) {
+      return false;
+    }
+  }
+  if (num_docs > 1) {
+    /* The suffixes starting with a separator come first: drop them (in
+     * place, the entries sharing words of the suffix array) */
+    std::vector<UINT_8>().swap(text);
+    const INT_64 skip = num_docs - 1;
+    for (INT_64 i = 0; i < n; ++i) {
+      sa[i] = sequence_position(sa[i + skip]);
+    }
+    sa.resize(n);
+  }
+  sdsl::util::bit_compress(sa);
+  return true;
+}
+
+void Maw_engine::compute_lcp() {
+  const INT_64 n = _size;
+  const sdsl::int_vector<> &sa = _index.sa;
+  std::vector<UINT_8> &lcp = _index.lcp;
+  lcp.assign(n, 0);
+#pragma omp parallel for schedule(static) num_threads(_num_threads)
+  for (INT_64 i = 1; i < n; ++i) {
+    lcp[i] = capped_lcp(sa[i - 1], sa[i]);
+  }
+}
+
+UINT_8 Maw_engine::capped_lcp(const INT_64 p, const INT_64 q) const {
+  // no common prefix goes beyond the end of a document
+  const INT_64 rest = std::min(doc_end(p) - p, doc_end(q) - q);
+  const int len = static_cast<int>(std::min<INT_64>(cLcp_cap, rest));
+  const UINT_64 diff = _seq->get_bits(p, len) ^ _seq->get_bits(q, len);
+  // the first different bit is the highest one set in diff
+  return static_cast<UINT_8>((diff == 0) ? len
+                                         : len - cLcp_cap + __builtin_clzll(diff));
+}
+
+ReturnStatus Maw_engine::sort_runs(Sequence_file &seq_file,
+                                   const UINT_64 sort_memory,
+                                   std::vector<std::string> &runs) {
+  const INT_64 n = _size;
+  /* Records of a run, with the bits of their positions (read twice) */
+  const INT_64 run_len = std::max<INT_64>(
+      1, std::min<UINT_64>(n, sort_memory * cByte_Size /
+                                  (cByte_Size * sizeof(Record) + 2)));
+  std::vector<Record> records;
+  records.reserve(run_len);
+  SEQUENCE window;
+  for (INT_64 begin = 0; begin < n; begin += run_len) {
+    const INT_64 end = std::min(n, begin + run_len);
+    // the letter before the first position, and the prefix of the last one
+    const INT_64 from = std::max<INT_64>(0, begin - 1);
+    const INT_64 to = std::min<INT_64>(n, end + cLcp_cap);
+    auto status = seq_file.read(from, to - from, window);
+    if (status != ReturnStatus::SUCCESS) {
+      return status;
+    }
+    records.resize(end - begin);
+#pragma omp parallel for schedule(static) num_threads(_num_threads)
+    for (INT_64 p = begin; p < end; ++p) {
+      const INT_64 rest = doc_end(p) - p;
+      const int len = static_cast<int>(std::min<INT_64>(cLcp_cap, rest));
+      Record &record = records[p - begin];
+      record.prefix = window.get_bits(p - from, len) << (cLcp_cap - len);
+      record.rest = static_cast<UINT_8>(std::min<INT_64>(cLcp_cap + 1, rest));
+      record.before = static_cast<UINT_8>(
+          is_doc_start(p) ? cNo_letter : window[p - 1 - from]);
+    }
+    // in place (the records take the memory given)
+    __gnu_parallel::sort(records.begin(), records.end(), std::less<Record>(),
+                         __gnu_parallel::balanced_quicksort_tag(_num_threads));
+    const std::string filename =
+        scratch_file(cKey_run + std::to_string(runs.size()));
+    Record_writer<Record> run(filename, cBuffer_size);
+    for (const auto &record : records) {
+      run.push_back(record);
+    }
+    if (filename.empty() || !run.close()) {
+      std::cerr << "Cannot write the runs in the scratch directory: "
+                << _config.dir << std::endl;
+      return ReturnStatus::ERR_FILE_OPEN;
+    }
+    runs.push_back(filename);
+  }
+  return ReturnStatus::SUCCESS;
+}
+
+ReturnStatus Maw_engine::merge_runs(std::vector<std::string> &runs,
+                                    const UINT_64 sort_memory,
+                                    File_index &index) {
+  const std::size_t fan_in =
+      std::max<std::size_t>(2, sort_memory / cMin_merge_buffer);
+  auto buffer_size = [&](const std::size_t num_runs) {
+    return std::min<UINT_64>(cBuffer_size, sort_memory / num_runs);
+  };
+  auto remove_runs = [&](const std::vector<std::string> &files) {
+    for (const auto &filename : files) {
+      sdsl::remove(filename);
+      for (auto it = _config.file_map.begin(); it != _config.file_map.end();
+           ++it) {
+        if (it->second == filename) {
+          _config.file_map.erase(it);
+          break;
+        }
+      }
+    }
+  };
+  /* Passes merging fan_in runs at a time into longer ones */
+  std::size_t next_run = runs.size();
+  while (runs.size() > fan_in) {
+    std::vector<std::string> merged;
+    for (std::size_t g = 0; g < runs.size(); g += fan_in) {
+      const std::vector<std::string> group(
+          runs.begin() + g, runs.begin() + std::min(runs.size(), g + fan_in));
+      const std::string filename =
+          scratch_file(cKey_run + std::to_string(next_run++));
+      Record_writer<Record> run(filename, cBuffer_size);
+      auto out = [&](const Record &record) { run.push_back(record); };
+      if (filename.empty() ||
+          !merge_records<Record>(group, buffer_size(group.size()), out) ||
+          !run.close()) {
+        return ReturnStatus::ERR_FILE_OPEN;
+      }
+      remove_runs(group);
+      merged.push_back(filename);
+    }
+    runs.swap(merged);
+  }
+  /* Last pass: into the arrays of the index */
+  bool is_first = true;
+  Record previous = Record();
+  auto out = [&](const Record &record) {
+    const UINT_64 diff = previous.prefix ^ record.prefix;
+    const int lcp = is_first ? 0
+                             : std::min<int>(
+                                   (diff == 0) ? cLcp_cap : __builtin_clzll(diff),
+                                   std::min(previous.rest, record.rest));
+    index.prefixes.push_back(record.prefix);
+    index.rests.push_back(record.rest);
+    index.bwt.push_back(record.before);
+    index.lcp.push_back(std::min(lcp, cLcp_cap));
+    previous = record;
+    is_first = false;
+  };
+  if (!merge_records<Record>(runs, buffer_size(runs.size()), out)) {
+    return ReturnStatus::ERR_FILE_OPEN;
+  }
+  remove_runs(runs);
+  return ReturnStatus::SUCCESS;
+}
+
+std::string Maw_engine::scratch_file(const std::string &key) {
+  const std::string filename = sdsl::cache_file_name(key, _config);
+  if (!std::ofstream(filename)) {
+    return std::string();
+  }
+  sdsl::register_cache_file(key, _config); // to be removed by clear()
+  return filename;
+}
+
+template <class INDEX> void Maw_engine::compute_before(INDEX &index) {
+  const INT_64 n = _size;
+  for (int j = 0; j < cSigma; ++j) {
+    assign_zeros(index.before[j], 2 * n);
+    assign_zeros(index.before_lcp[j], 2 * n);
+  }
+  std::vector<INT_64> lifo_lcp;
+  std::vector<INT_64> lifo_rem;
+  INT_64 lcp = 0;
+  INT_64 mem = 0;
+  INT_64 proxa = 0;
+  INT_64 proxb = 0;
+  lifo_lcp.push_back(0);
+
+  /* Max LCP value */
+  INT_64 hm = 0;
+  for (INT_64 i = 0; i < n; ++i) {
+    hm = std::max<INT_64>(hm, index.lcp[i]);
+  }
+  hm = hm + 2;
+  sdsl::bit_vector interval[cSigma];
+  for (int j = 0; j < cSigma; ++j) {
+    interval[j] = sdsl::bit_vector(hm, 0);
+  }
+  for (int j = 0; j < cSigma; ++j) { // letters ending a document
+    interval[j][0] = (_num_last[j] > 0) ? 1 : 0;
+  }
+
+  // Opens the intervals (from the top of the stack) for letter k
+  auto open_intervals = [&](const int k) {
+    for (auto it = lifo_lcp.rbegin(); it != lifo_lcp.rend(); ++it) {
+      if (interval[k][*it] == 1) {
+        break;
+      }
+      interval[k][*it] = 1;
+    }
+  };
+  // Pushes LCP[i] on the stack (no duplicates)
+  auto push_lcp = [&](const INT_64 i) {
+    const INT_64 lcp_i = index.lcp[i];
+    if (lifo_lcp.back() != lcp_i) {
+      lifo_lcp.push_back(lcp_i);
+    }
+  };
+
+  /* First pass: top-down */
+  for (INT_64 i = 0; i < n; ++i) {
+    const INT_64 lcp_i = index.lcp[i];
+    // we empty the intervals that correspond to a higher lcp value
+    if (i > 0 && lcp_i < static_cast<INT_64>(index.lcp[i - 1])) {
+      lcp = lifo_lcp.back();
+      lifo_lcp.pop_back();
+      while (!lifo_lcp.empty() && lcp > lcp_i) {
+        mem = lifo_lcp.back();
+        lifo_lcp.pop_back();
+        if (mem <= lcp_i) {
+          for (int j = 0; j < cSigma; ++j) {
+            if (mem != lcp_i) { // next interval has not been opened
+              interval[j][lcp_i] = interval[j][lcp];
+            }
+            index.before[j][2 * i - 1] = interval[j][lcp];
+            index.before_lcp[j][2 * i - 1] =
+                (mem == lcp_i) ? interval[j][mem] : interval[j][lcp];
+          }
+        }
+        for (int j = 0; j < cSigma; ++j) {
+          interval[j][lcp] = 0;
+        }
+        lcp = mem;
+      }
+      lifo_lcp.push_back(lcp);
+    }
+
+    // we update those having a lower lcp
+    const int bwt_i = index.bwt[i];
+    const int k = (bwt_i == cNo_letter) ? -1 : bwt_i;
+    if (k != -1) {
+      open_intervals(k);
+      interval[k][lcp_i] = 1;
+    }
+    // we also add the letter preceding the previous suffix
+    if (i > 0 && lcp_i > 0) {
+      const int bwt_previous = index.bwt[i - 1];
+      if (bwt_previous != cNo_letter) {
+        interval[bwt_previous][lcp_i] = 1;
+      }
+    }
+
+    for (int j = 0; j < cSigma; ++j) {
+      index.before_lcp[j][2 * i] = interval[j][lcp_i];
+    }
+    if (k != -1) {
+      index.before[k][2 * i + 1] = 1;
+      index.before[k][2 * i] = 1;
+      index.before_lcp[k][2 * i + 1] = 1;
+      index.before_lcp[k][2 * i] = 1;
+    }
+    push_lcp(i);
+  }
+
+  /* Second pass: bottom-up */
+  // we empty the interval table
+  for (auto l : lifo_lcp) {
+    for (int j = 0; j < cSigma; ++j) {
+      interval[j][l] = 0;
+    }
+  }
+  lifo_lcp.assign(1, 0);
+
+  for (INT_64 i = n - 1; i >= 0; --i) {
+    const INT_64 lcp_i = index.lcp[i];
+    lcp = lifo_lcp.back();
+    lifo_lcp.pop_back();
+    proxa = lcp_i + 1; // the lcp-value that is just higher than LCP[i]
+    while (!lifo_lcp.empty() && lcp > lcp_i) {
+      lifo_rem.push_back(lcp);
+      mem = lifo_lcp.back();
+      lifo_lcp.pop_back();
+      if (mem < lcp_i) { // the interval has not been opened
+        for (int j = 0; j < cSigma; ++j) {
+          interval[j][lcp_i] = interval[j][lcp];
+        }
+        proxa = lcp;
+      }
+      if (mem == lcp_i) {
+        proxa = lcp;
+      }
+      lcp = mem;
+    }
+    lifo_lcp.push_back(lcp);
+
+    // we update the lower intervals
+    for (int k = 0; k < cSigma; ++k) {
+      if (index.before[k][2 * i] == 1) {
+        open_intervals(k);
+        interval[k][lcp_i] = 1;
+      }
+    }
+
+    for (int j = 0; j < cSigma; ++j) {
+      index.before_lcp[j][2 * i] = index.before_lcp[j][2 * i] || interval[j][lcp_i];
+      if (i < n - 1) {
+        // proxb is the lcp-value that is just higher than LCP[i+1]
+        index.before[j][2 * i + 1] = index.before[j][2 * i + 1] || interval[j][proxb];
+        index.before_lcp[j][2 * i + 1] =
+            interval[j][index.lcp[i + 1]] || index.before_lcp[j][2 * i + 1];
+      }
+    }
+    proxb = proxa;
+
+    // we suppress higher intervals
+    if (i < n - 1 && static_cast<INT_64>(index.lcp[i + 1]) > lcp_i) {
+      lcp = lifo_rem.back(); // the one that is just higher than LCP[i]
+      lifo_rem.pop_back();
+      for (int j = 0; j < cSigma; ++j) {
+        index.before[j][2 * i] = index.before[j][2 * i] || interval[j][lcp];
+        interval[j][lcp] = 0;
+      }
+      while (!lifo_rem.empty()) {
+        lcp = lifo_rem.back();
+        lifo_rem.pop_back();
+        for (int j = 0; j < cSigma; ++j) {
+          interval[j][lcp] = 0;
+        }
+      }
+    }
+    push_lcp(i);
+  }
+}
+
+template <class INDEX> void Maw_engine::compute_seen(INDEX &index) {
+  const INT_64 n = _size;
+  assign_zeros(index.seen, n);
+  std::vector<INT_64> lifo_lcp(1, 0);
+  for (INT_64 i = 0; i < n; ++i) {
+    const INT_64 lcp_i = index.lcp[i];
+    INT_64 lcp = lifo_lcp.back();
+    lifo_lcp.pop_back();
+    while (!lifo_lcp.empty() && lcp > lcp_i) {
+      const INT_64 mem = lifo_lcp.back();
+      lifo_lcp.pop_back();
+      if (mem == lcp_i) {
+        index.seen[i] = 1;
+      }
+      lcp = mem;
+    }
+    lifo_lcp.push_back(lcp);
+    lifo_lcp.push_back(lcp_i);
+  }
+}
+
+void Maw_engine::compute_bwt() {
+  const INT_64 n = _size;
+  sdsl::int_vector<2> &bwt = _index.bwt;
+  bwt = sdsl::int_vector<2>(n, 0);
+  // 32 rows per iteration: one word of the vector each
+  const INT_64 num_words = (n + 31) / 32;
+#pragma omp parallel for schedule(static) num_threads(_num_threads)
+  for (INT_64 w = 0; w < num_words; ++w) {
+    const INT_64 end = std::min(n, (w + 1) * 32);
+    for (INT_64 i = w * 32; i < end; ++i) {
+      const INT_64 suffix = _index.sa[i];
+      bwt[i] = is_doc_start(suffix) ? cNo_letter : (*_seq)[suffix - 1];
+    }
+  }
+}
+
+template <class INDEX>
+INT_64 Maw_engine::maw_row(INDEX &index, const INT_64 i, const int l) const {
+  const INT_64 n = _size;
+  // the maw goes one letter beyond the LCP: in the document of the suffix
+  const INT_64 rest = index.rest(i);
+  if (index.before[l][2 * i] == 0 && index.before_lcp[l][2 * i] == 1 &&
+      static_cast<INT_64>(index.lcp[i]) < rest) {
+    return i;
+  }
+  if (i < n - 1 && index.before[l][2 * i + 1] == 0 &&
+      index.before_lcp[l][2 * i + 1] == 1 &&
+      static_cast<INT_64>(index.lcp[i + 1]) < rest &&
+      index.seen[i + 1] == 0) {
+    return i + 1;
+  }
+  return -1;
+}
+
+template <class INDEX, class OPEN, class CLOSE>
+void Maw_engine::advance(INDEX &index, const INT_64 k, Sweep_state &state,
+                         OPEN &open, CLOSE &close) const {
+  std::vector<Lcp_interval> &lifo = state.lifo;
+  Letter_counts &counts = state.counts;
+  if (k == 0) { // the root interval
+    lifo.push_back({0, 0, Letter_counts()});
+    open();
+  } else {
+    const INT_64 lcp_k = index.lcp[k];
+    INT_64 lb = k - 1;
+    Letter_counts before_lb = counts; // rows before k-1
+    const int bwt_previous = index.bwt[k - 1];
+    if (bwt_previous != cNo_letter) {
+      --before_lb.num[bwt_previous];
+    }
+    while (lifo.back().lcp > lcp_k) { // next smaller LCP is at k
+      close(lifo.back(), counts);
+      lb = lifo.back().lb;
+      before_lb = lifo.back().before_lb;
+      lifo.pop_back();
+    }
+    if (lifo.back().lcp < lcp_k) {
+      lifo.push_back({lcp_k, lb, before_lb});
+      open();
+    }
+  }
+  const int bwt_k = index.bwt[k];
+  if (bwt_k != cNo_letter) {
+    ++counts.num[bwt_k];
+  }
+}
+
+template <class INDEX, class OPEN, class CLOSE, class MAW>
+void Maw_engine::sweep(INDEX &index, const INT_64 begin, const INT_64 end,
+                       Sweep_state &state, OPEN &open, CLOSE &close,
+                       MAW &maw) const {
+  for (INT_64 k = begin; k < end; ++k) {
+    advance(index, k, state, open, close);
+    for (int l = 0; l < cSigma; ++l) {
+      if (maw_row(index, k, l) == k) {
+        maw(k, index.lcp[k], l);
+      }
+      if (k > 0 && maw_row(index, k - 1, l) == k) {
+        maw(k - 1, index.lcp[k], l);
+      }
+    }
+  }
+}
+
+template <class INDEX>
+void Maw_engine::split_boundaries(INDEX &index, const INT_64 begin,
+                                  const INT_64 end, const INT_64 num_ranges,
+                                  Sweep_state &state,
+                                  std::vector<INT_64> &range_start,
+                                  std::vector<Sweep_state> &start_state) const {
+  range_start.resize(num_ranges + 1);
+  for (INT_64 r = 0; r <= num_ranges; ++r) {
+    range_start[r] = begin + (end - begin) * r / num_ranges;
+  }
+  start_state.assign(num_ranges, Sweep_state());
+  auto no_open = []() {};
+  auto no_close = [](const Lcp_interval &, const Letter_counts &) {};
+  for (INT_64 r = 0; r < num_ranges; ++r) {
+    start_state[r] = state;
+    for (INT_64 k = range_start[r]; k < range_start[r + 1]; ++k) {
+      advance(index, k, state, no_open, no_close);
+    }
+  }
+}
+
+std::map<std::pair<INT_64, INT_64>, Maw_engine::Letter_counts>
+Maw_engine::closing_counts(
+    const std::vector<std::vector<std::pair<Lcp_interval, Letter_counts>>>
+        &closed) {
+  std::map<std::pair<INT_64, INT_64>, Letter_counts> counts_at_close;
+  for (const auto &range_closed : closed) {
+    for (const auto &c : range_closed) {
+      counts_at_close[std::make_pair(c.first.lb, c.first.lcp)] = c.second;
+    }
+  }
+  return counts_at_close;
+}
+
+UINT_64 Maw_engine::key_freq(const Lcp_interval &interval,
+                             const Letter_counts &counts, const int l) const {
+  // rows of the interval preceded by l
+  UINT_64 freq = counts.num[l] - interval.before_lb.num[l];
+  if (interval.lcp == 0) { // the key is a single letter
+    freq += _num_last[l];  // which also ends documents
+  }
+  return freq;
+}
+
+} // end namespace
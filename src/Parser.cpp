@@ -14,425 +14,527 @@ Pissis
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **/
 
-/** Implements class Parser
+/** Implements classes Parser and BasicParser
  */
 #include "../include/Parser.hpp"
 
 namespace mawcd {
 
-Parser::Parser(const AlphabetType alphabetType, const std::string &alphabet)
-    : _cAlphabetType(alphabetType), _cAlphabet(alphabet),
-      _cOriginal_alphbet_size(alphabet.size()),
-      _cEncoded_char_len(static_cast<int>(ceil(log2(alphabet.size())))) {}
-
-Parser::Parser()
-    : _cAlphabetType(AlphabetType::GEN), _cAlphabet(""),
-      _cOriginal_alphbet_size(255), _cEncoded_char_len(8) {}
-
-ReturnStatus Parser::encode_from_string(const std::string &str,
-                                        SEQUENCE &sequence) const {
-  FCheckValidity fCheckValidity = &Parser::is_valid_char_general;
-  FMapChar fMapChar = &Parser::map_char_general;
-
-  if (_cAlphabetType == AlphabetType::DNA) {
-    fCheckValidity = &Parser::is_valid_char_dna;
-    fMapChar = &Parser::map_char_dna;
-  } else if (_cAlphabetType == AlphabetType::PROT) {
-    fCheckValidity = &Parser::is_valid_char_prot;
-    fMapChar = &Parser::map_char_prot;
-  } else if (_cAlphabetType == AlphabetType::SEL) {
-    fCheckValidity = &Parser::is_valid_char_select;
-    fMapChar = &Parser::map_char_select;
-  }
+template <class Alphabet> const UINT_16 BasicParser<Alphabet>::cSkip_code;
+template <class Alphabet> const UINT_16 BasicParser<Alphabet>::cInvalid_code;
+template <class Alphabet> const int BasicParser<Alphabet>::cSimd_block;
+
+template <class Alphabet>
+BasicParser<Alphabet>::BasicParser(const std::string &alphabet)
+    : _cAlphabet(alphabet),
+      _cEncoded_char_len((Alphabet::cCode_len != 0)
+                             ? static_cast<int>(Alphabet::cCode_len)
+                             : code_len_for(static_cast<int>(alphabet.size()))) {
+  build_encode_table();
+  build_decode_table();
+}
 
-  sequence.reserve(str.size() * _cEncoded_char_len);
+template <class Alphabet>
+ReturnStatus
+BasicParser<Alphabet>::encode_from_string(const std::string &str,
+                                          SEQUENCE &sequence) const {
+  sequence.reserve(sequence.size() + str.size() * code_len());
+  return encode(str.data(), str.size(), sequence);
+}
 
-  // Get the encoded string
-  for (char c : str) {
-    if (_cAlphabetType != AlphabetType::GEN && isspace(c)) {
-      // Ignore
-    } else if ((this->*fCheckValidity)(c)) {
-      sequence += (this->*fMapChar)(c);
-    } else {
-      std::cerr << "Invalid Input: Invalid character: " << c << std::endl;
-      return ReturnStatus::ERR_INVALID_INPUT;
+template <class Alphabet>
+ReturnStatus BasicParser<Alphabet>::encode_in_place(const char *str,
+                                                    const UINT_64 len,
+                                                    Bit_writer &writer) const {
+  return encode(str, len, writer);
+}
+
+template <class Alphabet>
+UINT_64 BasicParser<Alphabet>::count_codes(const char *str,
+                                           const UINT_64 len) const {
+  UINT_64 count = 0;
+  for (UINT_64 i = 0; i < len; ++i) {
+    count += !(_encode_table[static_cast<UINT_8>(str[i])] & cSkip_code);
+  }
+  return count;
+}
+
+template <class Alphabet>
+template <class OUT>
+ReturnStatus BasicParser<Alphabet>::encode(const char *str, const UINT_64 len,
+                                           OUT &out) const {
+  UINT_64 i = 0;
+  while (i < len) {
+    // As many blocks as possible in SIMD
+    i += encode_simd(str + i, len - i, out);
+    // Next block (or the rest) through the table
+    const UINT_64 block_len = std::min<UINT_64>(cSimd_block, len - i);
+    auto result = encode_scalar(str + i, block_len, out);
+    if (result != ReturnStatus::SUCCESS) {
+      return result;
     }
+    i += block_len;
   }
   return ReturnStatus::SUCCESS;
 }
 
-ReturnStatus Parser::pack_sequence(const SEQUENCE &seq,
-                                   std::string &pvs_hanging,
+ReturnStatus Parser::pack_sequence(const SEQUENCE &seq, SEQUENCE &pvs_hanging,
                                    PACKED_SEQUENCE &packed_sequence) const {
 
-  auto seq_len = seq.size();
-  int seq_start_index = 0;
+  const UINT_64 seq_len = seq.size();
+  UINT_64 seq_start_index = 0;
 
-  UINT_8 c;
   /* Adjust last hanging bits from the last chunk */
   if (!pvs_hanging.empty()) {
-    int num_haging_bits = pvs_hanging.size();
-    int remaining_bits = cByte_Size - num_haging_bits;
-    seq_start_index = remaining_bits;
-
-    /* fill the remaining */
-    std::string pack;
+    const int num_haging_bits = pvs_hanging.size();
+    const int remaining_bits = cByte_Size - num_haging_bits;
+    UINT_8 c = static_cast<UINT_8>(pvs_hanging.get_bits(0, num_haging_bits)
+                                   << remaining_bits);
     if (seq.empty()) { // pack only the hanging bits padding with zeros
-      std::string zeroes(remaining_bits, '0');
-      pack = pvs_hanging + zeroes;
+      pvs_hanging.clear();
+      packed_sequence.push_back(c);
 #ifdef VERBOSE
-      std::cout << "Padded pack: " << pack << std::endl;
+      std::cout << "Padded pack: " << std::bitset<8>(c) << std::endl;
 #endif
-    } else { // pack the hanging bts with those from the sequence
-      pack = pvs_hanging + seq.substr(0, remaining_bits);
+      return ReturnStatus::SUCCESS;
     }
-
-    if (pack.size() < cByte_Size) { // unfilled byte
-      pvs_hanging.assign(pack);
-    } else {                  // add to pack
-      pvs_hanging.assign(""); // pvs_hanging used. nothing left
-      c = static_cast<UINT_8>(std::stoi(pack, nullptr,
-                                        2)); // change to int of base 2
-      packed_sequence.push_back(c); // add the valid last byte with the new
-#ifdef VERBOSE
-      std::cout << "Adding the hanging: " << std::bitset<8>(c) << std::endl;
-#endif
+    if (seq_len < static_cast<UINT_64>(remaining_bits)) { // unfilled byte
+      pvs_hanging.append(seq);
+      return ReturnStatus::SUCCESS;
     }
-  } // last hanging bits from the previous chunk handled
-  if (seq_len > seq_start_index) { // sequence is left
-    auto bits_to_pack = (seq_len - seq_start_index);
-    auto max_bytes_in_pack = (bits_to_pack / cByte_Size) +
-                             1; // 1 (possibly) for last bytes from last chunk
-    packed_sequence.reserve(max_bytes_in_pack);
-
-    for (auto ind = seq_start_index; ind < seq_len; ind += cByte_Size) {
-      std::string pack = seq.substr(ind, cByte_Size);
-      if (pack.size() < cByte_Size) { // unfilled byte
-        pvs_hanging.assign(pack);
-      } else { // add to pack
-        int i = (std::stoi(
-            pack, nullptr,
-            2)); // change to int of base 2 and keep only the last byte
-        c = static_cast<UINT_8>(i);
+    // pack the hanging bits with those from the sequence
+    c |= static_cast<UINT_8>(seq.get_bits(0, remaining_bits));
+    packed_sequence.push_back(c);
+    pvs_hanging.clear(); // pvs_hanging used. nothing left
+    seq_start_index = remaining_bits;
 #ifdef VERBOSE
-        std::cout << "CONVERTED: " << std::bitset<8>(c) << std::endl;
+    std::cout << "Adding the hanging: " << std::bitset<8>(c) << std::endl;
 #endif
-        packed_sequence.push_back(c); // add the valid last byte with the new
-      }
+  } // last hanging bits from the previous chunk handled
+
+  const UINT_64 bits_to_pack = seq_len - seq_start_index;
+  packed_sequence.reserve(packed_sequence.size() + bits_to_pack / cByte_Size);
+  UINT_64 ind = seq_start_index;
+  // Whole words at a time (most significant byte first)
+  for (; ind + Bit_sequence::cWord_size <= seq_len;
+       ind += Bit_sequence::cWord_size) {
+    const UINT_64 word = seq.get_bits(ind, Bit_sequence::cWord_size);
+    for (int shift = Bit_sequence::cWord_size - cByte_Size; shift >= 0;
+         shift -= cByte_Size) {
+      packed_sequence.push_back(static_cast<UINT_8>(word >> shift));
     }
   }
+  // Remaining whole bytes
+  for (; ind + cByte_Size <= seq_len; ind += cByte_Size) {
+    packed_sequence.push_back(static_cast<UINT_8>(seq.get_bits(ind, cByte_Size)));
+  }
+  // Unfilled byte
+  if (ind < seq_len) {
+    pvs_hanging = seq.slice(ind, seq_len - ind);
+  }
 
   return ReturnStatus::SUCCESS;
 }
 
-// Assumes string to have valid characters
-// Ideally in the last chunk pvs_remaining will produce nothing
-ReturnStatus Parser::decode_to_string(const SEQUENCE &sequence,
-                                      std::string &pvs_hanging,
-                                      std::string &str) const {
-  FRevMapChar fRevMapChar = &Parser::reverse_map_char_general;
-
-  if (_cAlphabetType == AlphabetType::DNA) {
-    fRevMapChar = &Parser::reverse_map_char_dna;
-  } else if (_cAlphabetType == AlphabetType::PROT) {
-    fRevMapChar = &Parser::reverse_map_char_prot;
-  } else if (_cAlphabetType == AlphabetType::SEL) {
-    fRevMapChar = &Parser::reverse_map_char_select;
-  }
-  int start_ind = 0;
-  ENCODED_CHAR c;
-  if (!pvs_hanging.empty()) { // something carried on from the previous chunk
-    int already_filled = pvs_hanging.size();
-    int unfilled = _cEncoded_char_len - already_filled;
-    c = pvs_hanging + sequence.substr(0, unfilled);
-    if (c.size() == _cEncoded_char_len) { // Add to string if can be decoded
-      str += (this->*fRevMapChar)(c);
-      pvs_hanging.assign("");
-    } else {
-      pvs_hanging.assign(c);
+// Ideally in the last chunk pvs_hanging will produce nothing
+template <class Alphabet>
+ReturnStatus BasicParser<Alphabet>::decode_to_string(const SEQUENCE &sequence,
+                                                     UINT_64 &pvs_hanging,
+                                                     int &num_hanging,
+                                                     std::string &str) const {
+  const int w = code_len();
+  const int symbols = decode_symbols();
+  const int bits = decode_bits();
+  const UINT_64 seq_len = sequence.size();
+  UINT_64 pos = 0;
+  if (num_hanging > 0) { // something carried on from the previous chunk
+    const int unfilled = w - num_hanging;
+    if (seq_len < static_cast<UINT_64>(unfilled)) { // still can not be decoded
+      pvs_hanging = (pvs_hanging << seq_len) | sequence.get_bits(0, seq_len);
+      num_hanging += seq_len;
+      return ReturnStatus::SUCCESS;
     }
-    start_ind = unfilled;
+    const UINT_16 c =
+        _decode_char[(pvs_hanging << unfilled) | sequence.get_bits(0, unfilled)];
+    if (c == cInvalid_code) {
+      std::cerr << "Invalid Input: Invalid encoded character" << std::endl;
+      return ReturnStatus::ERR_INVALID_INPUT;
+    }
+    str.push_back(static_cast<char>(c));
+    pvs_hanging = 0;
+    num_hanging = 0;
+    pos = unfilled;
   }
-  auto str_size = (sequence.size() - start_ind) / _cEncoded_char_len;
-  str.reserve(str_size + 1); // +1 for the possible pvs
-  for (auto i = start_ind; i < sequence.size(); i += _cEncoded_char_len) {
-    c = sequence.substr(i, _cEncoded_char_len);
-    if (c.size() == _cEncoded_char_len) { // Add to string if can be decoded
-      str += (this->*fRevMapChar)(c);
-    } else {
-      pvs_hanging.assign(c);
+
+  // Room for all the characters and for the last (8-byte) store
+  const UINT_64 str_start = str.size();
+  str.resize(str_start + (seq_len - pos) / w + sizeof(UINT_64));
+  char *out = &str[str_start];
+  const UINT_64 lookup_mask = (static_cast<UINT_64>(1) << bits) - 1;
+  const int lookups_per_word = Bit_sequence::cWord_size / bits;
+  bool is_valid = true;
+  // A word at a time
+  for (; pos + Bit_sequence::cWord_size <= seq_len;
+       pos += lookups_per_word * bits) {
+    const UINT_64 word = sequence.get_bits(pos, Bit_sequence::cWord_size);
+    for (int l = 1; l <= lookups_per_word; ++l) {
+      const UINT_64 entry = _decode_table[(word >> (Bit_sequence::cWord_size -
+                                                    l * bits)) &
+                                          lookup_mask];
+      std::memcpy(out, &entry, sizeof(entry));
+      out += symbols;
+      is_valid &= ((entry >> 56) == static_cast<UINT_64>(symbols));
     }
   }
+  // A lookup at a time
+  for (; pos + bits <= seq_len; pos += bits) {
+    const UINT_64 entry = _decode_table[sequence.get_bits(pos, bits)];
+    std::memcpy(out, &entry, sizeof(entry));
+    out += symbols;
+    is_valid &= ((entry >> 56) == static_cast<UINT_64>(symbols));
+  }
+  // An encoded character at a time
+  for (; pos + w <= seq_len; pos += w) {
+    const UINT_16 c = _decode_char[sequence.get_bits(pos, w)];
+    *out++ = static_cast<char>(c);
+    is_valid &= (c != cInvalid_code);
+  }
+  str.resize(out - str.data());
+  if (!is_valid) {
+    std::cerr << "Invalid Input: Invalid encoded character" << std::endl;
+    return ReturnStatus::ERR_INVALID_INPUT;
+  }
+  if (pos < seq_len) { // not enough bits to be decoded
+    num_hanging = static_cast<int>(seq_len - pos);
+    pvs_hanging = sequence.get_bits(pos, num_hanging);
+  }
   return ReturnStatus::SUCCESS;
 }
 
-std::string Parser::binary_to_dna(const std::string &str) const {
-  std::string dna_seq;
-  dna_seq.resize(str.size());
+template <class Alphabet>
+ReturnStatus
+BasicParser<Alphabet>::append_reverse_complement(const SEQUENCE &sequence,
+                                                 SEQUENCE &rc) const {
+  const int len = code_len();
+  if (Alphabet::complement(0) < 0) {
+    std::cerr << "Invalid Input: Alphabet has no complement (only DNA has)"
+              << std::endl;
+    return ReturnStatus::ERR_INVALID_INPUT;
+  }
+  if (sequence.size() % len != 0) {
+    std::cerr << "Invalid Input: Sequence of partial encoded characters"
+              << std::endl;
+    return ReturnStatus::ERR_INVALID_INPUT;
+  }
+  // Complement of every code
+  std::vector<UINT_64> complement(static_cast<std::size_t>(1) << len);
+  for (std::size_t code = 0; code < complement.size(); ++code) {
+    complement[code] = Alphabet::complement(static_cast<int>(code));
+  }
+  rc.reserve(rc.size() + sequence.size());
+  for (UINT_64 pos = sequence.size(); pos != 0; pos -= len) {
+    rc.append(complement[sequence.get_bits(pos - len, len)], len);
+  }
+  return ReturnStatus::SUCCESS;
+}
 
-  std::transform(str.begin(), str.end(), dna_seq.begin(),
-                 [](char c) { return (c == '0') ? ('A') : ('C'); });
+std::string Parser::binary_to_dna(const SEQUENCE &seq) const {
+  std::string dna_seq;
+  dna_seq.resize(seq.size());
+  for (UINT_64 i = 0; i < seq.size(); ++i) {
+    dna_seq[i] = seq[i] ? 'C' : 'A';
+  }
   return dna_seq;
 }
 
-std::string Parser::dna_to_binary(const std::string &str) const {
-  std::string bin_seq;
-  bin_seq.resize(str.size());
-  std::transform(str.begin(), str.end(), bin_seq.begin(),
-                 [](char c) { return (c == 'A') ? ('0') : ('1'); });
+SEQUENCE Parser::dna_to_binary(const std::string &str) const {
+  SEQUENCE bin_seq;
+  bin_seq.reserve(str.size());
+  for (char c : str) {
+    bin_seq.push_back(c != 'A');
+  }
   return bin_seq;
 }
 
 //////////////////////// private ////////////////////////
 
-bool Parser::is_valid_char_general(const char c) const {
-  return static_cast<bool>(std::isprint(c));
-  return true;
+template <class Alphabet>
+int BasicParser<Alphabet>::char_code(const char c) const {
+  return Alphabet::code(c);
 }
 
-// Assumes will always be a valid character
-ENCODED_CHAR Parser::map_char_general(const char c) const {
-  int pos = static_cast<int>(c);
-  // std::cout << "INT CHAR : c i: " << c << " " << pos << std::endl;
-  std::string str = (std::bitset<8>(pos)).to_string();
-  ENCODED_CHAR coded_char = str;
-  return coded_char;
+// The user given alphabet is known only at run-time
+template <> int BasicParser<SelAlphabet>::char_code(const char c) const {
+  const auto pos = _cAlphabet.find(c);
+  return (pos == std::string::npos) ? -1 : static_cast<int>(pos);
 }
 
-char Parser::reverse_map_char_general(const ENCODED_CHAR c) const {
-  int index = std::stoi(c, nullptr, 2); // change to int of base 2
-  char decoded_char = static_cast<char>(index);
-  return decoded_char;
-}
-
-bool Parser::is_valid_char_select(const char c) const {
-  auto pos = _cAlphabet.find(c);
-  if (pos != std::string::npos) {
-    return true;
+template <class Alphabet> void BasicParser<Alphabet>::build_encode_table() {
+  /* Encoding table */
+  for (int i = 0; i < 256; ++i) {
+    const char c = static_cast<char>(i);
+    const int code = char_code(c);
+    if (Alphabet::cSkip_spaces && isspace(i)) {
+      _encode_table[i] = cSkip_code;
+    } else if (code >= 0) {
+      _encode_table[i] = static_cast<UINT_16>(code);
+    } else {
+      _encode_table[i] = cInvalid_code;
+    }
   }
-  return false;
-}
 
-// Assumes will always be a valid character
-ENCODED_CHAR Parser::map_char_select(const char c) const {
-  int pos = _cAlphabet.find(c);
-  std::string str = (std::bitset<8>(pos)).to_string();
-  ENCODED_CHAR coded_char = str.substr(8 - _cEncoded_char_len);
-  return coded_char;
-}
-
-char Parser::reverse_map_char_select(const ENCODED_CHAR c) const {
-  int index = std::stoi(c, nullptr, 2); // change to int of base 2
-  char decoded_char = _cAlphabet[index];
-  return decoded_char;
+  /* SIMD tables */
+  _simd_encoder = SimdEncoder::NONE;
+  _nibble_code.fill(0);
+  _lo_class.fill(0);
+  _hi_class.fill(0);
+  if (Alphabet::cType == AlphabetType::GEN) {
+    _simd_encoder = SimdEncoder::BYTE;
+    return;
+  }
+  if (code_len() > 4) { // 16 codes must fit in 64 bits
+    return;
+  }
+  // The code must be a function of the low nibble;
+  // valid[hi] = set of the low nibbles of the valid characters with that hi
+  std::array<int, 16> lo_code;
+  lo_code.fill(-1);
+  std::array<UINT_16, 16> valid{};
+  for (int i = 0; i < 256; ++i) {
+    const UINT_16 code = _encode_table[i];
+    if (code & (cSkip_code | cInvalid_code)) {
+      continue;
+    }
+    const int lo = i & 0x0F;
+    const int hi = i >> 4;
+    if (lo_code[lo] != -1 && lo_code[lo] != code) {
+      return; // not a function of the low nibble
+    }
+    lo_code[lo] = code;
+    valid[hi] |= (1 << lo);
+  }
+  // Each distinct set of low nibbles gets one of the 8 bits of class
+  std::vector<UINT_16> classes;
+  for (int hi = 0; hi < 16; ++hi) {
+    if (valid[hi] == 0) {
+      continue;
+    }
+    auto it = std::find(classes.begin(), classes.end(), valid[hi]);
+    const int k = static_cast<int>(it - classes.begin());
+    if (it == classes.end()) {
+      if (k == cByte_Size) {
+        _lo_class.fill(0);
+        _hi_class.fill(0);
+        return; // too many classes
+      }
+      classes.push_back(valid[hi]);
+    }
+    _hi_class[hi] = static_cast<UINT_8>(1 << k);
+    for (int lo = 0; lo < 16; ++lo) {
+      if (valid[hi] & (1 << lo)) {
+        _lo_class[lo] |= static_cast<UINT_8>(1 << k);
+      }
+    }
+  }
+  for (int lo = 0; lo < 16; ++lo) {
+    _nibble_code[lo] = static_cast<UINT_8>(lo_code[lo] == -1 ? 0 : lo_code[lo]);
+  }
+  _simd_encoder = SimdEncoder::NIBBLE;
 }
 
-bool Parser::is_valid_char_dna(const char c) const {
-  bool result = false;
-  switch (std::toupper(c)) {
-  case 'A':
-  case 'C':
-  case 'G':
-  case 'T':
-  case 'N':
-    result = true;
+template <class Alphabet> void BasicParser<Alphabet>::build_decode_table() {
+  const int w = code_len();
+  const int symbols = decode_symbols();
+  const int bits_per_lookup = decode_bits();
+  /* Single encoded characters */
+  _decode_char.assign(static_cast<std::size_t>(1) << w, cInvalid_code);
+  for (int i = 0; i < 256; ++i) {
+    const UINT_16 code = _encode_table[i];
+    if (!(code & (cSkip_code | cInvalid_code)) &&
+        _decode_char[code] == cInvalid_code) {
+      _decode_char[code] = static_cast<UINT_16>(i);
+    }
   }
-  return result;
-}
 
-// Assumes will always be a valid character
-ENCODED_CHAR Parser::map_char_dna(const char c) const {
-  ENCODED_CHAR result;
-  switch (std::toupper(c)) {
-  case 'A':
-    result = "000";
-    break;
-  case 'C':
-    result = "001";
-    break;
-  case 'G':
-    result = "010";
-    break;
-  case 'T':
-    result = "011";
-    break;
-  case 'N':
-    result = "100";
-    break;
+  /* Several encoded characters per lookup (@see decode_symbols) */
+  const UINT_64 char_mask = (static_cast<UINT_64>(1) << w) - 1;
+  _decode_table.resize(static_cast<std::size_t>(1) << bits_per_lookup);
+  for (UINT_64 bits = 0; bits < _decode_table.size(); ++bits) {
+    UINT_64 entry = 0;
+    int num_valid = 0;
+    bool is_valid = true;
+    for (int k = 0; k < symbols; ++k) {
+      const UINT_16 c =
+          _decode_char[(bits >> ((symbols - 1 - k) * w)) & char_mask];
+      is_valid &= (c != cInvalid_code);
+      if (is_valid) {
+        entry |= static_cast<UINT_64>(static_cast<UINT_8>(c)) << (cByte_Size * k);
+        ++num_valid;
+      }
+    }
+    _decode_table[bits] = entry | (static_cast<UINT_64>(num_valid) << 56);
   }
-  return result;
 }
 
-char Parser::reverse_map_char_dna(const ENCODED_CHAR c) const {
-  char result;
-  if (c == "000") {
-    result = 'A';
-  } else if (c == "001") {
-    result = 'C';
-  } else if (c == "010") {
-    result = 'G';
-  } else if (c == "011") {
-    result = 'T';
-  } else if (c == "100") {
-    result = 'N';
+template <class Alphabet>
+template <class OUT>
+ReturnStatus BasicParser<Alphabet>::encode_scalar(const char *str,
+                                                  const UINT_64 len,
+                                                  OUT &sequence) const {
+  const int w = code_len();
+  // Codes are collected in an integer and appended together
+  UINT_64 acc = 0;
+  int acc_len = 0;
+  for (UINT_64 i = 0; i < len; ++i) {
+    const UINT_16 code = _encode_table[static_cast<UINT_8>(str[i])];
+    if (code & cSkip_code) {
+      // Ignore
+    } else if (code & cInvalid_code) {
+      sequence.append(acc, acc_len);
+      std::cerr << "Invalid Input: Invalid character: " << str[i] << std::endl;
+      return ReturnStatus::ERR_INVALID_INPUT;
+    } else {
+      if (acc_len + w > Bit_sequence::cWord_size) {
+        sequence.append(acc, acc_len);
+        acc = 0;
+        acc_len = 0;
+      }
+      acc = (acc << w) | code;
+      acc_len += w;
+    }
   }
-  return result;
+  sequence.append(acc, acc_len);
+  return ReturnStatus::SUCCESS;
 }
 
-bool Parser::is_valid_char_prot(const char c) const {
-  bool result = false;
-  switch (std::toupper(c)) {
-  case 'A':
-  case 'C':
-  case 'D':
-  case 'E':
-  case 'F':
-  case 'G':
-  case 'H':
-  case 'I':
-  case 'K':
-  case 'L':
-  case 'M':
-  case 'N':
-  case 'O':
-  case 'P':
-  case 'Q':
-  case 'R':
-  case 'S':
-  case 'T':
-  case 'U':
-  case 'V':
-  case 'W':
-  case 'Y':
-    result = true;
-    break;
-  }
-  return result;
+#ifdef __SSSE3__
+/** Shuffle (for _mm_shuffle_epi8) moving the bytes of an 8-byte half whose bit
+ * is set in the index to the front and zeroing the rest. */
+static const std::array<UINT_64, 256> &compaction_shuffles() {
+  static const std::array<UINT_64, 256> shuffles = []() {
+    std::array<UINT_64, 256> table;
+    for (int mask = 0; mask < 256; ++mask) {
+      UINT_64 shuffle = 0;
+      int k = 0;
+      for (int b = 0; b < cByte_Size; ++b) {
+        if (mask & (1 << b)) {
+          shuffle |= static_cast<UINT_64>(b) << (cByte_Size * k++);
+        }
+      }
+      for (; k < cByte_Size; ++k) {
+        shuffle |= static_cast<UINT_64>(0x80) << (cByte_Size * k);
+      }
+      table[mask] = shuffle;
+    }
+    return table;
+  }();
+  return shuffles;
 }
 
-ENCODED_CHAR Parser::map_char_prot(const char c) const {
-  ENCODED_CHAR result;
-  switch (std::toupper(c)) {
-  case 'A':
-    result = "00000";
-    break;
-  case 'C':
-    result = "00001";
-    break;
-  case 'D':
-    result = "00010";
-    break;
-  case 'E':
-    result = "00011";
-    break;
-  case 'F':
-    result = "00100";
-    break;
-  case 'G':
-    result = "00101";
-    break;
-  case 'H':
-    result = "00110";
-    break;
-  case 'I':
-    result = "00111";
-    break;
-  case 'K':
-    result = "01000";
-    break;
-  case 'L':
-    result = "01001";
-    break;
-  case 'M':
-    result = "01010";
-    break;
-  case 'N':
-    result = "01011";
-    break;
-  case 'O':
-    result = "01100";
-    break;
-  case 'P':
-    result = "01101";
-    break;
-  case 'Q':
-    result = "01110";
-    break;
-  case 'R':
-    result = "01111";
-    break;
-  case 'S':
-    result = "10000";
-    break;
-  case 'T':
-    result = "10001";
-    break;
-  case 'U':
-    result = "10010";
-    break;
-  case 'V':
-    result = "10011";
-    break;
-  case 'W':
-    result = "10100";
-    break;
-  case 'Y':
-    result = "10101";
-    break;
+template <class Alphabet>
+template <class OUT>
+UINT_64 BasicParser<Alphabet>::encode_simd(const char *str, const UINT_64 len,
+                                           OUT &sequence) const {
+  UINT_64 i = 0;
+  if (_simd_encoder == SimdEncoder::BYTE) {
+    // Every byte is its own code: only the validity is checked
+    const __m128i below = _mm_set1_epi8(0x1F);
+    const __m128i above = _mm_set1_epi8(0x7F);
+    for (; i + cSimd_block <= len; i += cSimd_block) {
+      const __m128i in =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + i));
+      const __m128i ok = _mm_and_si128(_mm_cmpgt_epi8(in, below),
+                                       _mm_cmplt_epi8(in, above));
+      if (_mm_movemask_epi8(ok) != 0xFFFF) {
+        break;
+      }
+      UINT_64 words[2];
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(words), in);
+      sequence.append(__builtin_bswap64(words[0]), Bit_sequence::cWord_size);
+      sequence.append(__builtin_bswap64(words[1]), Bit_sequence::cWord_size);
+    }
+  } else if (_simd_encoder == SimdEncoder::NIBBLE) {
+    const int w = code_len();
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i code_lut =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(_nibble_code.data()));
+    const __m128i lo_lut =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(_lo_class.data()));
+    const __m128i hi_lut =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(_hi_class.data()));
+    // Multipliers to combine neighbouring codes: pairs, then pairs of pairs
+    const __m128i mul_pairs = _mm_set1_epi16(static_cast<short>((1 << 8) | (1 << w)));
+    const __m128i mul_quads = _mm_set1_epi32((1 << 16) | (1 << (2 * w)));
+    const __m128i half_offset = _mm_set_epi64x(0x0808080808080808LL, 0);
+    const auto &shuffles = compaction_shuffles();
+
+    for (; i + cSimd_block <= len; i += cSimd_block) {
+      const __m128i in =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + i));
+      const __m128i lo = _mm_and_si128(in, nibble);
+      const __m128i hi = _mm_and_si128(_mm_srli_epi16(in, 4), nibble);
+      const __m128i cls = _mm_and_si128(_mm_shuffle_epi8(lo_lut, lo),
+                                        _mm_shuffle_epi8(hi_lut, hi));
+      const int valid = ~_mm_movemask_epi8(_mm_cmpeq_epi8(cls, zero)) & 0xFFFF;
+      const __m128i space = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8(' ')),
+                       _mm_cmpeq_epi8(in, _mm_set1_epi8('\n'))),
+          _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('\r')),
+                       _mm_cmpeq_epi8(in, _mm_set1_epi8('\t'))));
+      const int spaces = _mm_movemask_epi8(space);
+      if ((valid | spaces) != 0xFFFF) {
+        break; // something else: left for the table
+      }
+      __m128i codes = _mm_shuffle_epi8(code_lut, lo);
+      if (spaces != 0) { // strip white-spaces in each half
+        const int keep = valid & ~spaces;
+        const __m128i shuffle =
+            _mm_add_epi8(_mm_set_epi64x(shuffles[keep >> cByte_Size],
+                                        shuffles[keep & 0xFF]),
+                         half_offset);
+        codes = _mm_shuffle_epi8(codes, shuffle);
+      }
+      // Four lanes of four codes each, first code most significant
+      const __m128i quads =
+          _mm_madd_epi16(_mm_maddubs_epi16(codes, mul_pairs), mul_quads);
+      UINT_32 lanes[4];
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), quads);
+      if (spaces == 0) {
+        sequence.append((static_cast<UINT_64>(lanes[0]) << (12 * w)) |
+                            (static_cast<UINT_64>(lanes[1]) << (8 * w)) |
+                            (static_cast<UINT_64>(lanes[2]) << (4 * w)) |
+                            lanes[3],
+                        16 * w);
+      } else {
+        const int keep = valid & ~spaces;
+        for (int half = 0; half < 2; ++half) {
+          const int k = __builtin_popcount((keep >> (cByte_Size * half)) & 0xFF);
+          const UINT_64 bits =
+              (static_cast<UINT_64>(lanes[2 * half]) << (4 * w)) |
+              lanes[2 * half + 1];
+          sequence.append(bits >> ((cByte_Size - k) * w), k * w);
+        }
+      }
+    }
   }
-  return result;
+  return i;
 }
+#else
+template <class Alphabet>
+template <class OUT>
+UINT_64 BasicParser<Alphabet>::encode_simd(const char *str, const UINT_64 len,
+                                           OUT &sequence) const {
+  return 0;
+}
+#endif
 
-// TODO: Take care of codes not in the actual alphabet
-char Parser::reverse_map_char_prot(const ENCODED_CHAR c) const {
-  char result;
-  if (c == "00000") {
-    result = 'A';
-  } else if (c == "00001") {
-    result = 'C';
-  } else if (c == "00010") {
-    result = 'D';
-  } else if (c == "00011") {
-    result = 'E';
-  } else if (c == "00100") {
-    result = 'F';
-  } else if (c == "00101") {
-    result = 'G';
-  } else if (c == "00110") {
-    result = 'H';
-  } else if (c == "00111") {
-    result = 'I';
-  } else if (c == "01000") {
-    result = 'K';
-  } else if (c == "01001") {
-    result = 'L';
-  } else if (c == "01010") {
-    result = 'M';
-  } else if (c == "01011") {
-    result = 'N';
-  } else if (c == "01100") {
-    result = 'O';
-  } else if (c == "01101") {
-    result = 'P';
-  } else if (c == "01110") {
-    result = 'Q';
-  } else if (c == "01111") {
-    result = 'R';
-  } else if (c == "10000") {
-    result = 'S';
-  } else if (c == "10001") {
-    result = 'T';
-  } else if (c == "10010") {
-    result = 'U';
-  } else if (c == "10011") {
-    result = 'V';
-  } else if (c == "10100") {
-    result = 'W';
-  } else if (c == "10101") {
-    result = 'Y';
-  }
 
-  return result;
-}
+//////////////////////// instantiations ////////////////////////
+
+template class BasicParser<DnaAlphabet>;
+template class BasicParser<ProtAlphabet>;
+template class BasicParser<GenAlphabet>;
+template class BasicParser<SelAlphabet>;
 
 } // end namespace
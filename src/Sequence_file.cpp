@@ -0,0 +1,110 @@
+/**
+   mawcd: Codec based on Minimal Absent Words
+   Copyright (C) 2017 Ritu Kundu, Panagiotis Charalampopoulos, and Solon P.
+Pissis
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+
+/** Implements class Sequence_file
+ */
+#include <algorithm>
+#include <cstdio>
+
+#include "../include/Sequence_file.hpp"
+
+namespace mawcd {
+
+const UINT_64 Sequence_file::cBuffer_bits;
+
+Sequence_file::~Sequence_file() { remove(); }
+
+ReturnStatus Sequence_file::create(const std::string &filename) {
+  remove();
+  _file.open(filename, std::ios::in | std::ios::out | std::ios::trunc |
+                           std::ios::binary);
+  if (!_file.is_open()) {
+    std::cerr << "Cannot create file " << filename << " \n";
+    return ReturnStatus::ERR_FILE_OPEN;
+  }
+  _filename = filename;
+  return ReturnStatus::SUCCESS;
+}
+
+ReturnStatus Sequence_file::append(const SEQUENCE &bits) {
+  _pending.append(bits);
+  return (_pending.size() >= cBuffer_bits) ? flush() : ReturnStatus::SUCCESS;
+}
+
+ReturnStatus Sequence_file::read(const UINT_64 pos, const UINT_64 len,
+                                 SEQUENCE &bits) {
+  const int w = Bit_sequence::cWord_size;
+  bits.clear();
+  bits.reserve(len);
+  const UINT_64 end = pos + len;
+  /* The bits written to the file, a word at a time */
+  const UINT_64 file_end = std::min(end, _flushed);
+  if (pos < file_end) {
+    const UINT_64 first = pos / w;
+    std::vector<Bit_sequence::WORD> words((file_end - 1) / w - first + 1);
+    _file.seekg(first * sizeof(Bit_sequence::WORD));
+    _file.read(reinterpret_cast<char *>(words.data()),
+               words.size() * sizeof(Bit_sequence::WORD));
+    if (!_file) {
+      _file.clear();
+      std::cerr << "Cannot read file " << _filename << " \n";
+      return ReturnStatus::ERR_FILE_OPEN;
+    }
+    for (UINT_64 p = pos; p < file_end;) {
+      const int offset = static_cast<int>(p % w);
+      const int take = static_cast<int>(std::min<UINT_64>(w - offset,
+                                                          file_end - p));
+      bits.append((words[p / w - first] << offset) >> (w - take), take);
+      p += take;
+    }
+  }
+  /* The pending ones */
+  if (end > _flushed) {
+    const UINT_64 from = std::max(pos, _flushed) - _flushed;
+    bits.append(_pending.slice(from, end - _flushed - from));
+  }
+  return ReturnStatus::SUCCESS;
+}
+
+void Sequence_file::remove() {
+  if (!_filename.empty()) {
+    _file.close();
+    std::remove(_filename.c_str());
+    _filename.clear();
+  }
+  _pending.clear();
+  _flushed = 0;
+}
+
+//////////////////////// private ////////////////////////
+ReturnStatus Sequence_file::flush() {
+  const UINT_64 num_words = _pending.size() / Bit_sequence::cWord_size;
+  _file.seekp(0, std::ios::end);
+  _file.write(reinterpret_cast<const char *>(_pending.words().data()),
+              num_words * sizeof(Bit_sequence::WORD));
+  if (!_file) {
+    _file.clear();
+    std::cerr << "Cannot write file " << _filename << " \n";
+    return ReturnStatus::ERR_FILE_OPEN;
+  }
+  const UINT_64 written = num_words * Bit_sequence::cWord_size;
+  _pending = _pending.slice(written, _pending.size() - written);
+  _flushed += written;
+  return ReturnStatus::SUCCESS;
+}
+
+} // end namespace
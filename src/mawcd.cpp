@@ -19,6 +19,8 @@ Pissis
 
 #include <cstdlib>
 #include <fstream>
+#include <memory>
+#include <sdsl/config.hpp>
 
 #include "../include/Anti_dictionary.hpp"
 #include "../include/Codec.hpp"
@@ -33,7 +35,17 @@ using namespace mawcd;
 /** Function to create anti-dictionary.
  * */
 ReturnStatus create_ad(const Parser &parser, const std::string &in_filename,
-                       const std::string &ad_filename);
+                       const std::string &ad_filename,
+                       const AdOptions &options, const bool is_corpus,
+                       const bool is_both_strands);
+
+/** Function to update anti-dictionary with new sequences.
+ * */
+ReturnStatus update_ad(const Parser &parser, const std::string &in_filename,
+                       const std::string &old_filename,
+                       const std::string &ad_filename,
+                       const AdOptions &options, const bool is_corpus,
+                       const bool is_both_strands);
 
 // TODO: Take care of codes not in the actual alphabet
 int main(int argc, char **argv) {
@@ -45,33 +57,41 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  /* Create Parser */
-  std::string alphabet;
+  /* Create Parser (specialised for the alphabet once and for all) */
+  std::unique_ptr<Parser> parser_ptr;
   if (flags.alphabet_type == AlphabetType::DNA) { // DNA
-    alphabet = cDNAAlphabet;
+    parser_ptr.reset(new DnaParser());
   } else if (flags.alphabet_type == AlphabetType::PROT) { // protien
-    alphabet = cPROTAlphabet;
+    parser_ptr.reset(new ProtParser());
   } else if (flags.alphabet_type == AlphabetType::SEL) { // user-defined
-    alphabet = flags.selected_alphabet;
+    parser_ptr.reset(new SelParser(flags.selected_alphabet));
+  } else { // general
+    parser_ptr.reset(new GenParser());
   }
-  const Parser &parser = (flags.alphabet_type == AlphabetType::GEN)
-                             ? (Parser())
-                             : (Parser(flags.alphabet_type, alphabet));
+  const Parser &parser = *parser_ptr;
 
   if (flags.mode == Mode::AD) { // Create Anti-dictionary
-    create_ad(parser, flags.input_filename, flags.anti_dictionary_filename);
+    const ReturnStatus status =
+        create_ad(parser, flags.input_filename, flags.anti_dictionary_filename,
+                  flags.ad_options, flags.is_corpus, flags.is_both_strands);
+    if (status != ReturnStatus::SUCCESS) {
+      return static_cast<int>(status);
+    }
+  } else if (flags.mode == Mode::ADUPDATE) { // Update Anti-dictionary
+    const ReturnStatus status =
+        update_ad(parser, flags.input_filename, flags.old_input_filename,
+                  flags.anti_dictionary_filename, flags.ad_options,
+                  flags.is_corpus, flags.is_both_strands);
+    if (status != ReturnStatus::SUCCESS) {
+      return static_cast<int>(status);
+    }
   } else { // compression or decompression
     ReturnStatus status;
     /* Read and initialise Anti-dictionary */
-    std::string filename = flags.anti_dictionary_filename;
-    std::ifstream adfile(filename, std::ios::binary);
-    if (!adfile.is_open()) {
-      std::cerr << "Cannot open anti-dictionary file \n";
-      return static_cast<int>(ReturnStatus::ERR_FILE_OPEN);
-    }
     Anti_dictionary ad{};
-    // Initialise AD
-    status = ad.read_binary(adfile);
+    // Initialise AD (mapped in memory)
+    status = ad.load_binary(flags.anti_dictionary_filename,
+                            flags.is_succinct_lookup);
     if (status != ReturnStatus::SUCCESS) {
       return static_cast<int>(status);
     }
@@ -80,7 +100,7 @@ int main(int argc, char **argv) {
 #endif
 
     /* Create Codec */
-    Codec codec(ad);
+    Codec codec(ad, flags.com_options);
 
     if (flags.mode == Mode::COM) { // Compress single file
       status = codec.compress_file(parser, flags.input_filename);
@@ -124,27 +144,44 @@ int main(int argc, char **argv) {
   }       // com/decom ended
 }
 /** @brief Creates the anti-dictionary of the sequence in the given input file
- * and save it in the given output file.
+ * (or of the sequences of the files it names) and save it in the given output
+ * file.
  *
  * Input file:
- * - Read each line, encodes it, converts into DNA alphabet (0 to A and 1 to
- * C) (as required by maw-tool).
- * - This temporary file (deleted at the end) is given to create
- * Anti_dictionary.
+ * - Read each line and encodes it (appending to the encoded sequence).
+ * - The encoded sequence is given to create Anti_dictionary (maws are
+ * computed in memory, or in external memory with
+ * options.is_external_memory: the sequence is then encoded into a file of
+ * options.scratch_dir and never held in memory).
  * - The Anti-dictionary is then saved as the output file.
  *
+ * Corpus (is_corpus): the input file names the training files (new line
+ * separated); each one is encoded in turn (appending to the encoded sequence)
+ * as a document of its own, so that no word spans two files (@see
+ * Anti_dictionary::create). No merged copy of the files is made.
+ *
+ * Both strands (is_both_strands, DNA only): the reverse complement of each
+ * sequence is added as a document of its own (@see encode_documents), so that
+ * a sequence read from either strand is compressed as well.
+ *
  * @param parser reference to the Parser instance given for encoding the
  * sequence.
- * @param in_filename name of the input file containing the sequence.
+ * @param in_filename name of the input file containing the sequence (or the
+ * names of the training files).
  * @param ad_filename name of the output filein which the anti-dictionary will
  * be saved.
+ * @param options options for the creation of the anti-dictionary.
+ * @param is_corpus whether the input file names the training files.
+ * @param is_both_strands whether the reverse complements are added.
  *
  * @return execution status // SUCCESS if input is valid, otherwise
  * corresponding error code after logging the error.
  *
  */
 ReturnStatus create_ad(const Parser &parser, const std::string &in_filename,
-                       const std::string &ad_filename) {
+                       const std::string &ad_filename,
+                       const AdOptions &options, const bool is_corpus,
+                       const bool is_both_strands) {
   ReturnStatus status;
   /* Open AD file */
   std::ofstream adfile(ad_filename, std::ios::binary);
@@ -153,51 +190,120 @@ ReturnStatus create_ad(const Parser &parser, const std::string &in_filename,
     return ReturnStatus::ERR_FILE_OPEN;
   }
 
-  /* Read Input file */
-  std::ifstream infile(in_filename);
-  if (!infile.is_open()) {
-    std::cerr << "Cannot open input file " << in_filename << " \n";
-    return ReturnStatus::ERR_FILE_OPEN;
-  }
-  std::string line;
-  // Get the sequence
-  std::getline(infile, line);
-  if (line.empty()) {
-    std::cerr << "No Input: Empty File: " << std::endl;
-    return ReturnStatus::ERR_INVALID_INPUT;
-  }
-  /* Open temporary file to be used by maw tool */
-  std::string temp_seq_file = "temp_seq_file";
-  std::ofstream tempfile(temp_seq_file);
-  tempfile << "> dummy" << std::endl;
-  int lineNum = 0;
-  do {
-    ++lineNum;
-    std::string seq_name;
-    std::string seq_value;
-    if (!line.empty()) {
-      line.shrink_to_fit();
-      // std::cout << "LINE Read: " << line <<std::endl;
-      /* Encode the line */
-      SEQUENCE en_sequence;
-      parser.encode_from_string(line, en_sequence);
-      // std::cout << "ENCODED Read: " << en_sequence <<std::endl;
-      /* Transform the sequence to DNA (required for maw tool) */
-      auto dna_seq = parser.binary_to_dna(en_sequence);
-      // std::cout << "DNA Read: " << dna_seq <<std::endl;
-      tempfile << dna_seq << std::endl;
-    }
-  } while (std::getline(infile, line)); // sequence ends
+  /* Encode the sequences, one document each */
+  std::vector<UINT_64> doc_start;
   Anti_dictionary ad{};
-  status = ad.create(temp_seq_file, parser);
+  if (options.is_external_memory) {
+    Sequence_file en_sequence;
+    status = en_sequence.create(sdsl::cache_file_name(
+        "mawcd_input", sdsl::cache_config(true, options.scratch_dir)));
+    if (status == ReturnStatus::SUCCESS) {
+      status = encode_documents(parser, in_filename, is_corpus,
+                                is_both_strands, en_sequence, doc_start);
+    }
+    if (status == ReturnStatus::SUCCESS) {
+      status = ad.create(en_sequence, doc_start, options);
+    }
+  } else {
+    SEQUENCE en_sequence;
+    status = encode_documents(parser, in_filename, is_corpus, is_both_strands,
+                              en_sequence, doc_start);
+    if (status == ReturnStatus::SUCCESS) {
+      status = ad.create(en_sequence, doc_start, options);
+    }
+  }
   if (status != ReturnStatus::SUCCESS) {
     return status;
   }
-  // delete temp temp file
-  remove(temp_seq_file.c_str());
   /* Save the anti-dictionary */
-  ad.write_binary(adfile);
+  status = ad.write_binary(adfile, options.is_compact);
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
 
   std::cout << "AD created successfully: " << std::endl;
   return ReturnStatus::SUCCESS;
 }
+
+/** @brief Updates the anti-dictionary of the given file with the sequence in
+ * the given input file (or the sequences of the files it names) and save it
+ * in a new file.
+ *
+ * The anti-dictionary is loaded and updated (@see Anti_dictionary::update)
+ * with the sequences encoded as by create_ad (in memory, whatever
+ * options.is_external_memory: the new sequences are scanned as well). The updated anti-dictionary
+ * (which has a new id unless no key changed) is saved in
+ * <ad_filename><cExt_upd>; the given file is left as is for decompressing the
+ * files compressed with it.
+ *
+ * @param parser reference to the Parser instance given for encoding the
+ * sequence.
+ * @param in_filename name of the input file containing the new sequence (or
+ * the names of the new files).
+ * @param old_filename name of the input file of the earlier sequences (as
+ * in_filename; empty if not given), from which no maw occurring is added.
+ * @param ad_filename name of the file of the anti-dictionary to update.
+ * @param options options for the update of the anti-dictionary.
+ * @param is_corpus whether the input file names the new files.
+ * @param is_both_strands whether the reverse complements are added.
+ *
+ * @return execution status // SUCCESS if input is valid, otherwise
+ * corresponding error code after logging the error.
+ *
+ * @see cExt_upd
+ */
+ReturnStatus update_ad(const Parser &parser, const std::string &in_filename,
+                       const std::string &old_filename,
+                       const std::string &ad_filename,
+                       const AdOptions &options, const bool is_corpus,
+                       const bool is_both_strands) {
+  ReturnStatus status;
+  /* Load the anti-dictionary */
+  Anti_dictionary ad{};
+  status = ad.load_binary(ad_filename);
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
+  const UINT_32 old_id = ad.get_id();
+
+  /* Encode the new sequences, one document each */
+  SEQUENCE en_sequence;
+  std::vector<UINT_64> doc_start;
+  status = encode_documents(parser, in_filename, is_corpus, is_both_strands,
+                            en_sequence, doc_start);
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
+  /* The earlier sequences, if given, to add only the maws absent there */
+  SEQUENCE old_sequence;
+  std::vector<UINT_64> old_doc_start;
+  if (!old_filename.empty() && options.is_adding_maws) {
+    status = encode_documents(parser, old_filename, is_corpus,
+                              is_both_strands, old_sequence, old_doc_start);
+    if (status != ReturnStatus::SUCCESS) {
+      return status;
+    }
+  }
+  status = ad.update(en_sequence, doc_start, options, old_sequence,
+                     old_doc_start);
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
+
+  /* Save the updated anti-dictionary */
+  std::string upd_filename(ad_filename + cExt_upd);
+  std::ofstream adfile(upd_filename, std::ios::binary);
+  if (!adfile.is_open()) {
+    std::cerr << "Cannot create anti-dictionary file " << upd_filename
+              << " \n";
+    return ReturnStatus::ERR_FILE_OPEN;
+  }
+  status = ad.write_binary(adfile, options.is_compact);
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
+
+  std::cout << "AD updated successfully: " << upd_filename << " (id " << old_id
+            << " -> " << ad.get_id() << ")" << std::endl;
+  return ReturnStatus::SUCCESS;
+}
@@ -16,6 +16,9 @@ Pissis
 
 /** Defines some helper functions */
 
+#include <fstream>
+
+#include "../include/Parser.hpp"
 #include "../include/utilDefs.hpp"
 
 namespace mawcd {
@@ -26,6 +29,21 @@ static struct option long_options[] = {
     {"selected-alphabet", optional_argument, NULL, 's'},
     {"input-file", required_argument, NULL, 'i'},
     {"antidictionary-file", required_argument, NULL, 'd'},
+    {"multi-length", no_argument, NULL, 'l'},
+    {"max-states", required_argument, NULL, 'p'},
+    {"mem-limit", required_argument, NULL, 'M'},
+    {"threads", required_argument, NULL, 't'},
+    {"external-memory", no_argument, NULL, 'e'},
+    {"scratch-dir", required_argument, NULL, 'T'},
+    {"succinct", no_argument, NULL, 'S'},
+    {"max-keys", required_argument, NULL, 'b'},
+    {"gain", no_argument, NULL, 'g'},
+    {"corpus", no_argument, NULL, 'c'},
+    {"compact", no_argument, NULL, 'z'},
+    {"add-maws", no_argument, NULL, 'n'},
+    {"old-input", required_argument, NULL, 'o'},
+    {"reverse-complement", no_argument, NULL, 'r'},
+    {"block-size", required_argument, NULL, 'k'},
     {"help", no_argument, NULL, 'h'},
     {NULL, 0, NULL, 0}};
 
@@ -38,7 +56,7 @@ ReturnStatus decodeFlags(int argc, char *argv[], struct InputFlags &flags) {
   std::string mode;
 
   /* initialisation */
-  while ((opt = getopt_long(argc, argv, "m:a:s:i:d:h", long_options,
+  while ((opt = getopt_long(argc, argv, "m:a:s:i:d:hlp:M:t:eT:Sb:gczno:rk:", long_options,
                             nullptr)) != -1) {
     switch (opt) {
     case 'm':
@@ -53,6 +71,8 @@ ReturnStatus decodeFlags(int argc, char *argv[], struct InputFlags &flags) {
         flags.mode = Mode::BCOM;
       } else if (mode == "BDECOM") {
         flags.mode = Mode::BDECOM;
+      } else if (mode == "ADUPDATE") {
+        flags.mode = Mode::ADUPDATE;
       } else {
         std::cerr << "Invalid command: wrong mode: " << std::endl;
         return (ReturnStatus::ERR_ARGS);
@@ -69,7 +89,7 @@ ReturnStatus decodeFlags(int argc, char *argv[], struct InputFlags &flags) {
       } else if (alph == "SEL") {
         flags.alphabet_type = AlphabetType::SEL;
       } else if (alph == "GEN") {
-        flags.alphabet_type = AlphabetType::SEL;
+        flags.alphabet_type = AlphabetType::GEN;
       } else {
         std::cerr << "Invalid command: wrong alphabet type: " << std::endl;
         return (ReturnStatus::ERR_ARGS);
@@ -92,6 +112,101 @@ ReturnStatus decodeFlags(int argc, char *argv[], struct InputFlags &flags) {
       args++;
       break;
 
+    case 'l':
+      flags.ad_options.is_multi_length = true;
+      break;
+
+    case 'p':
+      try {
+        flags.ad_options.max_states = std::stoull(optarg);
+      } catch (const std::exception &) {
+        std::cerr << "Invalid command: wrong maximum number of states: "
+                  << std::endl;
+        return (ReturnStatus::ERR_ARGS);
+      }
+      break;
+
+    case 'M':
+      try {
+        flags.ad_options.max_memory = std::stoull(optarg) << 20; // MB
+      } catch (const std::exception &) {
+        std::cerr << "Invalid command: wrong memory limit: " << std::endl;
+        return (ReturnStatus::ERR_ARGS);
+      }
+      break;
+
+    case 't':
+      try {
+        flags.ad_options.num_threads = std::stoi(optarg);
+      } catch (const std::exception &) {
+        flags.ad_options.num_threads = -1;
+      }
+      if (flags.ad_options.num_threads < 1) {
+        std::cerr << "Invalid command: wrong number of threads: " << std::endl;
+        return (ReturnStatus::ERR_ARGS);
+      }
+      flags.com_options.num_threads = flags.ad_options.num_threads;
+      break;
+
+    case 'e':
+      flags.ad_options.is_external_memory = true;
+      break;
+
+    case 'T':
+      flags.ad_options.scratch_dir = std::string(optarg);
+      break;
+
+    case 'S':
+      flags.is_succinct_lookup = true;
+      break;
+
+    case 'b':
+      try {
+        flags.ad_options.max_keys = std::stoull(optarg);
+      } catch (const std::exception &) {
+        std::cerr << "Invalid command: wrong maximum number of keys: "
+                  << std::endl;
+        return (ReturnStatus::ERR_ARGS);
+      }
+      break;
+
+    case 'g':
+      flags.ad_options.is_gain_selection = true;
+      break;
+
+    case 'c':
+      flags.is_corpus = true;
+      break;
+
+    case 'z':
+      flags.ad_options.is_compact = true;
+      break;
+
+    case 'n':
+      flags.ad_options.is_adding_maws = true;
+      break;
+
+    case 'o':
+      flags.old_input_filename = std::string(optarg);
+      break;
+
+    case 'r':
+      flags.is_both_strands = true;
+      break;
+
+    case 'k':
+      try {
+        flags.com_options.block_size = std::stoull(optarg);
+      } catch (const std::exception &) {
+        flags.com_options.block_size = 0;
+      }
+      if (flags.com_options.block_size < cMin_block_size) {
+        std::cerr << "Invalid command: wrong block size (at least "
+                  << cMin_block_size << "): " << std::endl;
+        return (ReturnStatus::ERR_ARGS);
+      }
+      break;
+
     case 'h':
       return (ReturnStatus::HELP);
     }
@@ -118,6 +233,12 @@ ReturnStatus decodeFlags(int argc, char *argv[], struct InputFlags &flags) {
   } else if (alph.empty()) {
     std::cerr << "Invalid command: Alphabet type is required." << std::endl;
     return (ReturnStatus::ERR_ARGS);
+  } else if (flags.is_both_strands &&
+             flags.alphabet_type != AlphabetType::DNA) {
+    std::cerr << "Invalid command: Reverse complement is only for the DNA "
+                 "alphabet."
+              << std::endl;
+    return (ReturnStatus::ERR_ARGS);
   } else {
     return (ReturnStatus::SUCCESS);
   }
@@ -133,7 +254,9 @@ void usage(void) {
                "\n\t\t\t\t\t\t or `COM' for compression of single file "
                "\n\t\t\t\t\t\t or `DECOM' for decompression of single file "
                "\n\t\t\t\t\t\t or `BCOM' for compression of many files "
-               "\n\t\t\t\t\t\t or `BDECOM' for decompression of many files. \n\n";
+               "\n\t\t\t\t\t\t or `BDECOM' for decompression of many files "
+               "\n\t\t\t\t\t\t or `ADUPDATE' for update of anti-dictionary "
+               "with new sequences. \n\n";
   std::cout << "  -a, --alphabet \t\t <str> \t \t `DNA' for nucleotide sequences"
                "\n\t\t\t\t\t\t or `PROT' for protein  sequences "
                "\n\t\t\t\t\t\t or `SEL' for user-defined "
@@ -141,15 +264,282 @@ void usage(void) {
   std::cout
       << "  -i, --input-file \t\t <str> \t \t Input file  name  "
          "\n\t\t\t\t\t\t(uncompressed file when mode is `COM'; compressed file when mode is `DECOM'; "
-         "\n\t\t\t\t\t\t a file containing names of the files to compress or decompress in batch mode [one name on each line]).\n\n";
+         "\n\t\t\t\t\t\t a file containing names of the files to compress or decompress in batch mode [one name on each line]; "
+         "\n\t\t\t\t\t\t new sequence when mode is `ADUPDATE').\n\n";
 
   std::cout << "  -d, --antidictionary-file \t <str> \t \t Anti-dictionary file  name "
-               "\n\t\t\t\t\t\t(created when mode is `AD' and read when mode is any other).\n\n";
+               "\n\t\t\t\t\t\t(created when mode is `AD' and read when mode is any other; "
+               "\n\t\t\t\t\t\t updated one saved in <name>.upd when mode is `ADUPDATE').\n\n";
 
   std::cout << " Additional:\n";
   std::cout
       << "  -s, --selected-alphabet \t <str> \t \t case-sensitive alphabet  "
          "(required when alphabet is SEL). \n\n";
+  std::cout
+      << "  -l, --multi-length 		 	 	 keep maws of all lengths in the "
+         "anti-dictionary "
+         "\n\t\t\t\t\t\t(compiled into an automaton; used when mode is "
+         "`AD').\n\n";
+  std::cout
+      << "  -p, --max-states 		 <int> 	 	 maximum number of states of the "
+         "automaton "
+         "\n\t\t\t\t\t\t(most frequent contexts kept; 0 for no limit "
+         "[default]).\n\n";
+  std::cout
+      << "  -M, --mem-limit 		 <int> 	 	 maximum memory in MB for indexing "
+         "the sequence "
+         "\n\t\t\t\t\t\t(used when mode is `AD'; 0 for no limit "
+         "[default]).\n\n";
+  std::cout
+      << "  -t, --threads 		 	 <int> 	 	 number of threads "
+         "\n\t\t\t\t\t\t(used when mode is `AD', `COM' or `BCOM'; all "
+         "available [default]).\n\n";
+  std::cout
+      << "  -e, --external-memory 		 	 	 build the index of the sequence "
+         "on disk "
+         "\n\t\t\t\t\t\t(used when mode is `AD'; the memory used is "
+         "bounded by --mem-limit, "
+         "\n\t\t\t\t\t\t the disk used is about 12 bytes per "
+         "bit).\n\n";
+  std::cout
+      << "  -T, --scratch-dir 		 <str> 	 	 directory of the files of the "
+         "index "
+         "\n\t\t\t\t\t\t(used with --external-memory; current "
+         "directory [default]).\n\n";
+  std::cout
+      << "  -S, --succinct 		 	 	 look the keys up in compressed space "
+         "\n\t\t\t\t\t\t(smaller but slower; used when mode is not `AD'; "
+         "\n\t\t\t\t\t\t single-length anti-dictionary only).\n\n";
+  std::cout
+      << "  -b, --max-keys 		 <int> 	 	 maximum number of keys in the "
+         "anti-dictionary "
+         "\n\t\t\t\t\t\t(those of highest gain kept; used when mode is "
+         "`AD'; 0 for no limit [default]).\n\n";
+  std::cout
+      << "  -g, --gain 		 	 	 select the maws of all lengths by their "
+         "own gain "
+         "\n\t\t\t\t\t\t(multi-length anti-dictionary; used when mode is "
+         "`AD').\n\n";
+  std::cout
+      << "  -c, --corpus 		 	 	 input file names the training files "
+         "[one name on each line] "
+         "\n\t\t\t\t\t\t(one anti-dictionary for all; no word spans two "
+         "files; used when mode is `AD' or `ADUPDATE').\n\n";
+  std::cout
+      << "  -z, --compact 		 	 	 save the anti-dictionary compactly "
+         "(keys only, coded) "
+         "\n\t\t\t\t\t\t(smaller file; its lookup structure is built when "
+         "loaded; used when mode is `AD' or `ADUPDATE').\n\n";
+  std::cout
+      << "  -n, --add-maws 		 	 	 add the maws of positive gain of the "
+         "new sequences "
+         "\n\t\t\t\t\t\t(only those absent from the earlier ones; within "
+         "--max-keys and --max-states; "
+         "\n\t\t\t\t\t\t used when mode is `ADUPDATE').\n\n";
+  std::cout
+      << "  -o, --old-input 		 <str> 	 	 input file of the earlier "
+         "sequences (as -i) "
+         "\n\t\t\t\t\t\t(maws occurring there are not added; used with "
+         "--add-maws).\n\n";
+  std::cout
+      << "  -r, --reverse-complement 	 	 	 add the reverse complement of "
+         "each sequence "
+         "\n\t\t\t\t\t\t(both strands compressed alike; DNA only; used when "
+         "mode is `AD' or `ADUPDATE').\n\n";
+  std::cout
+      << "  -k, --block-size 		 <int> 	 	 number of characters of a block "
+         "of the compressed file "
+         "\n\t\t\t\t\t\t(blocks decompressed together; used when mode is "
+         "`COM' or `BCOM'; 16777216 [default]).\n\n";
+}
+
+/* Bits of a sequence encoded (or read back) at a time in a file */
+static const UINT_64 cChunk_bits = UINT_64(1) << 23;
+
+/* Appends encoded bits to the sequence in memory or in a file */
+static ReturnStatus append_encoded(const SEQUENCE &encoded,
+                                   SEQUENCE &en_sequence) {
+  en_sequence.append(encoded);
+  return ReturnStatus::SUCCESS;
+}
+static ReturnStatus append_encoded(const SEQUENCE &encoded,
+                                   Sequence_file &en_sequence) {
+  return en_sequence.append(encoded);
+}
+
+/** @brief Appends the reverse complement of the last document of the encoded
+ * sequence (from start to its end), as a document of its own.
+ *
+ * @return execution status // ERR_INVALID_INPUT if the alphabet has no
+ * complement.
+ */
+static ReturnStatus append_other_strand(const Parser &parser,
+                                        const UINT_64 start,
+                                        SEQUENCE &en_sequence) {
+  SEQUENCE rc;
+  auto status = parser.append_reverse_complement(
+      en_sequence.slice(start, en_sequence.size() - start), rc);
+  if (status == ReturnStatus::SUCCESS) {
+    en_sequence.append(rc);
+  }
+  return status;
+}
+
+/** @brief As above, for a sequence in a file: the document is read back a
+ * chunk (of whole letters) at a time from its end.
+ */
+static ReturnStatus append_other_strand(const Parser &parser,
+                                        const UINT_64 start,
+                                        Sequence_file &en_sequence) {
+  const UINT_64 chunk = cChunk_bits - cChunk_bits % parser.get_code_len();
+  SEQUENCE letters;
+  for (UINT_64 end = en_sequence.size(); end > start;) {
+    const UINT_64 len = std::min(chunk, end - start);
+    end -= len;
+    auto status = en_sequence.read(end, len, letters);
+    SEQUENCE rc;
+    if (status == ReturnStatus::SUCCESS) {
+      status = parser.append_reverse_complement(letters, rc);
+    }
+    if (status == ReturnStatus::SUCCESS) {
+      status = append_encoded(rc, en_sequence);
+    }
+    if (status != ReturnStatus::SUCCESS) {
+      return status;
+    }
+  }
+  return ReturnStatus::SUCCESS;
 }
 
+/** @brief Encodes the sequence (all the lines) of the given input file,
+ * appending it to the encoded sequence.
+ *
+ * @param parser reference to the Parser instance given for encoding the
+ * sequence.
+ * @param in_filename name of the input file containing the sequence.
+ * @param en_sequence reference to the encoded sequence (in memory or in a
+ * file) to be appended to; the lines are encoded into a chunk of cChunk_bits
+ * appended at a time.
+ *
+ * @return execution status // SUCCESS if input is valid, otherwise
+ * corresponding error code after logging the error (ERR_INVALID_INPUT if the
+ * file has no letter).
+ *
+ */
+template <class OUT>
+ReturnStatus encode_file(const Parser &parser, const std::string &in_filename,
+                         OUT &en_sequence) {
+  ReturnStatus status;
+  /* Read Input file */
+  std::ifstream infile(in_filename);
+  if (!infile.is_open()) {
+    std::cerr << "Cannot open input file " << in_filename << " \n";
+    return ReturnStatus::ERR_FILE_OPEN;
+  }
+  std::string line;
+  const UINT_64 start = en_sequence.size();
+  /* Encode the sequence (all the lines) */
+  SEQUENCE encoded;
+  while (std::getline(infile, line)) {
+    if (!line.empty()) {
+      status = parser.encode_from_string(line, encoded);
+      if (status == ReturnStatus::SUCCESS && encoded.size() >= cChunk_bits) {
+        status = append_encoded(encoded, en_sequence);
+        encoded.clear();
+      }
+      if (status != ReturnStatus::SUCCESS) {
+        return status;
+      }
+    }
+  } // sequence ends
+  status = append_encoded(encoded, en_sequence);
+  if (status != ReturnStatus::SUCCESS) {
+    return status;
+  }
+  if (en_sequence.size() == start) {
+    std::cerr << "No Input: Empty File: " << in_filename << std::endl;
+    return ReturnStatus::ERR_INVALID_INPUT;
+  }
+  return ReturnStatus::SUCCESS;
+}
+
+/** @brief Encodes the sequence of the given input file, or if is_corpus the
+ * sequences of the files it names (new line separated), one document each:
+ * each one is appended to the encoded sequence in turn (@see encode_file).
+ * If is_both_strands, each one is followed by its reverse complement (the
+ * other strand), as a document of its own.
+ *
+ * @param parser reference to the Parser instance given for encoding the
+ * sequence.
+ * @param in_filename name of the input file containing the sequence (or the
+ * names of the files).
+ * @param is_corpus whether the input file names the files.
+ * @param is_both_strands whether the reverse complements are added.
+ * @param en_sequence reference to the encoded sequence (in memory or in a
+ * file) to be appended to.
+ * @param doc_start first bit of each document appended.
+ *
+ * @return execution status // SUCCESS if input is valid, otherwise
+ * corresponding error code after logging the error (ERR_INVALID_INPUT if no
+ * file is named, a file has no letter, or the alphabet has no complement).
+ *
+ */
+template <class OUT>
+ReturnStatus encode_documents(const Parser &parser,
+                              const std::string &in_filename,
+                              const bool is_corpus, const bool is_both_strands,
+                              OUT &en_sequence,
+                              std::vector<UINT_64> &doc_start) {
+  /* Names of the files */
+  std::vector<std::string> filenames;
+  if (is_corpus) {
+    std::ifstream infile(in_filename);
+    if (!infile.is_open()) {
+      std::cerr << "Cannot open input file " << in_filename << " \n";
+      return ReturnStatus::ERR_FILE_OPEN;
+    }
+    std::string line;
+    while (std::getline(infile, line)) {
+      if (!line.empty()) {
+        filenames.push_back(line);
+      }
+    }
+    if (filenames.empty()) {
+      std::cerr << "No Input: Empty File: " << std::endl;
+      return ReturnStatus::ERR_INVALID_INPUT;
+    }
+  } else {
+    filenames.push_back(in_filename);
+  }
+
+  for (const auto &filename : filenames) {
+    const UINT_64 start = en_sequence.size();
+    doc_start.push_back(start);
+    auto status = encode_file(parser, filename, en_sequence);
+    if (status != ReturnStatus::SUCCESS) {
+      return status;
+    }
+    if (is_both_strands) { // the other strand
+      doc_start.push_back(en_sequence.size());
+      status = append_other_strand(parser, start, en_sequence);
+      if (status != ReturnStatus::SUCCESS) {
+        return status;
+      }
+    }
+  }
+  return ReturnStatus::SUCCESS;
+}
+
+template ReturnStatus encode_file(const Parser &, const std::string &,
+                                  SEQUENCE &);
+template ReturnStatus encode_file(const Parser &, const std::string &,
+                                  Sequence_file &);
+template ReturnStatus encode_documents(const Parser &, const std::string &,
+                                       const bool, const bool, SEQUENCE &,
+                                       std::vector<UINT_64> &);
+template ReturnStatus encode_documents(const Parser &, const std::string &,
+                                       const bool, const bool,
+                                       Sequence_file &,
+                                       std::vector<UINT_64> &);
+
 } // end namespace
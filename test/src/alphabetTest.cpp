@@ -0,0 +1,306 @@
+#include <cctype>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "Parser.hpp"
+#include "globalDefs.hpp"
+#include "gtest/gtest.h"
+
+using namespace mawcd;
+
+/* Code of a character (-1 if it is skipped) as defined by the alphabet */
+typedef std::function<int(char)> CodeOf;
+
+/* Encoding of the text a character at a time (the characters must be valid) */
+static SEQUENCE expected_encoding(const std::string &text, const int code_len,
+                                  const CodeOf &code_of) {
+  SEQUENCE seq;
+  for (const char c : text) {
+    const int code = code_of(c);
+    if (code >= 0) {
+      seq.append(static_cast<UINT_64>(code), code_len);
+    }
+  }
+  return seq;
+}
+
+/* Random text of the letters, with white-spaces if they are given */
+static std::string random_letters(const std::size_t n, const unsigned seed,
+                                  const std::string &letters,
+                                  const std::string &spaces = std::string()) {
+  std::mt19937_64 rng(seed);
+  std::string text;
+  for (std::size_t i = 0; i < n; ++i) {
+    if (!spaces.empty() && rng() % 5 == 0) {
+      text += spaces[rng() % spaces.size()];
+    } else {
+      text += letters[rng() % letters.size()];
+    }
+  }
+  return text;
+}
+
+static const std::string cSpaces = " \n\t\r"; //< skipped by DNA, PROT and SEL
+
+static int dna_code(const char c) {
+  return isspace(static_cast<unsigned char>(c))
+             ? -1
+             : static_cast<int>(cDNAAlphabet.find(toupper(c)));
+}
+
+static int prot_code(const char c) {
+  return isspace(static_cast<unsigned char>(c))
+             ? -1
+             : static_cast<int>(
+                   std::string("ACDEFGHIKLMNOPQRSTUVWY").find(toupper(c)));
+}
+
+static int gen_code(const char c) { return static_cast<int>(c); }
+
+/* The letters of GEN */
+static std::string printable_ascii() {
+  std::string printable;
+  for (char c = ' '; c <= '~'; ++c) {
+    printable += c;
+  }
+  return printable;
+}
+
+/* Every length up to (a few) SIMD blocks, mostly not multiples of 16 */
+static void check_encoding(const Parser &parser, const std::string &letters,
+                           const std::string &spaces, const CodeOf &code_of) {
+  for (std::size_t n = 0; n <= 70; ++n) {
+    const std::string text = random_letters(n, 1 + n, letters, spaces);
+    SEQUENCE seq;
+    ASSERT_EQ(parser.encode_from_string(text, seq), ReturnStatus::SUCCESS)
+        << text;
+    EXPECT_EQ(seq, expected_encoding(text, parser.get_code_len(), code_of))
+        << text;
+  }
+}
+
+/* An invalid character anywhere (in a SIMD block or in the rest) */
+static void check_invalid(const Parser &parser, const std::string &letters,
+                          const char invalid) {
+  const std::string text = random_letters(40, 7, letters);
+  for (std::size_t i = 0; i < text.size(); ++i) {
+    std::string bad = text;
+    bad[i] = invalid;
+    SEQUENCE seq;
+    EXPECT_EQ(parser.encode_from_string(bad, seq),
+              ReturnStatus::ERR_INVALID_INPUT)
+        << i;
+  }
+}
+
+TEST(encoderTest, DnaNibble) {
+  const DnaParser parser;
+  check_encoding(parser, "ACGTNacgtn", cSpaces, dna_code);
+  check_invalid(parser, "ACGTN", 'X');
+  check_invalid(parser, "ACGTN", '\0');
+}
+
+TEST(encoderTest, GenByte) {
+  const std::string printable = printable_ascii();
+  const GenParser parser;
+  check_encoding(parser, printable, std::string(), gen_code);
+  check_invalid(parser, printable, '\n');
+  check_invalid(parser, printable, '\x7f');
+  check_invalid(parser, printable, '\x80');
+}
+
+TEST(encoderTest, ProtTable) {
+  const ProtParser parser;
+  check_encoding(parser, "ACDEFGHIKLMNOPQRSTUVWYacdefghiklmnopqrstuvwy",
+                 cSpaces, prot_code);
+  check_invalid(parser, "ACDEFGHIKLMNOPQRSTUVWY", 'B');
+  check_invalid(parser, "ACDEFGHIKLMNOPQRSTUVWY", '*');
+}
+
+/* Encoding in place at any position (from several parts, as the codec
+ * encodes its slices) gives the appended encoding */
+TEST(encoderTest, InPlace) {
+  const DnaParser parser;
+  const std::string text = random_letters(300, 13, "ACGTacgt", cSpaces);
+  SEQUENCE expected;
+  ASSERT_EQ(parser.encode_from_string(text, expected), ReturnStatus::SUCCESS);
+  EXPECT_EQ(parser.count_codes(text.data(), text.size()) * 3, expected.size());
+  for (const std::size_t cut : {0, 1, 17, 100, 299, 300}) {
+    SEQUENCE seq;
+    seq.resize(expected.size() + 5);
+    Bit_writer writer(seq, 5);
+    ASSERT_EQ(parser.encode_in_place(text.data(), cut, writer),
+              ReturnStatus::SUCCESS);
+    ASSERT_EQ(parser.encode_in_place(text.data() + cut, text.size() - cut,
+                                     writer),
+              ReturnStatus::SUCCESS);
+    EXPECT_EQ(writer.position(), seq.size());
+    EXPECT_EQ(seq.slice(5, expected.size()), expected) << cut;
+    EXPECT_EQ(seq.get_bits(0, 5), 0u);
+  }
+}
+
+/* The text as decoded: without the skipped characters, in upper case for
+ * the case-insensitive alphabets */
+static std::string expected_decoding(const std::string &text,
+                                     const bool is_upper,
+                                     const CodeOf &code_of) {
+  std::string decoded;
+  for (const char c : text) {
+    if (code_of(c) >= 0) {
+      decoded += is_upper ? static_cast<char>(toupper(c)) : c;
+    }
+  }
+  return decoded;
+}
+
+/* Decoding at once and in parts of random lengths (the bits of a partial
+ * character being carried on to the next part) */
+static void check_decoding(const Parser &parser, const std::string &letters,
+                           const bool is_upper, const CodeOf &code_of) {
+  std::mt19937_64 rng(11);
+  for (const std::size_t n : {0, 1, 5, 15, 17, 33, 64, 127, 1000, 4099}) {
+    const std::string text = random_letters(n, 3 + n, letters);
+    const std::string expected = expected_decoding(text, is_upper, code_of);
+    SEQUENCE seq;
+    ASSERT_EQ(parser.encode_from_string(text, seq), ReturnStatus::SUCCESS);
+
+    std::string whole;
+    UINT_64 pvs_hanging = 0;
+    int num_hanging = 0;
+    ASSERT_EQ(parser.decode_to_string(seq, pvs_hanging, num_hanging, whole),
+              ReturnStatus::SUCCESS);
+    EXPECT_EQ(whole, expected);
+    EXPECT_EQ(num_hanging, 0);
+
+    std::string parts;
+    for (UINT_64 pos = 0; pos < seq.size();) {
+      const UINT_64 len = std::min<UINT_64>(seq.size() - pos, 1 + rng() % 150);
+      ASSERT_EQ(parser.decode_to_string(seq.slice(pos, len), pvs_hanging,
+                                        num_hanging, parts),
+                ReturnStatus::SUCCESS);
+      pos += len;
+    }
+    EXPECT_EQ(parts, expected);
+    EXPECT_EQ(num_hanging, 0);
+  }
+}
+
+/* A code of no character anywhere (in a whole word or in the rest) */
+static void check_invalid_code(const Parser &parser,
+                               const std::string &letters,
+                               const UINT_64 invalid) {
+  const std::string text = random_letters(100, 5, letters);
+  SEQUENCE seq;
+  ASSERT_EQ(parser.encode_from_string(text, seq), ReturnStatus::SUCCESS);
+  const int w = parser.get_code_len();
+  for (std::size_t i = 0; i < text.size(); i += 7) {
+    SEQUENCE bad = seq.slice(0, i * w);
+    bad.append(invalid, w);
+    bad.append(seq.slice((i + 1) * w, seq.size() - (i + 1) * w));
+    std::string str;
+    UINT_64 pvs_hanging = 0;
+    int num_hanging = 0;
+    EXPECT_EQ(parser.decode_to_string(bad, pvs_hanging, num_hanging, str),
+              ReturnStatus::ERR_INVALID_INPUT)
+        << i;
+  }
+}
+
+TEST(decoderTest, Dna) {
+  const DnaParser parser;
+  check_decoding(parser, "ACGTNacgtn", true, dna_code);
+  check_invalid_code(parser, "ACGTN", 7);
+}
+
+TEST(decoderTest, Gen) {
+  const std::string printable = printable_ascii();
+  const GenParser parser;
+  check_decoding(parser, printable, false, gen_code);
+  check_invalid_code(parser, printable, 0x7f);
+  check_invalid_code(parser, printable, 0);
+}
+
+TEST(decoderTest, Prot) {
+  const ProtParser parser;
+  check_decoding(parser, "ACDEFGHIKLMNOPQRSTUVWYacdefghiklmnopqrstuvwy", true,
+                 prot_code);
+  check_invalid_code(parser, "ACDEFGHIKLMNOPQRSTUVWY", 22);
+  check_invalid_code(parser, "ACDEFGHIKLMNOPQRSTUVWY", 31);
+}
+
+/* Code of a character of the user given (case-sensitive) alphabet */
+static CodeOf sel_code(const std::string &alphabet) {
+  return [alphabet](const char c) {
+    return isspace(static_cast<unsigned char>(c))
+               ? -1
+               : static_cast<int>(alphabet.find(c));
+  };
+}
+
+TEST(parserTest, CodeLengths) {
+  EXPECT_EQ(DnaParser().get_code_len(), 3);
+  EXPECT_EQ(ProtParser().get_code_len(), 5);
+  EXPECT_EQ(GenParser().get_code_len(), 8);
+  EXPECT_EQ(SelParser("AB").get_code_len(), 1);
+  EXPECT_EQ(SelParser("ACGU").get_code_len(), 2);
+  EXPECT_EQ(SelParser("ACGUN").get_code_len(), 3);
+}
+
+/* Letters with distinct low nibbles (encoded in SIMD) */
+TEST(parserTest, SelNibble) {
+  const std::string alphabet = "ACGU";
+  const SelParser parser(alphabet);
+  check_encoding(parser, alphabet, cSpaces, sel_code(alphabet));
+  check_decoding(parser, alphabet, false, sel_code(alphabet));
+  check_invalid(parser, alphabet, 'a'); // case-sensitive
+  check_invalid(parser, alphabet, 'T');
+}
+
+/* Letters sharing low nibbles ('A' and 'Q', 'a' and 'q'): through the table */
+TEST(parserTest, SelTable) {
+  const std::string alphabet = "AQaqz";
+  const SelParser parser(alphabet);
+  check_encoding(parser, alphabet, cSpaces, sel_code(alphabet));
+  check_decoding(parser, alphabet, false, sel_code(alphabet));
+  check_invalid(parser, alphabet, 'Z');
+  check_invalid_code(parser, alphabet, 5);
+}
+
+/* More letters than fit in 4 bits */
+TEST(parserTest, SelLong) {
+  const std::string alphabet = "abcdefghijklmnopqrstuvwxyz0123456789";
+  const SelParser parser(alphabet);
+  EXPECT_EQ(parser.get_code_len(), 6);
+  check_encoding(parser, alphabet, cSpaces, sel_code(alphabet));
+  check_decoding(parser, alphabet, false, sel_code(alphabet));
+  check_invalid(parser, alphabet, 'A');
+  check_invalid_code(parser, alphabet, 63);
+}
+
+/* The same text through each parser (as chosen at run-time) */
+TEST(parserTest, EveryAlphabet) {
+  const std::string text = random_letters(1000, 9, "ACGT", cSpaces);
+  std::vector<std::unique_ptr<Parser>> parsers;
+  parsers.emplace_back(new DnaParser());
+  parsers.emplace_back(new ProtParser());
+  parsers.emplace_back(new SelParser("ACGT"));
+  for (const auto &parser : parsers) {
+    const int w = parser->get_code_len();
+    SEQUENCE seq;
+    ASSERT_EQ(parser->encode_from_string(text, seq), ReturnStatus::SUCCESS);
+    EXPECT_EQ(seq.size(), expected_decoding(text, true, dna_code).size() * w);
+    std::string decoded;
+    UINT_64 pvs_hanging = 0;
+    int num_hanging = 0;
+    ASSERT_EQ(parser->decode_to_string(seq, pvs_hanging, num_hanging, decoded),
+              ReturnStatus::SUCCESS);
+    EXPECT_EQ(decoded, expected_decoding(text, true, dna_code)) << w;
+  }
+  // GEN keeps the white-spaces but only the printable ones are valid
+  SEQUENCE seq;
+  EXPECT_EQ(GenParser().encode_from_string(text, seq),
+            ReturnStatus::ERR_INVALID_INPUT);
+}
@@ -0,0 +1,484 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "Anti_dictionary.hpp"
+#include "Codec.hpp"
+#include "Parser.hpp"
+#include "globalDefs.hpp"
+#include "testUtil.hpp"
+#include "utilDefs.hpp"
+#include "gtest/gtest.h"
+
+using namespace mawcd;
+using namespace mawcd_test;
+
+static void save(const Anti_dictionary &ad, const std::string &filename,
+                 const bool is_compact = false) {
+  std::ofstream file(filename, std::ios::binary);
+  ASSERT_EQ(ad.write_binary(file, is_compact), ReturnStatus::SUCCESS);
+}
+
+/* The compressed sequence, which depends on every lookup of the
+ * anti-dictionary */
+static SEQUENCE compressed(const Anti_dictionary &ad, const SEQUENCE &seq) {
+  Codec codec(ad);
+  KEY_TYPE suffix = 0;
+  bool is_contradicted = false;
+  const SEQUENCE comp_seq = codec.compress(seq, true, suffix, is_contradicted);
+  EXPECT_FALSE(is_contradicted);
+  return comp_seq;
+}
+
+/* Writes the anti-dictionary (normal or compact), loads it back and checks
+ * that it compresses seq as the original; then checks that a flipped byte of
+ * the payload, a truncated file and another version are rejected */
+static void check_round_trip(const Anti_dictionary &ad, const SEQUENCE &seq,
+                             const bool is_compact) {
+  const std::string filename =
+      is_compact ? "build/ad_test.compact.bin" : "build/ad_test.bin";
+  save(ad, filename, is_compact);
+  const SEQUENCE expected = compressed(ad, seq);
+  ASSERT_LT(expected.size(), seq.size());
+  {
+    Anti_dictionary loaded;
+    ASSERT_EQ(loaded.load_binary(filename), ReturnStatus::SUCCESS);
+    EXPECT_EQ(loaded.get_id(), ad.get_id());
+    EXPECT_EQ(loaded.get_ad_size(), ad.get_ad_size());
+    EXPECT_EQ(loaded.is_multi_length(), ad.is_multi_length());
+    EXPECT_TRUE(compressed(loaded, seq) == expected);
+  }
+  const std::string bytes = read_file(filename);
+  ASSERT_GT(bytes.size(), 64u);
+  {
+    std::string corrupt = bytes;
+    corrupt[64 + (corrupt.size() - 64) / 3] ^= 0x10;
+    write_file(filename, corrupt);
+    Anti_dictionary loaded;
+    EXPECT_EQ(loaded.load_binary(filename), ReturnStatus::ERR_INVALID_INPUT);
+  }
+  for (std::size_t size : {bytes.size() - 1, bytes.size() / 2,
+                           std::size_t(40)}) {
+    write_file(filename, bytes.substr(0, size));
+    Anti_dictionary loaded;
+    EXPECT_EQ(loaded.load_binary(filename), ReturnStatus::ERR_INVALID_INPUT);
+  }
+  {
+    std::string other_version = bytes;
+    other_version[8] = 9;
+    write_file(filename, other_version);
+    Anti_dictionary loaded;
+    EXPECT_EQ(loaded.load_binary(filename), ReturnStatus::ERR_INVALID_INPUT);
+  }
+  std::remove(filename.c_str());
+}
+
+TEST(antiDictionaryTest, SingleLengthRoundTrip) {
+  const SEQUENCE seq = random_sequence(20000, 3, 3);
+  Anti_dictionary ad;
+  ASSERT_EQ(ad.create(seq), ReturnStatus::SUCCESS);
+  ASSERT_FALSE(ad.is_multi_length());
+  ASSERT_GT(ad.get_ad_size(), 0);
+  check_round_trip(ad, seq, false);
+  check_round_trip(ad, seq, true);
+}
+
+TEST(antiDictionaryTest, MultiLengthRoundTrip) {
+  const SEQUENCE seq = random_sequence(20000, 5, 3);
+  AdOptions options;
+  options.is_multi_length = true;
+  Anti_dictionary ad;
+  ASSERT_EQ(ad.create(seq, options), ReturnStatus::SUCCESS);
+  ASSERT_TRUE(ad.is_multi_length());
+  check_round_trip(ad, seq, false);
+  check_round_trip(ad, seq, true);
+}
+
+TEST(antiDictionaryTest, SuccinctLookups) {
+  const SEQUENCE seq = random_sequence(20000, 7, 3);
+  Anti_dictionary ad;
+  ASSERT_EQ(ad.create(seq), ReturnStatus::SUCCESS);
+  save(ad, "build/ad_test.bin");
+  Anti_dictionary succinct;
+  ASSERT_EQ(succinct.load_binary("build/ad_test.bin", true),
+            ReturnStatus::SUCCESS);
+  ASSERT_FALSE(succinct.get_succinct().empty());
+  EXPECT_TRUE(compressed(succinct, seq) == compressed(ad, seq));
+  std::remove("build/ad_test.bin");
+}
+
+/* Compresses seq with the anti-dictionary and decompresses it back */
+static bool round_trips_one(const Anti_dictionary &ad, const SEQUENCE &seq) {
+  Codec codec(ad);
+  KEY_TYPE suffix = 0;
+  bool is_contradicted = false;
+  const SEQUENCE comp_seq = codec.compress(seq, true, suffix, is_contradicted);
+  if (is_contradicted) {
+    return false;
+  }
+  PACKED_SEQUENCE packed((comp_seq.size() + 7) / 8, 0);
+  for (UINT_64 i = 0; i < comp_seq.size(); ++i) {
+    if (comp_seq[i]) {
+      packed[i / 8] |= 0x80 >> (i % 8);
+    }
+  }
+  suffix = 0;
+  return codec.decompress(seq.size(), packed, true, suffix) == seq;
+}
+
+/* Each document on its own (as its file is compressed) */
+static bool round_trips(const Anti_dictionary &ad, const SEQUENCE &seq,
+                        const std::vector<UINT_64> &doc_start) {
+  for (std::size_t d = 0; d < doc_start.size(); ++d) {
+    const UINT_64 end =
+        (d + 1 < doc_start.size()) ? doc_start[d + 1] : seq.size();
+    if (!round_trips_one(ad, seq.slice(doc_start[d], end - doc_start[d]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Words of len bits occurring in the documents */
+static std::unordered_set<KEY_TYPE>
+words(const SEQUENCE &seq, const std::vector<UINT_64> &doc_start,
+      const int len) {
+  std::unordered_set<KEY_TYPE> found;
+  for (std::size_t d = 0; d < doc_start.size(); ++d) {
+    const UINT_64 end =
+        (d + 1 < doc_start.size()) ? doc_start[d + 1] : seq.size();
+    for (UINT_64 i = doc_start[d]; i + len <= end; ++i) {
+      found.insert(seq.get_bits(i, len));
+    }
+  }
+  return found;
+}
+
+/* Maws of a single-length anti-dictionary whose keys are among the
+ * candidates: the letter following a key is the other one */
+static std::unordered_set<KEY_TYPE>
+maws_of(const Anti_dictionary &ad,
+        const std::unordered_set<KEY_TYPE> &candidates) {
+  std::unordered_set<KEY_TYPE> maws;
+  char letter;
+  for (const KEY_TYPE key : candidates) {
+    if (ad.find_following_letter(key, letter)) {
+      maws.insert((key << 1) | (letter == '0'));
+    }
+  }
+  return maws;
+}
+
+/* Earlier and new sequences of an update (the new one of two documents) */
+static const SEQUENCE cOld_seq = random_sequence(20000, 61, 3);
+static const SEQUENCE cNew_seq = random_sequence(20000, 62, 3);
+static const std::vector<UINT_64> cOld_start(1, 0);
+static const std::vector<UINT_64> cNew_start{0, 7000};
+
+static AdOptions adding_maws(const bool is_multi_length) {
+  AdOptions options;
+  options.is_multi_length = is_multi_length;
+  options.is_adding_maws = true;
+  return options;
+}
+
+TEST(updateTest, RemovesOccurringMaws) {
+  Anti_dictionary ad;
+  ASSERT_EQ(ad.create(cOld_seq), ReturnStatus::SUCCESS);
+  const int k = ad.get_key_size();
+  auto candidates = words(cOld_seq, cOld_start, k);
+  const auto new_keys = words(cNew_seq, cNew_start, k);
+  candidates.insert(new_keys.begin(), new_keys.end());
+  const auto before = maws_of(ad, candidates);
+  const auto occurring = words(cNew_seq, cNew_start, k + 1);
+
+  ASSERT_EQ(ad.update(cNew_seq, cNew_start), ReturnStatus::SUCCESS);
+  EXPECT_EQ(ad.get_key_size(), k);
+  std::unordered_set<KEY_TYPE> expected;
+  for (const KEY_TYPE maw : before) {
+    if (occurring.count(maw) == 0) {
+      expected.insert(maw);
+    }
+  }
+  ASSERT_LT(expected.size(), before.size()); // some are removed
+  EXPECT_EQ(maws_of(ad, candidates), expected);
+  EXPECT_EQ(static_cast<std::size_t>(ad.get_ad_size()), expected.size());
+  EXPECT_TRUE(round_trips(ad, cOld_seq, cOld_start));
+  EXPECT_TRUE(round_trips(ad, cNew_seq, cNew_start));
+}
+
+TEST(updateTest, AddsMawsAbsentFromOldInput) {
+  Anti_dictionary removed_only;
+  ASSERT_EQ(removed_only.create(cOld_seq), ReturnStatus::SUCCESS);
+  ASSERT_EQ(removed_only.update(cNew_seq, cNew_start), ReturnStatus::SUCCESS);
+  Anti_dictionary ad;
+  ASSERT_EQ(ad.create(cOld_seq), ReturnStatus::SUCCESS);
+  ASSERT_EQ(ad.update(cNew_seq, cNew_start, adding_maws(false), cOld_seq,
+                      cOld_start),
+            ReturnStatus::SUCCESS);
+  EXPECT_GT(ad.get_ad_size(), removed_only.get_ad_size());
+
+  // every maw is absent from both the earlier and the new sequences
+  const int k = ad.get_key_size();
+  auto candidates = words(cOld_seq, cOld_start, k);
+  const auto new_keys = words(cNew_seq, cNew_start, k);
+  candidates.insert(new_keys.begin(), new_keys.end());
+  const auto maws = maws_of(ad, candidates);
+  EXPECT_EQ(maws.size(), static_cast<std::size_t>(ad.get_ad_size()));
+  const auto old_words = words(cOld_seq, cOld_start, k + 1);
+  const auto new_words = words(cNew_seq, cNew_start, k + 1);
+  for (const KEY_TYPE maw : maws) {
+    EXPECT_EQ(old_words.count(maw), 0u) << maw;
+    EXPECT_EQ(new_words.count(maw), 0u) << maw;
+  }
+  EXPECT_TRUE(round_trips(ad, cOld_seq, cOld_start));
+  EXPECT_TRUE(round_trips(ad, cNew_seq, cNew_start));
+}
+
+TEST(updateTest, SingleLengthAddsNothingWithoutOldInput) {
+  Anti_dictionary removed_only;
+  ASSERT_EQ(removed_only.create(cOld_seq), ReturnStatus::SUCCESS);
+  ASSERT_EQ(removed_only.update(cNew_seq, cNew_start), ReturnStatus::SUCCESS);
+  Anti_dictionary ad;
+  ASSERT_EQ(ad.create(cOld_seq), ReturnStatus::SUCCESS);
+  ASSERT_EQ(ad.update(cNew_seq, cNew_start, adding_maws(false)),
+            ReturnStatus::SUCCESS);
+  EXPECT_EQ(ad.get_ad_size(), removed_only.get_ad_size());
+  EXPECT_EQ(ad.get_id(), removed_only.get_id());
+}
+
+TEST(updateTest, MultiLengthRoundTrips) {
+  for (const bool is_old_input : {false, true}) {
+    Anti_dictionary removed_only;
+    AdOptions options;
+    options.is_multi_length = true;
+    ASSERT_EQ(removed_only.create(cOld_seq, options), ReturnStatus::SUCCESS);
+    ASSERT_EQ(removed_only.update(cNew_seq, cNew_start, options),
+              ReturnStatus::SUCCESS);
+    Anti_dictionary ad;
+    ASSERT_EQ(ad.create(cOld_seq, options), ReturnStatus::SUCCESS);
+    ASSERT_TRUE(round_trips(ad, cOld_seq, cOld_start));
+    ASSERT_FALSE(round_trips(ad, cNew_seq, cNew_start));
+    const SEQUENCE &old_seq = is_old_input ? cOld_seq : SEQUENCE();
+    ASSERT_EQ(ad.update(cNew_seq, cNew_start, adding_maws(true), old_seq,
+                        is_old_input ? cOld_start : std::vector<UINT_64>()),
+              ReturnStatus::SUCCESS);
+    EXPECT_GT(ad.get_ad_size(), removed_only.get_ad_size()) << is_old_input;
+    EXPECT_TRUE(round_trips(ad, cOld_seq, cOld_start)) << is_old_input;
+    EXPECT_TRUE(round_trips(ad, cNew_seq, cNew_start)) << is_old_input;
+  }
+}
+
+/* The other strand of a DNA text */
+static std::string reverse_complement(const std::string &dna) {
+  std::string rc(dna.rbegin(), dna.rend());
+  for (char &c : rc) {
+    c = (c == 'A') ? 'T' : (c == 'C') ? 'G' : (c == 'G') ? 'C' : 'A';
+  }
+  return rc;
+}
+
+TEST(antiDictionaryTest, BothStrands) {
+  const std::string dna = random_text(30000, 71);
+  write_file("build/strand_test.txt", in_lines(dna));
+  const DnaParser parser;
+  SEQUENCE forward;
+  SEQUENCE reverse;
+  ASSERT_EQ(parser.encode_from_string(dna, forward), ReturnStatus::SUCCESS);
+  ASSERT_EQ(parser.encode_from_string(reverse_complement(dna), reverse),
+            ReturnStatus::SUCCESS);
+
+  // both strands: either one compresses alike and round-trips
+  SEQUENCE seq;
+  std::vector<UINT_64> doc_start;
+  ASSERT_EQ(encode_documents(parser, "build/strand_test.txt", false, true, seq,
+                             doc_start),
+            ReturnStatus::SUCCESS);
+  ASSERT_EQ(doc_start, (std::vector<UINT_64>{0, forward.size()}));
+  EXPECT_TRUE(seq.slice(forward.size(), reverse.size()) == reverse);
+  Anti_dictionary both;
+  ASSERT_EQ(both.create(seq, doc_start), ReturnStatus::SUCCESS);
+  EXPECT_TRUE(round_trips(both, forward, {0}));
+  EXPECT_TRUE(round_trips(both, reverse, {0}));
+  const double forward_size = compressed(both, forward).size();
+  const double reverse_size = compressed(both, reverse).size();
+  EXPECT_LT(forward_size, forward.size());
+  EXPECT_NEAR(reverse_size / forward_size, 1.0, 0.05);
+
+  // the same built in external memory
+  Anti_dictionary external;
+  AdOptions options;
+  options.is_external_memory = true;
+  options.scratch_dir = "build";
+  ASSERT_EQ(external.create(seq, doc_start, options), ReturnStatus::SUCCESS);
+  EXPECT_EQ(external.get_id(), both.get_id());
+
+  // other alphabets have no complement
+  SEQUENCE prot;
+  std::vector<UINT_64> prot_start;
+  EXPECT_EQ(encode_documents(ProtParser(), "build/strand_test.txt", false,
+                             true, prot, prot_start),
+            ReturnStatus::ERR_INVALID_INPUT);
+  std::remove("build/strand_test.txt");
+}
+
+/* A file in the layout of the releases before the versioned one: keys of
+ * 30 bits (looked up in the hash-table) of one, two and four bytes */
+static std::string unversioned_file(const std::vector<UINT_32> &ad_0,
+                                    const std::vector<UINT_32> &ad_1) {
+  std::string bytes(1, 30);
+  std::vector<std::vector<UINT_32>> by_width[2];
+  for (int ad = 0; ad < 2; ++ad) {
+    by_width[ad].resize(3);
+    for (auto k : (ad == 0) ? ad_0 : ad_1) {
+      by_width[ad][(k <= 0xFF) ? 0 : (k <= 0xFFFF) ? 1 : 2].push_back(k);
+    }
+  }
+  auto put = [&bytes](const UINT_32 value, const int width) {
+    bytes.append(reinterpret_cast<const char *>(&value), width);
+  };
+  const int widths[3] = {1, 2, 4};
+  for (int w = 0; w < 3; ++w) {
+    for (int ad = 0; ad < 2; ++ad) {
+      put(by_width[ad][w].size(), widths[w]);
+    }
+  }
+  for (int ad = 0; ad < 2; ++ad) {
+    for (int w = 0; w < 3; ++w) {
+      for (auto k : by_width[ad][w]) {
+        put(k, widths[w]);
+      }
+    }
+  }
+  return bytes;
+}
+
+static void check_lookups(const Anti_dictionary &ad,
+                          const std::vector<UINT_32> &ad_0,
+                          const std::vector<UINT_32> &ad_1) {
+  char letter;
+  for (auto k : ad_0) {
+    EXPECT_TRUE(ad.find_following_letter(k, letter));
+    EXPECT_EQ(letter, '1');
+  }
+  for (auto k : ad_1) {
+    EXPECT_TRUE(ad.find_following_letter(k, letter));
+    EXPECT_EQ(letter, '0');
+  }
+  for (KEY_TYPE k : {6u, 301u, 0x3FFFFFFFu}) {
+    EXPECT_FALSE(ad.find_following_letter(k, letter));
+  }
+}
+
+TEST(antiDictionaryTest, UnversionedFile) {
+  const std::vector<UINT_32> ad_0{5, 300, 0x2ABCDEF0};
+  const std::vector<UINT_32> ad_1{7, 0x12345678, 0x3FFFFFFE};
+  const std::string bytes = unversioned_file(ad_0, ad_1);
+  write_file("build/ad_test.bin", bytes);
+  Anti_dictionary ad;
+  ASSERT_EQ(ad.load_binary("build/ad_test.bin"), ReturnStatus::SUCCESS);
+  EXPECT_EQ(ad.get_key_size(), 30);
+  EXPECT_EQ(ad.get_ad_size(), 6);
+  ASSERT_FALSE(ad.get_hash_table().empty());
+  check_lookups(ad, ad_0, ad_1);
+
+  // saved in the current format, it is mapped with the same lookups
+  save(ad, "build/ad_test.v2.bin");
+  Anti_dictionary mapped;
+  ASSERT_EQ(mapped.load_binary("build/ad_test.v2.bin"), ReturnStatus::SUCCESS);
+  EXPECT_EQ(mapped.get_id(), ad.get_id());
+  ASSERT_FALSE(mapped.get_hash_table().empty());
+  check_lookups(mapped, ad_0, ad_1);
+  std::remove("build/ad_test.v2.bin");
+
+  for (const std::string &corrupt :
+       {bytes.substr(0, bytes.size() - 1), bytes + '\0',
+        unversioned_file(ad_0, {0x40000000}), std::string(1, 33),
+        std::string(1, 0)}) {
+    write_file("build/ad_test.bin", corrupt);
+    Anti_dictionary loaded;
+    EXPECT_EQ(loaded.load_binary("build/ad_test.bin"),
+              ReturnStatus::ERR_INVALID_INPUT);
+  }
+  std::remove("build/ad_test.bin");
+}
+
+/* Checksum of the payload of a file (as Anti_dictionary writes it) */
+static UINT_64 checksum(const std::string &payload) {
+  const UINT_64 cMix = 0x9e3779b97f4a7c15ULL;
+  UINT_64 lanes[4] = {1, 2, 3, 4};
+  for (std::size_t i = 0; i < payload.size(); i += 4 * sizeof(UINT_64)) {
+    for (int j = 0; j < 4; ++j) {
+      UINT_64 word;
+      std::memcpy(&word, payload.data() + i + j * sizeof(word), sizeof(word));
+      lanes[j] = (lanes[j] ^ word) * cMix;
+      lanes[j] ^= lanes[j] >> 32;
+    }
+  }
+  UINT_64 sum = 0;
+  for (int j = 0; j < 4; ++j) {
+    sum = (sum ^ lanes[j]) * cMix;
+    sum ^= sum >> 32;
+  }
+  return sum;
+}
+
+/* A compact file (version 3) of keys of 10 bits with the given varints,
+ * with a valid header and checksum (@see Anti_dictionary::write_binary) */
+static std::string compact_file(const std::vector<UINT_8> &varints) {
+  std::string payload(varints.begin(), varints.end());
+  payload.resize((payload.size() + 31) / 32 * 32, '\0');
+  std::string header(64, '\0');
+  auto put = [&header](const std::size_t pos, const UINT_64 value,
+                       const int width) {
+    std::memcpy(&header[pos], &value, width);
+  };
+  std::memcpy(&header[0], "MAWCDAD", 8);
+  put(8, 3, 4);
+  put(12, 0x01020304, 4);
+  put(16, 10, 1);
+  put(17, sizeof(KEY_TYPE), 1);
+  put(32, cNum_table, 8);
+  put(48, payload.size(), 8);
+  put(56, checksum(payload), 8);
+  return header + payload;
+}
+
+TEST(antiDictionaryTest, CompactFile) {
+  // ad_0: 1, 5, 1005; ad_1: 2
+  write_file("build/ad_test.bin", compact_file({3, 1, 4, 0xE8, 0x07, 1, 2}));
+  Anti_dictionary ad;
+  ASSERT_EQ(ad.load_binary("build/ad_test.bin"), ReturnStatus::SUCCESS);
+  EXPECT_EQ(ad.get_key_size(), 10);
+  EXPECT_EQ(ad.get_ad_size(), 4);
+  char letter;
+  for (KEY_TYPE k : {1u, 5u, 1005u}) {
+    EXPECT_TRUE(ad.find_following_letter(k, letter));
+    EXPECT_EQ(letter, '1');
+  }
+  EXPECT_TRUE(ad.find_following_letter(2, letter));
+  EXPECT_EQ(letter, '0');
+  EXPECT_FALSE(ad.find_following_letter(3, letter));
+
+  const std::vector<std::vector<UINT_8>> corrupt{
+      {1, 1, 1, 0x80, 0x08},       // key longer than the key size
+      {2, 1, 0, 1, 2},             // same key twice
+      {3, 1, 4, 0xFB, 0x07, 1, 2}, // keys beyond the key size (1 + 4 + 1019)
+      {100, 1, 2},                 // more keys than bytes
+      std::vector<UINT_8>(32, 0x80)}; // varint cut by the end of the file
+  for (const auto &varints : corrupt) {
+    write_file("build/ad_test.bin", compact_file(varints));
+    Anti_dictionary loaded;
+    EXPECT_EQ(loaded.load_binary("build/ad_test.bin"),
+              ReturnStatus::ERR_INVALID_INPUT);
+  }
+  std::remove("build/ad_test.bin");
+}
+
+TEST(antiDictionaryTest, MissingFile) {
+  Anti_dictionary ad;
+  EXPECT_EQ(ad.load_binary("build/no_such_ad.bin"),
+            ReturnStatus::ERR_FILE_OPEN);
+}
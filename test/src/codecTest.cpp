@@ -0,0 +1,182 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Anti_dictionary.hpp"
+#include "Codec.hpp"
+#include "Parser.hpp"
+#include "globalDefs.hpp"
+#include "testUtil.hpp"
+#include "gtest/gtest.h"
+
+using namespace mawcd;
+using namespace mawcd_test;
+
+static const std::string cFilename = "build/codec_test.txt";
+static const std::string cCom_filename = cFilename + cExt_com;
+static const std::string cDecom_filename = cCom_filename + cExt_decom;
+
+static void put_64(std::string &bytes, const std::size_t pos,
+                   const UINT_64 value) {
+  std::memcpy(&bytes[pos], &value, sizeof(value));
+}
+
+static UINT_64 get_64(const std::string &bytes, const std::size_t pos) {
+  UINT_64 value;
+  std::memcpy(&value, &bytes[pos], sizeof(value));
+  return value;
+}
+
+class codecTest : public ::testing::TestWithParam<bool> {
+protected:
+  void SetUp() override {
+    _dna = random_text(30000, 11);
+    write_file(cFilename, in_lines(_dna));
+    SEQUENCE seq;
+    ASSERT_EQ(_parser.encode_from_string(_dna, seq), ReturnStatus::SUCCESS);
+    AdOptions options;
+    options.is_multi_length = GetParam();
+    ASSERT_EQ(_ad.create(seq, options), ReturnStatus::SUCCESS);
+    _options.block_size = 1000;
+  }
+  void TearDown() override {
+    std::remove(cFilename.c_str());
+    std::remove(cCom_filename.c_str());
+    std::remove(cDecom_filename.c_str());
+  }
+
+  /* Decompresses the given compressed file: it must be rejected as invalid
+   * and leave no decompressed file */
+  void expect_invalid(const std::string &com_bytes) {
+    write_file(cCom_filename, com_bytes);
+    Codec codec(_ad, _options);
+    EXPECT_EQ(codec.decompress_file(_parser, cCom_filename),
+              ReturnStatus::ERR_INVALID_INPUT);
+    EXPECT_FALSE(file_exists(cDecom_filename));
+  }
+
+  DnaParser _parser;
+  Anti_dictionary _ad;
+  ComOptions _options;
+  std::string _dna;
+};
+
+TEST_P(codecTest, RoundTrip) {
+  std::string first_bytes;
+  for (int threads : {1, 4}) {
+    _options.num_threads = threads;
+    Codec codec(_ad, _options);
+    ASSERT_EQ(codec.compress_file(_parser, cFilename), ReturnStatus::SUCCESS);
+    const std::string com_bytes = read_file(cCom_filename);
+    EXPECT_LT(com_bytes.size(), _dna.size());
+    // the blocks do not depend on the number of threads
+    if (first_bytes.empty()) {
+      first_bytes = com_bytes;
+    }
+    EXPECT_EQ(com_bytes, first_bytes) << threads;
+    ASSERT_EQ(codec.decompress_file(_parser, cCom_filename),
+              ReturnStatus::SUCCESS);
+    EXPECT_EQ(read_file(cDecom_filename), _dna);
+  }
+}
+
+/* Runs of white-spaces longer than a block: the slices encoded in parallel
+ * are cut far from where they would be without them, or are empty */
+TEST_P(codecTest, WhiteSpaces) {
+  std::string text;
+  for (std::size_t i = 0; i < _dna.size(); i += 700) {
+    const char space = (i % 3) ? '\n' : ' ';
+    text += _dna.substr(i, 700) + std::string(1 + i % 2500, space);
+  }
+  write_file(cFilename, text);
+  _options.num_threads = 4;
+  Codec codec(_ad, _options);
+  ASSERT_EQ(codec.compress_file(_parser, cFilename), ReturnStatus::SUCCESS);
+  ASSERT_EQ(codec.decompress_file(_parser, cCom_filename),
+            ReturnStatus::SUCCESS);
+  EXPECT_EQ(read_file(cDecom_filename), _dna);
+}
+
+TEST_P(codecTest, CorruptFile) {
+  Codec codec(_ad, _options);
+  ASSERT_EQ(codec.compress_file(_parser, cFilename), ReturnStatus::SUCCESS);
+  const std::string bytes = read_file(cCom_filename);
+  const std::size_t header_size = 24;
+  const std::size_t block = header_size; // header of the first block
+  const UINT_64 orig_size = get_64(bytes, 16);
+  ASSERT_GT(bytes.size(), block + 24);
+
+  expect_invalid(bytes.substr(0, bytes.size() - 1));
+  expect_invalid(bytes.substr(0, bytes.size() / 2));
+  expect_invalid(bytes.substr(0, header_size + 10));
+  expect_invalid(bytes.substr(0, 12));
+  {
+    std::string other_version = bytes;
+    other_version[8] = 7;
+    expect_invalid(other_version);
+  }
+  {
+    std::string no_bits = bytes;
+    put_64(no_bits, block, 0);
+    expect_invalid(no_bits);
+  }
+  {
+    std::string too_many_bits = bytes;
+    put_64(too_many_bits, block, orig_size + 1);
+    expect_invalid(too_many_bits);
+  }
+  {
+    std::string bad_context = bytes;
+    put_64(bad_context, block + 8, ~static_cast<UINT_64>(0));
+    expect_invalid(bad_context);
+  }
+  {
+    std::string too_many_bytes = bytes;
+    put_64(too_many_bytes, block + 16, bytes.size());
+    expect_invalid(too_many_bytes);
+  }
+}
+
+TEST_P(codecTest, OtherAntiDictionary) {
+  Codec codec(_ad, _options);
+  ASSERT_EQ(codec.compress_file(_parser, cFilename), ReturnStatus::SUCCESS);
+  SEQUENCE other_seq;
+  ASSERT_EQ(_parser.encode_from_string(random_text(30000, 12), other_seq),
+            ReturnStatus::SUCCESS);
+  AdOptions options;
+  options.is_multi_length = GetParam();
+  Anti_dictionary other;
+  ASSERT_EQ(other.create(other_seq, options), ReturnStatus::SUCCESS);
+  ASSERT_NE(other.get_id(), _ad.get_id());
+
+  // decompressed with another anti-dictionary
+  Codec other_codec(other, _options);
+  EXPECT_EQ(other_codec.decompress_file(_parser, cCom_filename),
+            ReturnStatus::ERR_INVALID_INPUT);
+  EXPECT_FALSE(file_exists(cDecom_filename));
+
+  // compressed with an anti-dictionary that does not describe the file
+  std::remove(cCom_filename.c_str());
+  EXPECT_EQ(other_codec.compress_file(_parser, cFilename),
+            ReturnStatus::ERR_INVALID_INPUT);
+}
+
+TEST_P(codecTest, UnwritableOutput) {
+  Codec codec(_ad, _options);
+  ASSERT_EQ(codec.compress_file(_parser, cFilename), ReturnStatus::SUCCESS);
+  // the decompressed file cannot be created where a directory is
+  ASSERT_EQ(mkdir(cDecom_filename.c_str(), 0755), 0);
+  EXPECT_EQ(codec.decompress_file(_parser, cCom_filename),
+            ReturnStatus::ERR_FILE_OPEN);
+  rmdir(cDecom_filename.c_str());
+  // nor the compressed one
+  std::remove(cCom_filename.c_str());
+  ASSERT_EQ(mkdir(cCom_filename.c_str(), 0755), 0);
+  EXPECT_EQ(codec.compress_file(_parser, cFilename),
+            ReturnStatus::ERR_FILE_OPEN);
+  rmdir(cCom_filename.c_str());
+}
+
+INSTANTIATE_TEST_CASE_P(singleAndMultiLength, codecTest,
+                        ::testing::Values(false, true));
@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <cstdio>
+#include <omp.h>
+#include <random>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "Maw_engine.hpp"
+#include "Parser.hpp"
+#include "globalDefs.hpp"
+#include "testUtil.hpp"
+#include "utilDefs.hpp"
+#include "gtest/gtest.h"
+
+using namespace mawcd;
+using namespace mawcd_test;
+
+/* A maw as reported by Maw_engine::for_each_maw */
+struct Reported {
+  KEY_TYPE key;
+  int key_len;
+  bool last;
+  UINT_64 freq;
+  bool operator<(const Reported &o) const {
+    return std::tie(key_len, key, last, freq) <
+           std::tie(o.key_len, o.key, o.last, o.freq);
+  }
+  bool operator==(const Reported &o) const {
+    return key == o.key && key_len == o.key_len && last == o.last &&
+           freq == o.freq;
+  }
+};
+
+/* Maws of 2 to max_len bits by brute force: words absent from the documents
+ * whose longest proper prefix (the key) and suffix occur; freq is the number
+ * of occurrences of the key */
+static std::vector<Reported>
+brute_force_maws(const SEQUENCE &seq, const std::vector<UINT_64> &doc_start,
+                 const int max_len) {
+  std::vector<std::unordered_map<KEY_TYPE, UINT_64>> occ(max_len + 1);
+  for (std::size_t d = 0; d < doc_start.size(); ++d) {
+    const UINT_64 end =
+        (d + 1 < doc_start.size()) ? doc_start[d + 1] : seq.size();
+    for (UINT_64 i = doc_start[d]; i < end; ++i) {
+      for (int len = 1; len <= max_len && i + len <= end; ++len) {
+        ++occ[len][seq.get_bits(i, len)];
+      }
+    }
+  }
+  std::vector<Reported> maws;
+  for (int len = 2; len <= max_len; ++len) {
+    for (const auto &key : occ[len - 1]) {
+      for (int last = 0; last < 2; ++last) {
+        const KEY_TYPE maw = (key.first << 1) | last;
+        if (occ[len].count(maw) == 0 &&
+            occ[len - 1].count(maw & key_mask(len - 1)) != 0) {
+          maws.push_back({key.first, len - 1, last == 1, key.second});
+        }
+      }
+    }
+  }
+  std::sort(maws.begin(), maws.end());
+  return maws;
+}
+
+/* Maws reported by the engine, in their order */
+static std::vector<Reported>
+engine_maws(const SEQUENCE &seq, const std::vector<UINT_64> &doc_start,
+            const int max_len, const AdOptions &options = AdOptions()) {
+  Maw_engine engine;
+  EXPECT_EQ(engine.build(seq, doc_start, options), ReturnStatus::SUCCESS);
+  std::vector<Reported> maws;
+  engine.for_each_maw(2, max_len, [&](const KEY_TYPE key, const int key_len,
+                                      const bool last, const UINT_64 freq) {
+    maws.push_back({key, key_len, last, freq});
+  });
+  return maws;
+}
+
+static std::vector<Reported> sorted(std::vector<Reported> maws) {
+  std::sort(maws.begin(), maws.end());
+  return maws;
+}
+
+static const std::vector<UINT_64> cWhole(1, 0); //< a single document
+
+TEST(mawEngineTest, SequenceMatchesBruteForce) {
+  for (unsigned seed = 1; seed <= 4; ++seed) {
+    const SEQUENCE seq = random_sequence(3000 + 500 * seed, seed);
+    const auto expected = brute_force_maws(seq, cWhole, 40);
+    ASSERT_FALSE(expected.empty());
+    EXPECT_EQ(sorted(engine_maws(seq, cWhole, 40)), expected);
+  }
+}
+
+TEST(mawEngineTest, BiasedSequenceMatchesBruteForce) {
+  const SEQUENCE seq = random_sequence(6000, 5, 3);
+  EXPECT_EQ(sorted(engine_maws(seq, cWhole, 40)),
+            brute_force_maws(seq, cWhole, 40));
+}
+
+TEST(mawEngineTest, ShortSequences) {
+  for (const std::string bits : {"0", "1", "01", "0000", "0110100110"}) {
+    const SEQUENCE seq(bits);
+    EXPECT_EQ(sorted(engine_maws(seq, cWhole, 12)),
+              brute_force_maws(seq, cWhole, 12));
+  }
+}
+
+/* First bit of each of the random documents of a sequence of n bits (some
+ * of them a single bit long) */
+static std::vector<UINT_64> random_documents(const UINT_64 n,
+                                             const unsigned seed) {
+  std::mt19937_64 rng(seed);
+  std::vector<UINT_64> doc_start(1, 0);
+  for (UINT_64 p = 1 + rng() % 300; p < n; p += 1 + rng() % 300) {
+    doc_start.push_back(p);
+    if (rng() % 8 == 0 && p + 1 < n) {
+      doc_start.push_back(++p);
+    }
+  }
+  return doc_start;
+}
+
+TEST(mawEngineTest, DocumentsMatchBruteForce) {
+  for (unsigned seed = 1; seed <= 4; ++seed) {
+    const SEQUENCE seq = random_sequence(5000, 40 + seed);
+    const auto doc_start = random_documents(seq.size(), seed);
+    ASSERT_GT(doc_start.size(), 10u);
+    // no maw may span two documents: they differ from those of the whole
+    const auto expected = brute_force_maws(seq, doc_start, 40);
+    EXPECT_NE(expected, brute_force_maws(seq, cWhole, 40));
+    EXPECT_EQ(sorted(engine_maws(seq, doc_start, 40)), expected);
+  }
+}
+
+TEST(invalidInputTest, EmptyOrInvalidDocuments) {
+  const SEQUENCE seq = random_sequence(100, 43);
+  for (const std::vector<UINT_64> &doc_start :
+       {std::vector<UINT_64>{1, 50}, std::vector<UINT_64>{0, 50, 50},
+        std::vector<UINT_64>{0, 60, 50}, std::vector<UINT_64>{0, 100}}) {
+    Maw_engine engine;
+    EXPECT_EQ(engine.build(seq, doc_start), ReturnStatus::ERR_INVALID_INPUT);
+  }
+}
+
+/* The files of a corpus (and the file naming them) in the build directory */
+static std::string corpus(const std::vector<std::string> &texts) {
+  std::string names;
+  for (std::size_t f = 0; f < texts.size(); ++f) {
+    const std::string filename = "build/corpus_" + std::to_string(f) + ".txt";
+    write_file(filename, in_lines(texts[f]));
+    names += filename + '\n';
+  }
+  write_file("build/corpus.txt", names);
+  return "build/corpus.txt";
+}
+
+TEST(mawEngineTest, CorpusMatchesBruteForce) {
+  std::vector<std::string> texts;
+  for (unsigned f = 0; f < 6; ++f) {
+    texts.push_back(random_text(1 + 400 * f, 50 + f));
+  }
+  const std::string manifest = corpus(texts);
+  const DnaParser parser;
+  SEQUENCE seq;
+  std::vector<UINT_64> doc_start;
+  ASSERT_EQ(encode_documents(parser, manifest, true, false, seq, doc_start),
+            ReturnStatus::SUCCESS);
+  // each file is a document, encoded as on its own
+  SEQUENCE expected_seq;
+  std::vector<UINT_64> expected_start;
+  for (const auto &text : texts) {
+    expected_start.push_back(expected_seq.size());
+    ASSERT_EQ(parser.encode_from_string(text, expected_seq),
+              ReturnStatus::SUCCESS);
+  }
+  EXPECT_EQ(doc_start, expected_start);
+  EXPECT_EQ(seq, expected_seq);
+  EXPECT_EQ(sorted(engine_maws(seq, doc_start, 40)),
+            brute_force_maws(seq, doc_start, 40));
+
+  // the same streamed into a file
+  Sequence_file seq_file;
+  ASSERT_EQ(seq_file.create("build/corpus_seq"), ReturnStatus::SUCCESS);
+  std::vector<UINT_64> file_start;
+  ASSERT_EQ(encode_documents(parser, manifest, true, false, seq_file,
+                             file_start),
+            ReturnStatus::SUCCESS);
+  EXPECT_EQ(file_start, doc_start);
+  SEQUENCE read_back;
+  ASSERT_EQ(seq_file.read(0, seq_file.size(), read_back),
+            ReturnStatus::SUCCESS);
+  EXPECT_EQ(read_back, seq);
+
+  // a file without letters, or missing, is not a document
+  write_file("build/corpus_empty.txt", "\n\n");
+  write_file("build/corpus.txt",
+             "build/corpus_0.txt\nbuild/corpus_empty.txt\n");
+  SEQUENCE empty_seq;
+  std::vector<UINT_64> empty_start;
+  EXPECT_EQ(encode_documents(parser, manifest, true, false, empty_seq,
+                             empty_start),
+            ReturnStatus::ERR_INVALID_INPUT);
+  write_file("build/corpus.txt", "build/corpus_missing.txt\n");
+  EXPECT_EQ(encode_documents(parser, manifest, true, false, empty_seq,
+                             empty_start),
+            ReturnStatus::ERR_FILE_OPEN);
+  for (std::size_t f = 0; f < texts.size(); ++f) {
+    std::remove(("build/corpus_" + std::to_string(f) + ".txt").c_str());
+  }
+  std::remove("build/corpus_empty.txt");
+  std::remove("build/corpus.txt");
+}
+
+/* The options sweeping with the given number of threads */
+static AdOptions with_threads(const int num_threads) {
+  AdOptions options;
+  options.num_threads = num_threads;
+  return options;
+}
+
+TEST(mawEngineTest, SameOrderForAnyThreads) {
+  const SEQUENCE seq = random_sequence(20000, 7);
+  const auto one = engine_maws(seq, cWhole, 40, with_threads(1));
+  EXPECT_EQ(sorted(one), brute_force_maws(seq, cWhole, 40));
+  for (int threads : {2, 3, 8}) {
+    EXPECT_EQ(engine_maws(seq, cWhole, 40, with_threads(threads)), one);
+  }
+}
+
+TEST(mawEngineTest, SeveralWaves) {
+  // longer than a wave of for_each_maw, with the maws of a few bits
+  const SEQUENCE seq = random_sequence((1 << 18) + 5000, 13);
+  const auto one = engine_maws(seq, cWhole, 14, with_threads(1));
+  EXPECT_EQ(sorted(one), brute_force_maws(seq, cWhole, 14));
+  EXPECT_EQ(engine_maws(seq, cWhole, 14, with_threads(4)), one);
+}
+
+TEST(mawEngineTest, LengthHistogramMatchesMaws) {
+  const SEQUENCE seq = random_sequence(5000, 17);
+  for (const auto &doc_start : {cWhole, random_documents(seq.size(), 17)}) {
+    Maw_engine engine;
+    ASSERT_EQ(engine.build(seq, doc_start), ReturnStatus::SUCCESS);
+    std::vector<UINT_64> num_maws;
+    std::vector<UINT_64> freq;
+    engine.length_histogram(40, num_maws, freq);
+    std::vector<UINT_64> expected_num(41, 0);
+    std::vector<UINT_64> expected_freq(41, 0);
+    for (const auto &m : brute_force_maws(seq, doc_start, 40)) {
+      ++expected_num[m.key_len + 1];
+      expected_freq[m.key_len + 1] += m.freq;
+    }
+    EXPECT_EQ(num_maws, expected_num);
+    EXPECT_EQ(freq, expected_freq);
+  }
+}
+
+/* The options indexing in external memory (files in the current directory) */
+static AdOptions external_memory(const int num_threads = 0) {
+  AdOptions options = with_threads(num_threads);
+  options.is_external_memory = true;
+  return options;
+}
+
+TEST(mawEngineTest, ExternalMemoryMatchesBruteForce) {
+  for (unsigned seed = 1; seed <= 3; ++seed) {
+    const SEQUENCE seq = random_sequence(4000 * seed, 20 + seed);
+    EXPECT_EQ(sorted(engine_maws(seq, cWhole, 64, external_memory())),
+              brute_force_maws(seq, cWhole, 64));
+    // documents, short ones included
+    const std::vector<UINT_64> doc_start = {0, 1, 3, 70, 1000, 2500};
+    EXPECT_EQ(sorted(engine_maws(seq, doc_start, 40, external_memory())),
+              brute_force_maws(seq, doc_start, 40));
+  }
+  for (const std::string bits : {"0", "1", "01", "0000", "0110100110"}) {
+    const SEQUENCE seq(bits);
+    EXPECT_EQ(sorted(engine_maws(seq, cWhole, 12, external_memory())),
+              brute_force_maws(seq, cWhole, 12));
+  }
+}
+
+TEST(mawEngineTest, ExternalMemorySameOrderForAnyThreads) {
+  const SEQUENCE seq = random_sequence((1 << 18) + 3000, 29);
+  const auto one = engine_maws(seq, cWhole, 20, external_memory(1));
+  EXPECT_EQ(sorted(one), brute_force_maws(seq, cWhole, 20));
+  EXPECT_EQ(engine_maws(seq, cWhole, 20, external_memory(4)), one);
+}
+
+TEST(mawEngineTest, ExternalMemoryFromFile) {
+  const SEQUENCE seq = random_sequence(30000, 31);
+  const std::vector<UINT_64> doc_start = {0, 10000, 10001, 25000};
+  Sequence_file seq_file;
+  ASSERT_EQ(seq_file.create("mawEngineTest_seq"), ReturnStatus::SUCCESS);
+  for (UINT_64 pos = 0; pos < seq.size(); pos += 777) {
+    ASSERT_EQ(seq_file.append(seq.slice(
+                  pos, std::min<UINT_64>(777, seq.size() - pos))),
+              ReturnStatus::SUCCESS);
+  }
+  Maw_engine engine;
+  // only the least memory of the buffers and of the runs of the sort
+  AdOptions options = with_threads(2);
+  options.max_memory = Maw_engine::memory_estimate(seq.size(), true, 2);
+  ASSERT_EQ(engine.build(seq_file, doc_start, options),
+            ReturnStatus::SUCCESS);
+  std::vector<Reported> maws;
+  engine.for_each_maw(2, 40, [&](const KEY_TYPE key, const int key_len,
+                                 const bool last, const UINT_64 freq) {
+    maws.push_back({key, key_len, last, freq});
+  });
+  EXPECT_EQ(sorted(maws), brute_force_maws(seq, doc_start, 40));
+
+  std::vector<UINT_64> num_maws;
+  std::vector<UINT_64> freq;
+  engine.length_histogram(40, num_maws, freq);
+  std::vector<UINT_64> expected_num(41, 0);
+  std::vector<UINT_64> expected_freq(41, 0);
+  for (const auto &m : maws) {
+    ++expected_num[m.key_len + 1];
+    expected_freq[m.key_len + 1] += m.freq;
+  }
+  EXPECT_EQ(num_maws, expected_num);
+  EXPECT_EQ(freq, expected_freq);
+}
+
+TEST(invalidInputTest, ExternalMemoryLimit) {
+  const SEQUENCE seq = random_sequence(1000, 37);
+  AdOptions options = external_memory(1);
+  options.max_memory = Maw_engine::memory_estimate(seq.size(), true, 1) - 1;
+  Maw_engine engine;
+  EXPECT_EQ(engine.build(seq, options), ReturnStatus::ERR_LIMIT_EXCEEDS);
+}
+
+TEST(invalidInputTest, EmptySequence) {
+  Maw_engine engine;
+  EXPECT_EQ(engine.build(SEQUENCE()), ReturnStatus::ERR_INVALID_INPUT);
+}
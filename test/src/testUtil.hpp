@@ -0,0 +1,89 @@
+/** Helpers shared by the tests: files and random sequences.
+ */
+#ifndef TEST_UTIL_HPP
+#define TEST_UTIL_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+#include "globalDefs.hpp"
+
+namespace mawcd_test {
+
+/** Contents of a file (empty if it cannot be read) */
+inline std::string read_file(const std::string &filename) {
+  std::ifstream file(filename, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+/** Writes the bytes as the whole file */
+inline void write_file(const std::string &filename, const std::string &bytes) {
+  std::ofstream file(filename, std::ios::binary);
+  file.write(bytes.data(), bytes.size());
+}
+
+inline bool file_exists(const std::string &filename) {
+  return std::ifstream(filename).good();
+}
+
+/** Random bits (a bit is 1 with probability ones/4), with runs and copies of
+ * earlier parts, so that the sequence has long repeats (long LCPs) */
+inline mawcd::SEQUENCE random_sequence(const mawcd::UINT_64 n,
+                                       const unsigned seed,
+                                       const int ones = 2) {
+  std::mt19937_64 rng(seed);
+  mawcd::SEQUENCE seq;
+  while (seq.size() < n) {
+    const mawcd::UINT_64 kind = rng() % 4;
+    const mawcd::UINT_64 len =
+        std::min<mawcd::UINT_64>(n - seq.size(), 1 + rng() % 40);
+    if (kind == 0 && seq.size() > len) { // copy
+      seq.append(seq.slice(rng() % (seq.size() - len), len));
+    } else if (kind == 1) { // run
+      const bool bit = rng() & 1;
+      for (mawcd::UINT_64 i = 0; i < len; ++i) {
+        seq.push_back(bit);
+      }
+    } else {
+      for (mawcd::UINT_64 i = 0; i < len; ++i) {
+        seq.push_back(static_cast<int>(rng() % 4) < ones);
+      }
+    }
+  }
+  return seq;
+}
+
+/** Random text of the given letters, with copies of earlier parts */
+inline std::string random_text(const std::size_t n, const unsigned seed,
+                               const std::string &letters = "ACGT") {
+  std::mt19937_64 rng(seed);
+  std::string text;
+  while (text.size() < n) {
+    const std::size_t len =
+        std::min<std::size_t>(n - text.size(), 1 + rng() % 80);
+    if (rng() % 2 == 0 && text.size() > len) {
+      text += text.substr(rng() % (text.size() - len), len);
+    } else {
+      for (std::size_t i = 0; i < len; ++i) {
+        text += letters[rng() % letters.size()];
+      }
+    }
+  }
+  return text;
+}
+
+/** The text in lines of 60 letters */
+inline std::string in_lines(const std::string &text) {
+  std::string lines;
+  for (std::size_t i = 0; i < text.size(); i += 60) {
+    lines += text.substr(i, 60) + '\n';
+  }
+  return lines;
+}
+
+} // end namespace
+#endif